@@ -0,0 +1,58 @@
+#include "common.h"
+
+#include <codegen/optimizer.h>
+
+#include <optional>
+
+namespace {
+
+void BM_Codegen(benchmark::State& state) {
+    const auto& program = bench::GetProgram(state);
+    auto functions = corpus::Parse(program);
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::optional<CodegenCtx> ctx;
+        ctx.emplace("bench");
+        state.ResumeTiming();
+        if (!corpus::CodegenAll(functions, &*ctx)) {
+            state.SkipWithError("The program doesn't compile");
+            return;
+        }
+        // Freeing the module isn't part of generating it.
+        state.PauseTiming();
+        ctx.reset();
+        state.ResumeTiming();
+    }
+    bench::SetThroughput(state, program);
+}
+
+void BM_Optimize(benchmark::State& state) {
+    const auto& program = bench::GetProgram(state);
+    auto functions = corpus::Parse(program);
+    auto target_machine = CreateHostTargetMachine();
+    if (!target_machine) {
+        state.SkipWithError("No target machine");
+        return;
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::optional<CodegenCtx> ctx;
+        ctx.emplace("bench");
+        ctx->module->setDataLayout(target_machine->createDataLayout());
+        if (!corpus::CodegenAll(functions, &*ctx)) {
+            state.SkipWithError("The program doesn't compile");
+            return;
+        }
+        state.ResumeTiming();
+        Optimize(ctx->module.get(), target_machine.get());
+        state.PauseTiming();
+        ctx.reset();
+        state.ResumeTiming();
+    }
+    bench::SetThroughput(state, program);
+}
+
+}  // namespace
+
+BENCHMARK(BM_Codegen)->Apply(bench::CorpusArgs);
+BENCHMARK(BM_Optimize)->Apply(bench::CorpusArgs)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,31 @@
+#include "common.h"
+
+#include <utility>
+
+namespace bench {
+
+void CorpusArgs(benchmark::internal::Benchmark* benchmark) {
+    std::vector<int64_t> shapes;
+    for (size_t i = 0; i < std::size(corpus::kShapes); ++i) {
+        shapes.push_back(i);
+    }
+    benchmark->ArgNames({"shape", "definitions"})->ArgsProduct({shapes, {100, 1000}});
+}
+
+const corpus::Program& GetProgram(benchmark::State& state) {
+    static std::map<std::pair<int64_t, int64_t>, corpus::Program> programs;
+    auto shape = corpus::kShapes[state.range(0)];
+    state.SetLabel(std::string(corpus::ShapeName(shape)));
+    auto [it, inserted] = programs.try_emplace({state.range(0), state.range(1)});
+    if (inserted) {
+        it->second = corpus::Generate(shape, state.range(1));
+    }
+    return it->second;
+}
+
+void SetThroughput(benchmark::State& state, const corpus::Program& program) {
+    state.SetBytesProcessed(state.iterations() * program.source.size());
+    state.SetItemsProcessed(state.iterations() * program.definitions.size());
+}
+
+}  // namespace bench
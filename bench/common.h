@@ -0,0 +1,21 @@
+#pragma once
+
+#include <corpus/corpus.h>
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+
+namespace bench {
+
+// Every shape of corpus, each with a few sizes.
+void CorpusArgs(benchmark::internal::Benchmark* benchmark);
+
+// The program the arguments of `state` select, generated once. Labels the benchmark with its
+// shape.
+const corpus::Program& GetProgram(benchmark::State& state);
+
+// Reports bytes of source and definitions handled per second, over all iterations.
+void SetThroughput(benchmark::State& state, const corpus::Program& program);
+
+}  // namespace bench
@@ -0,0 +1,28 @@
+#include "common.h"
+
+#include <engine/engine.h>
+
+namespace {
+
+// From source to results: compiles the program with a new engine, then calls every
+// definition once.
+void BM_CompileAndEvaluate(benchmark::State& state) {
+    const auto& program = bench::GetProgram(state);
+    for (auto _ : state) {
+        auto engine = Engine::Create();
+        if (!engine || !engine->Compile(program.source)) {
+            state.SkipWithError("The program doesn't compile");
+            return;
+        }
+        double sum = 0;
+        for (const auto& name : program.definitions) {
+            sum += engine->Lookup<double(double, double)>(name)(1.5, 2.5);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    bench::SetThroughput(state, program);
+}
+
+}  // namespace
+
+BENCHMARK(BM_CompileAndEvaluate)->Apply(bench::CorpusArgs)->Unit(benchmark::kMillisecond);
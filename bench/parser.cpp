@@ -0,0 +1,20 @@
+#include "common.h"
+
+namespace {
+
+void BM_Parse(benchmark::State& state) {
+    const auto& program = bench::GetProgram(state);
+    for (auto _ : state) {
+        auto functions = corpus::Parse(program);
+        if (functions.empty()) {
+            state.SkipWithError("The program doesn't parse");
+            return;
+        }
+        benchmark::DoNotOptimize(functions.data());
+    }
+    bench::SetThroughput(state, program);
+}
+
+}  // namespace
+
+BENCHMARK(BM_Parse)->Apply(bench::CorpusArgs);
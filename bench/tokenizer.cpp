@@ -0,0 +1,26 @@
+#include "common.h"
+
+#include <parser/tokenizer.h>
+
+#include <sstream>
+
+namespace {
+
+void BM_Tokenize(benchmark::State& state) {
+    const auto& program = bench::GetProgram(state);
+    size_t tokens = 0;
+    for (auto _ : state) {
+        std::istringstream in(program.source);
+        Tokenizer tokenizer(&in);
+        while (GetTokenKind(tokenizer.Get()) != token::TokenKind::kEof) {
+            tokenizer.Next();
+            ++tokens;
+        }
+    }
+    bench::SetThroughput(state, program);
+    state.counters["tokens"] = benchmark::Counter(tokens, benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+BENCHMARK(BM_Tokenize)->Apply(bench::CorpusArgs);
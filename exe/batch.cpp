@@ -0,0 +1,131 @@
+#include "flags.h"
+
+#include <batch/batch.h>
+#include <backward.hpp>
+#include <format>
+#include <fstream>
+#include <iostream>
+
+#include <llvm/ADT/Statistic.h>
+#include <llvm/Support/CommandLine.h>
+
+namespace {
+
+using flags::category;
+
+flags::FpModeFlag fp_mode;
+flags::VectorLibraryFlag vector_library;
+
+llvm::cl::opt<std::string> input(llvm::cl::Positional, llvm::cl::desc("<input file>"),
+                                 llvm::cl::init("-"), llvm::cl::cat(category));
+
+llvm::cl::opt<std::string> emit_ir(
+    "emit-ir", llvm::cl::desc("Write the optimized module to a file, - for stdout"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(category));
+
+llvm::cl::opt<std::string> emit_ast(
+    "emit-ast", llvm::cl::desc("Write the parsed items as a binary AST file"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(category));
+
+llvm::cl::opt<std::string> emit_bundle(
+    "emit-bundle", llvm::cl::desc("Write the object code and prototypes as a bundle"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(category));
+
+bool WriteAst(std::span<const ast::Item> items) {
+    std::error_code error;
+    llvm::raw_fd_ostream out(emit_ast, error);
+    if (error) {
+        LogError(std::format("Cannot open {}: {}", emit_ast.getValue(), error.message()));
+        return false;
+    }
+    WriteAstFile(items, out);
+    return true;
+}
+
+bool WriteBundle(const Batch& batch) {
+    if (batch.GetSummary().expressions) {
+        LogError("Bundles can't contain top-level expressions");
+        return false;
+    }
+    std::error_code error;
+    llvm::raw_fd_ostream out(emit_bundle, error);
+    if (error) {
+        LogError(std::format("Cannot open {}: {}", emit_bundle.getValue(), error.message()));
+        return false;
+    }
+    WriteBundle(batch.GetInterface(), batch.GetModule().getTargetTriple(),
+                batch.GetObject()->getMemBufferRef(), out);
+    return true;
+}
+
+bool WriteModule(const llvm::Module& module) {
+    std::error_code error;
+    llvm::raw_fd_ostream out(emit_ir, error);
+    if (error) {
+        LogError(std::format("Cannot open {}: {}", emit_ir.getValue(), error.message()));
+        return false;
+    }
+    module.print(out, nullptr);
+    return true;
+}
+
+void PrintSummary(const BatchSummary& summary, std::chrono::nanoseconds wall_time) {
+    llvm::errs() << std::format(
+        "{} definitions, {} externs, {} expressions, {} errors; {} bytes of object code in "
+        "{:.3f} ms\n",
+        summary.definitions, summary.externs, summary.expressions, summary.errors,
+        summary.object_bytes, std::chrono::duration<double, std::milli>(wall_time).count());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    backward::SignalHandling sh;
+    llvm::cl::HideUnrelatedOptions(category);
+    llvm::cl::ParseCommandLineOptions(argc, argv, "Kaleidoscope batch compiler\n");
+
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (input != "-") {
+        file.open(input);
+        if (!file) {
+            LogError(std::format("Cannot open {}", input.getValue()));
+            return 1;
+        }
+        in = &file;
+    }
+    auto target_machine = CreateHostTargetMachine();
+    if (!target_machine) {
+        return 1;
+    }
+
+    std::map<std::string, uint8_t> binop_precedence{
+        {"<", 10},
+        {"+", 20},
+        {"-", 20},
+        {"*", 40},
+    };
+    Batch batch{in, std::move(binop_precedence), std::move(target_machine),
+                {
+                    .codegen = {.fp_mode = fp_mode.value},
+                    .optimizer = {.vector_library = vector_library.value},
+                    .collect_stats = llvm::AreStatisticsEnabled(),
+                    .keep_ast = !emit_ast.empty(),
+                }};
+    bool ok = batch.Run();
+    PrintSummary(batch.GetSummary(), batch.GetReport().wall_time);
+    if (llvm::AreStatisticsEnabled()) {
+        stats::PrintText(batch.GetReport(), llvm::errs());
+    }
+    // An AST file with errors would only fail again where it is loaded.
+    if (ok && !emit_ast.empty() && !WriteAst(batch.GetItems())) {
+        return 1;
+    }
+    if (ok && !emit_bundle.empty() && !WriteBundle(batch)) {
+        return 1;
+    }
+    if (!emit_ir.empty() && !WriteModule(batch.GetModule())) {
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
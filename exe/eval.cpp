@@ -0,0 +1,129 @@
+#include "flags.h"
+
+#include <eval/eval.h>
+#include <backward.hpp>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <util.h>
+
+#include <llvm/Support/CommandLine.h>
+
+namespace {
+
+using flags::category;
+
+flags::FpModeFlag fp_mode;
+flags::VectorLibraryFlag vector_library;
+flags::PerfFlags perf;
+
+llvm::cl::opt<std::string> input(llvm::cl::Positional, llvm::cl::desc("<source file>"),
+                                 llvm::cl::init("-"), llvm::cl::cat(category));
+
+llvm::cl::opt<std::string> function("function", llvm::cl::desc("Function to evaluate"),
+                                    llvm::cl::value_desc("name"), llvm::cl::Required,
+                                    llvm::cl::cat(category));
+
+llvm::cl::list<std::string> column_options(
+    "column", llvm::cl::desc("Column file of an argument of the function"),
+    llvm::cl::value_desc("argument=file"), llvm::cl::cat(category));
+
+llvm::cl::opt<std::string> column_dir(
+    "column-dir", llvm::cl::desc("Directory of <argument>.bin files for the other arguments"),
+    llvm::cl::value_desc("directory"), llvm::cl::cat(category));
+
+llvm::cl::opt<std::string> output("o", llvm::cl::desc("Column file of the results"),
+                                  llvm::cl::value_desc("file"), llvm::cl::Required,
+                                  llvm::cl::cat(category));
+
+llvm::cl::opt<size_t> threads(
+    "threads", llvm::cl::desc("Threads evaluating chunks, 0 for one per core"),
+    llvm::cl::init(0), llvm::cl::cat(category));
+
+llvm::cl::opt<size_t> chunk_rows("chunk-rows", llvm::cl::desc("Rows evaluated at a time"),
+                                 llvm::cl::init(EvalOptions{}.chunk_rows),
+                                 llvm::cl::cat(category));
+
+llvm::cl::opt<bool> stream("stream",
+                           llvm::cl::desc("Read and write chunks instead of mapping the files"),
+                           llvm::cl::cat(category));
+
+std::optional<std::string> ReadSource() {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (input != "-") {
+        file.open(input);
+        if (!file) {
+            LogError(std::format("Cannot open {}", input.getValue()));
+            return std::nullopt;
+        }
+        in = &file;
+    }
+    std::ostringstream source;
+    source << in->rdbuf();
+    return source.str();
+}
+
+// Explicit columns, then files in the column directory for the other arguments.
+std::optional<std::map<std::string, std::string>> GetColumns(const ast::Prototype& proto) {
+    std::map<std::string, std::string> columns;
+    for (const auto& option : column_options) {
+        auto separator = option.find('=');
+        if (separator == std::string::npos) {
+            LogError(std::format("Expected argument=file, got {}", option));
+            return std::nullopt;
+        }
+        columns[option.substr(0, separator)] = option.substr(separator + 1);
+    }
+    if (!column_dir.empty()) {
+        for (const auto& arg : proto.args) {
+            columns.try_emplace(arg, std::format("{}/{}.bin", column_dir.getValue(), arg));
+        }
+    }
+    return columns;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    backward::SignalHandling sh;
+    llvm::cl::HideUnrelatedOptions(category);
+    llvm::cl::ParseCommandLineOptions(argc, argv, "Kaleidoscope column evaluator\n");
+
+    auto source = ReadSource();
+    if (!source) {
+        return 1;
+    }
+    auto engine = Engine::Create({
+        .codegen = {.fp_mode = fp_mode.value,
+                    .debug_info = perf.jitdump,
+                    .source_name = input == "-" ? "<stdin>" : input.getValue()},
+        .optimizer = {.vector_library = vector_library.value},
+        .perf = perf.Get(),
+    });
+    std::string kernels[] = {function};
+    if (!engine || !engine->Compile(*source, kernels)) {
+        return 1;
+    }
+    auto columns = GetColumns(*engine->GetPrototype(function));
+    if (!columns) {
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto summary = EvaluateColumns(*engine, function, *columns, output,
+                                   {.threads = threads, .chunk_rows = chunk_rows,
+                                    .stream = stream});
+    if (!summary) {
+        return 1;
+    }
+    std::chrono::duration<double, std::milli> wall_time = std::chrono::steady_clock::now() - start;
+    llvm::errs() << std::format("{} rows in {} chunks on {} threads in {:.3f} ms\n",
+                                summary->rows, summary->chunks, summary->threads,
+                                wall_time.count());
+    return 0;
+}
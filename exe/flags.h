@@ -0,0 +1,50 @@
+#pragma once
+
+#include <codegen/fp_mode.h>
+#include <codegen/optimizer.h>
+#include <jit/jit.h>
+
+#include <llvm/Support/CommandLine.h>
+
+// Flags shared by the executables, which list only this category in --help. Each executable
+// defines the groups of flags it takes at namespace scope.
+namespace flags {
+
+inline llvm::cl::OptionCategory category("Kaleidoscope options");
+
+// --fp-mode
+struct FpModeFlag {
+    llvm::cl::opt<FpMode> value{
+        "fp-mode", llvm::cl::desc("Floating-point mode of all functions"),
+        llvm::cl::init(FpMode::kStrict), llvm::cl::cat(category),
+        llvm::cl::values(clEnumValN(FpMode::kStrict, "strict", "IEEE semantics"),
+                         clEnumValN(FpMode::kContract, "contract", "Allow FMA contraction"),
+                         clEnumValN(FpMode::kFast, "fast", "All fast-math flags"))};
+};
+
+// --vector-math-library
+struct VectorLibraryFlag {
+    llvm::cl::opt<VectorLibrary> value{
+        "vector-math-library", llvm::cl::desc("Vector math library used by the vectorizers"),
+        llvm::cl::init(VectorLibrary::kNone), llvm::cl::cat(category),
+        llvm::cl::values(clEnumValN(VectorLibrary::kNone, "none", "Scalar math calls only"),
+                         clEnumValN(VectorLibrary::kLibmvec, "libmvec", "glibc vector math"),
+                         clEnumValN(VectorLibrary::kSvml, "svml", "Intel SVML"))};
+};
+
+// --perf-map and --perf-jitdump
+struct PerfFlags {
+    llvm::cl::opt<bool> map{
+        "perf-map", llvm::cl::desc("Name JIT'd functions in /tmp/perf-<pid>.map for perf"),
+        llvm::cl::cat(category)};
+    llvm::cl::opt<bool> jitdump{
+        "perf-jitdump",
+        llvm::cl::desc("Write jitdump records with line tables, for perf inject --jit"),
+        llvm::cl::cat(category)};
+
+    PerfOptions Get() const {
+        return {.perf_map = map, .jitdump = jitdump};
+    }
+};
+
+}  // namespace flags
@@ -1,9 +1,103 @@
+#include "flags.h"
+
+#include <pipeline/pipeline.h>
 #include <repl/repl.h>
 #include <backward.hpp>
+#include <format>
 #include <iostream>
 
-int main() {
+#include <llvm/ADT/Statistic.h>
+#include <llvm/Support/CommandLine.h>
+
+namespace {
+
+using flags::category;
+
+flags::FpModeFlag fp_mode;
+flags::VectorLibraryFlag vector_library;
+flags::PerfFlags perf;
+
+llvm::cl::list<std::string> function_fp_modes(
+    "function-fp-mode", llvm::cl::desc("Floating-point mode of a single function"),
+    llvm::cl::value_desc("name=mode"), llvm::cl::cat(category));
+
+llvm::cl::opt<bool> call_stubs(
+    "call-stubs",
+    llvm::cl::desc("Call definitions through stubs, so redefinitions don't recompile callers"),
+    llvm::cl::init(true), llvm::cl::cat(category));
+
+llvm::cl::list<std::string> load_ast(
+    "load-ast", llvm::cl::desc("Load the items of a binary AST file before reading the input"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(category));
+
+llvm::cl::list<std::string> load_bundle(
+    "load-bundle", llvm::cl::desc("Link the precompiled functions of a bundle"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(category));
+
+llvm::cl::opt<size_t> pipeline_threads(
+    "pipeline-threads",
+    llvm::cl::desc("Compile items on this many threads while parsing and running the input, "
+                   "without a prompt or redefinitions (0 runs the REPL)"),
+    llvm::cl::init(0), llvm::cl::cat(category));
+
+enum class ReportFormat {
+    kNone,
+    kText,
+    kJson,
+};
+
+llvm::cl::opt<ReportFormat> time_report(
+    "time-report", llvm::cl::desc("Print per-item and total compile statistics on exit"),
+    llvm::cl::init(ReportFormat::kNone), llvm::cl::cat(category),
+    llvm::cl::values(clEnumValN(ReportFormat::kText, "text", "Human-readable totals"),
+                     clEnumValN(ReportFormat::kJson, "json", "JSON with every item")));
+
+llvm::cl::opt<std::string> time_report_output(
+    "time-report-output", llvm::cl::desc("Where to write the report, stderr by default"),
+    llvm::cl::value_desc("file"), llvm::cl::init("-"), llvm::cl::cat(category));
+
+bool WriteReport(const stats::Report& report, ReportFormat format) {
+    std::error_code error;
+    llvm::raw_fd_ostream out(time_report_output, error);
+    if (error) {
+        LogError(std::format("Cannot open {}: {}", time_report_output.getValue(),
+                             error.message()));
+        return false;
+    }
+    if (format == ReportFormat::kJson) {
+        stats::PrintJson(report, out);
+    } else {
+        stats::PrintText(report, out);
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
     backward::SignalHandling sh;
+    llvm::cl::HideUnrelatedOptions(category);
+    llvm::cl::ParseCommandLineOptions(argc, argv, "Kaleidoscope REPL\n");
+
+    // --stats is LLVM's own flag, it enables our statistics as well.
+    const bool collect_stats =
+        llvm::AreStatisticsEnabled() || time_report != ReportFormat::kNone;
+    ReplOptions options{
+        .codegen = {.fp_mode = fp_mode.value,
+                    .debug_info = perf.jitdump,
+                    .source_name = "<stdin>"},
+        .collect_stats = collect_stats,
+        .call_stubs = call_stubs,
+    };
+    for (const auto& entry : function_fp_modes) {
+        auto [name, mode_name] = llvm::StringRef(entry).split('=');
+        auto mode = ParseFpMode(mode_name);
+        if (name.empty() || !mode) {
+            LogError("Expected --function-fp-mode=<name>=<strict|contract|fast>");
+            return 1;
+        }
+        options.codegen.function_fp_modes[name.str()] = *mode;
+    }
 
     std::map<std::string, uint8_t> binop_precedence{
         {"<", 10},
@@ -11,8 +105,53 @@ int main() {
         {"-", 20},
         {"*", 40},
     };
+    auto jit = Jit::Create({.vector_library = vector_library.value}, perf.Get());
+    if (!jit) {
+        return 1;
+    }
     auto out = &llvm::errs();
+    if (pipeline_threads > 0) {
+        if (!load_bundle.empty() || !load_ast.empty() || call_stubs.getNumOccurrences()) {
+            LogError("--pipeline-threads can't be combined with --load-bundle, --load-ast or "
+                     "--call-stubs");
+            return 1;
+        }
+        Pipeline pipeline{&std::cin, out, std::move(binop_precedence), std::move(jit),
+                          {.codegen = std::move(options.codegen),
+                           .optimizer = {.vector_library = vector_library.value},
+                           .compile_threads = pipeline_threads,
+                           .collect_stats = collect_stats}};
+        pipeline.Run();
+        if (collect_stats) {
+            auto format =
+                time_report == ReportFormat::kJson ? ReportFormat::kJson : ReportFormat::kText;
+            if (!WriteReport(pipeline.GetReport(), format)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    Repl repl{&std::cin, out, std::move(binop_precedence), std::move(jit), std::move(options)};
+    for (const auto& path : load_bundle) {
+        auto bundle = Bundle::Open(path);
+        if (!bundle || !repl.LoadBundle(*bundle)) {
+            return 1;
+        }
+    }
+    for (const auto& path : load_ast) {
+        auto file = AstFile::Open(path);
+        if (!file) {
+            return 1;
+        }
+        repl.Load(file->Load());
+    }
     Repl::Prompt(out);
-    Repl repl{&std::cin, out, std::move(binop_precedence)};
     repl.MainLoop();
+
+    if (collect_stats) {
+        auto format = time_report == ReportFormat::kJson ? ReportFormat::kJson : ReportFormat::kText;
+        if (!WriteReport(repl.GetReport(), format)) {
+            return 1;
+        }
+    }
 }
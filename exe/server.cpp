@@ -0,0 +1,74 @@
+#include "flags.h"
+
+#include <server/server.h>
+#include <backward.hpp>
+
+#include <llvm/Support/CommandLine.h>
+
+#include <csignal>
+
+namespace {
+
+using flags::category;
+
+flags::FpModeFlag fp_mode;
+flags::PerfFlags perf;
+
+llvm::cl::opt<std::string> socket_path(llvm::cl::Positional, llvm::cl::desc("<socket>"),
+                                       llvm::cl::Required, llvm::cl::cat(category));
+
+llvm::cl::opt<std::string> prelude_path(
+    "prelude", llvm::cl::desc("Bundle whose functions every session can call"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(category));
+
+llvm::cl::opt<size_t> worker_threads(
+    "workers", llvm::cl::desc("Threads evaluating sessions, one per core by default"),
+    llvm::cl::init(std::thread::hardware_concurrency()), llvm::cl::cat(category));
+
+Server* running_server = nullptr;
+
+void StopServer(int) {
+    // Only writes to a pipe, which is safe in a signal handler.
+    running_server->Stop();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    backward::SignalHandling sh;
+    llvm::cl::HideUnrelatedOptions(category);
+    llvm::cl::ParseCommandLineOptions(argc, argv, "Kaleidoscope evaluation server\n");
+
+    std::unique_ptr<Prelude> prelude;
+    if (!prelude_path.empty()) {
+        auto bundle = Bundle::Open(prelude_path);
+        if (!bundle) {
+            return 1;
+        }
+        prelude = Prelude::Create(*bundle);
+        if (!prelude) {
+            return 1;
+        }
+    }
+
+    std::map<std::string, uint8_t> binop_precedence{
+        {"<", 10},
+        {"+", 20},
+        {"-", 20},
+        {"*", 40},
+    };
+    auto server = Server::Create(socket_path, std::move(binop_precedence), prelude.get(),
+                                 {
+                                     .repl = {.codegen = {.fp_mode = fp_mode.value,
+                                                          .debug_info = perf.jitdump}},
+                                     .worker_threads = worker_threads,
+                                     .perf = perf.Get(),
+                                 });
+    if (!server) {
+        return 1;
+    }
+    running_server = server.get();
+    std::signal(SIGINT, StopServer);
+    std::signal(SIGTERM, StopServer);
+    server->Run();
+}
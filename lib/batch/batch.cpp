@@ -0,0 +1,171 @@
+#include "batch.h"
+
+#include <codegen/codegen.h>
+#include <util.h>
+
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+
+#include <format>
+
+Batch::Batch(std::istream* in, std::map<std::string, uint8_t> binop_precedence,
+             std::unique_ptr<llvm::TargetMachine> target_machine, BatchOptions options)
+    : parser_(std::move(binop_precedence), in),
+      driver_(&parser_, options.collect_stats),
+      target_machine_(std::move(target_machine)),
+      codegen_ctx_("batch", options.codegen),
+      options_(std::move(options)) {
+    codegen_ctx_.module->setDataLayout(target_machine_->createDataLayout());
+    codegen_ctx_.module->setTargetTriple(target_machine_->getTargetTriple().str());
+}
+
+bool Batch::Run() {
+    driver_.Run({
+        .definition = [this] { return HandleDefinition(); },
+        .extern_ = [this] { return HandleExtern(); },
+        .expression = [this] { return HandleTopLevelExpression(); },
+        .end = [this] { driver_.Handle("module", [this] { return EmitModule(); }); },
+    });
+    return summary_.errors == 0;
+}
+
+const llvm::Module& Batch::GetModule() const {
+    return *codegen_ctx_.module;
+}
+
+const BatchSummary& Batch::GetSummary() const {
+    return summary_;
+}
+
+const stats::Report& Batch::GetReport() const {
+    return driver_.GetReport();
+}
+
+std::span<const ast::Item> Batch::GetItems() const {
+    return items_;
+}
+
+const llvm::MemoryBuffer* Batch::GetObject() const {
+    return object_.get();
+}
+
+BundleInterface Batch::GetInterface() const {
+    BundleInterface interface;
+    for (const auto& [name, proto] : codegen_ctx_.function_protos) {
+        if (name == ast::kTopLevelExprName) {
+            continue;
+        }
+        auto& protos = codegen_ctx_.defined_functions.contains(name) ? interface.definitions
+                                                                     : interface.externs;
+        protos.push_back(proto);
+    }
+    return interface;
+}
+
+std::string Batch::HandleDefinition() {
+    auto fn = parser_.ParseDefinition();
+    if (!fn) {
+        LogError("Failed to parse definition");
+        parser_.GetTokenizer()->Next();
+        ++summary_.errors;
+        return {};
+    }
+    CompileDefinition(*fn);
+    auto name = fn->GetName();
+    KeepItem(std::move(*fn));
+    return name;
+}
+
+std::string Batch::HandleExtern() {
+    auto fn = parser_.ParseExtern();
+    if (!fn) {
+        parser_.GetTokenizer()->Next();
+        ++summary_.errors;
+        return {};
+    }
+    CompileExtern(*fn);
+    auto name = fn->name;
+    KeepItem(std::move(*fn));
+    return name;
+}
+
+std::string Batch::HandleTopLevelExpression() {
+    auto fn = parser_.ParseTopLevelExpr();
+    if (!fn) {
+        parser_.GetTokenizer()->Next();
+        ++summary_.errors;
+        return {};
+    }
+    auto name = CompileTopLevelExpression(*fn);
+    KeepItem(std::move(*fn));
+    return name;
+}
+
+void Batch::CompileDefinition(const ast::Function& fn) {
+    const auto& name = fn.GetName();
+    if (auto* existing = codegen_ctx_.module->getNamedValue(name);
+        existing && !existing->isDeclaration()) {
+        LogError(std::format("Function {} is already defined", name));
+        ++summary_.errors;
+        return;
+    }
+    auto key = StructuralKey(fn, codegen_ctx_.GetFpMode(name));
+    if (auto canonical = deduplicator_.Find(key)) {
+        if (!CodegenAlias(fn.proto, codegen_ctx_.module->getFunction(*canonical),
+                          &codegen_ctx_)) {
+            ++summary_.errors;
+            return;
+        }
+        codegen_ctx_.function_protos[name] = fn.proto;
+        codegen_ctx_.defined_functions.insert(name);
+    } else {
+        if (!Codegen(fn, &codegen_ctx_)) {
+            ++summary_.errors;
+            return;
+        }
+        deduplicator_.Insert(std::move(key), name);
+    }
+    ++summary_.definitions;
+}
+
+void Batch::CompileExtern(const ast::Prototype& proto) {
+    if (!codegen_ctx_.CanDeclare(proto) || !Codegen(proto, &codegen_ctx_)) {
+        ++summary_.errors;
+        return;
+    }
+    codegen_ctx_.function_protos[proto.name] = proto;
+    ++summary_.externs;
+}
+
+std::string Batch::CompileTopLevelExpression(const ast::Function& fn) {
+    auto* fn_ir = Codegen(fn, &codegen_ctx_);
+    if (!fn_ir) {
+        ++summary_.errors;
+        return fn.GetName();
+    }
+    // Every expression is named __anon_expr, keep them apart in the single module.
+    fn_ir->setName(std::format("{}.{}", fn.GetName(), summary_.expressions++));
+    return fn_ir->getName().str();
+}
+
+void Batch::KeepItem(ast::Item item) {
+    if (options_.keep_ast) {
+        items_.push_back(std::move(item));
+    }
+}
+
+std::string Batch::EmitModule() {
+    auto& module = *codegen_ctx_.module;
+    Optimize(&module, target_machine_.get(), options_.optimizer);
+
+    stats::ScopedTimer timer(stats::Phase::kEmit);
+    llvm::orc::SimpleCompiler compiler(*target_machine_);
+    auto object = compiler(module);
+    if (!object) {
+        LogError(llvm::toString(object.takeError()));
+        ++summary_.errors;
+        return module.getName().str();
+    }
+    summary_.object_bytes = (*object)->getBufferSize();
+    object_ = std::move(*object);
+    return module.getName().str();
+}
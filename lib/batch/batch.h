@@ -0,0 +1,79 @@
+#pragma once
+
+#include <bundle/bundle.h>
+#include <parser/ast_file.h>
+#include <parser/parser.h>
+#include <codegen/codegen_ctx.h>
+#include <codegen/dedup.h>
+#include <codegen/optimizer.h>
+#include <driver/item_driver.h>
+#include <stats/report.h>
+
+#include <llvm/Target/TargetMachine.h>
+
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+struct BatchOptions {
+    CodegenOptions codegen;
+    OptimizerOptions optimizer;
+    // Records compile statistics of every item, see Batch::GetReport.
+    bool collect_stats = false;
+    // Keeps the parsed items, see Batch::GetItems.
+    bool keep_ast = false;
+};
+
+struct BatchSummary {
+    size_t definitions = 0;
+    size_t externs = 0;
+    size_t expressions = 0;
+    size_t errors = 0;
+    // Size of the object file emitted for the module.
+    size_t object_bytes = 0;
+};
+
+// Compiles a whole input into a single module, printing nothing but errors. Unlike the REPL,
+// top-level expressions are compiled, not evaluated.
+class Batch {
+public:
+    Batch(std::istream* in, std::map<std::string, uint8_t> binop_precedence,
+          std::unique_ptr<llvm::TargetMachine> target_machine, BatchOptions options = {});
+
+    // Compiles every item, then optimizes the module and emits machine code for it. Returns
+    // false if any item failed.
+    bool Run();
+
+    const llvm::Module& GetModule() const;
+    const BatchSummary& GetSummary() const;
+    const stats::Report& GetReport() const;
+    // Every item parsed, including those that failed to compile. Empty unless `keep_ast` is set.
+    std::span<const ast::Item> GetItems() const;
+    // Object code of the module, null if it hasn't been emitted.
+    const llvm::MemoryBuffer* GetObject() const;
+    // Functions defined by the module and externs it declares, for a bundle of its object.
+    BundleInterface GetInterface() const;
+
+private:
+    // Handlers return the name of the handled item, empty if it failed to parse.
+    std::string HandleDefinition();
+    std::string HandleExtern();
+    std::string HandleTopLevelExpression();
+    std::string EmitModule();
+    void CompileDefinition(const ast::Function& fn);
+    void CompileExtern(const ast::Prototype& proto);
+    std::string CompileTopLevelExpression(const ast::Function& fn);
+    void KeepItem(ast::Item item);
+
+    Parser parser_;
+    ItemDriver driver_;
+    std::unique_ptr<llvm::TargetMachine> target_machine_;
+    CodegenCtx codegen_ctx_;
+    FunctionDeduplicator deduplicator_;
+    BatchOptions options_;
+    BatchSummary summary_;
+    std::vector<ast::Item> items_;
+    std::unique_ptr<llvm::MemoryBuffer> object_;
+};
@@ -0,0 +1,140 @@
+#include "bundle.h"
+
+#include <util.h>
+
+#include <format>
+#include <optional>
+
+using namespace bundle;
+
+namespace {
+
+constexpr size_t kAlignment = 8;
+
+size_t AlignUp(size_t offset) {
+    return (offset + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+}  // namespace
+
+void WriteBundle(const BundleInterface& interface, std::string_view triple,
+                 llvm::MemoryBufferRef object, llvm::raw_ostream& out) {
+    std::vector<ast::Item> items;
+    for (const auto& protos : {&interface.definitions, &interface.externs}) {
+        items.insert(items.end(), protos->begin(), protos->end());
+    }
+    std::string interface_file;
+    llvm::raw_string_ostream interface_out(interface_file);
+    WriteAstFile(items, interface_out);
+
+    Header header{
+        .magic = kMagic,
+        .version = kVersion,
+        .triple_size = static_cast<uint32_t>(triple.size()),
+        .definition_count = static_cast<uint32_t>(interface.definitions.size()),
+        .interface_size = interface_file.size(),
+        .object_size = object.getBufferSize(),
+    };
+    size_t offset = 0;
+    auto write = [&](const void* data, size_t size) {
+        out.write(static_cast<const char*>(data), size);
+        offset += size;
+        out.write_zeros(AlignUp(offset) - offset);
+        offset = AlignUp(offset);
+    };
+    write(&header, sizeof(header));
+    write(triple.data(), triple.size());
+    write(interface_file.data(), interface_file.size());
+    write(object.getBufferStart(), object.getBufferSize());
+}
+
+std::unique_ptr<Bundle> Bundle::Open(const std::string& path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                              /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        return LogError(std::format("Cannot open {}: {}", path, buffer.getError().message()));
+    }
+    return Create(std::move(*buffer));
+}
+
+std::unique_ptr<Bundle> Bundle::Create(std::unique_ptr<llvm::MemoryBuffer> buffer) {
+    std::unique_ptr<Bundle> bundle(new Bundle(std::move(buffer)));
+    if (!bundle->Init()) {
+        return nullptr;
+    }
+    return bundle;
+}
+
+Bundle::Bundle(std::unique_ptr<llvm::MemoryBuffer> buffer) : buffer_(std::move(buffer)) {
+}
+
+bool Bundle::Init() {
+    const char* data = buffer_->getBufferStart();
+    const size_t size = buffer_->getBufferSize();
+    if (size < sizeof(Header) || reinterpret_cast<uintptr_t>(data) % kAlignment != 0) {
+        LogError("Not a bundle");
+        return false;
+    }
+    const auto* header = reinterpret_cast<const Header*>(data);
+    if (header->magic != kMagic) {
+        LogError("Not a bundle, or written on a host with another byte order");
+        return false;
+    }
+    if (header->version != kVersion) {
+        LogError(std::format("Bundle version {} is not supported, expected {}", header->version,
+                             kVersion));
+        return false;
+    }
+
+    size_t offset = AlignUp(sizeof(Header));
+    auto section = [&](uint64_t section_size) -> std::optional<std::string_view> {
+        if (offset > size || section_size > size - offset) {
+            return std::nullopt;
+        }
+        std::string_view contents(data + offset, section_size);
+        offset = AlignUp(offset + section_size);
+        return contents;
+    };
+    auto triple = section(header->triple_size);
+    auto interface = section(header->interface_size);
+    auto object = section(header->object_size);
+    if (!triple || !interface || !object) {
+        LogError("Truncated bundle");
+        return false;
+    }
+    triple_ = *triple;
+    object_ = *object;
+
+    // The interface is small, so it is loaded right away.
+    auto interface_file = AstFile::Create(llvm::MemoryBuffer::getMemBuffer(
+        llvm::StringRef(interface->data(), interface->size()), "interface",
+        /*RequiresNullTerminator=*/false));
+    if (!interface_file) {
+        return false;
+    }
+    if (header->definition_count > interface_file->GetItemCount()) {
+        LogError("Invalid bundle interface");
+        return false;
+    }
+    for (size_t i = 0; i < interface_file->GetItemCount(); ++i) {
+        if (!interface_file->IsExtern(i)) {
+            LogError("Invalid bundle interface");
+            return false;
+        }
+        auto& protos = i < header->definition_count ? interface_.definitions : interface_.externs;
+        protos.push_back(std::get<ast::Prototype>(interface_file->LoadItem(i)));
+    }
+    return true;
+}
+
+std::string_view Bundle::GetTriple() const {
+    return triple_;
+}
+
+const BundleInterface& Bundle::GetInterface() const {
+    return interface_;
+}
+
+llvm::MemoryBufferRef Bundle::GetObject() const {
+    return llvm::MemoryBufferRef(llvm::StringRef(object_.data(), object_.size()), "bundle");
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <parser/ast_file.h>
+
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Functions a bundle defines, and the externs its code calls.
+struct BundleInterface {
+    std::vector<ast::Prototype> definitions;
+    std::vector<ast::Prototype> externs;
+};
+
+namespace bundle {
+
+inline constexpr uint32_t kMagic = 0x4c44424b;  // "KBDL"
+inline constexpr uint32_t kVersion = 1;
+
+// Followed by the target triple, the interface as an AST file of prototypes, definitions
+// first, and the object file, each aligned to 8 bytes.
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t triple_size;
+    uint32_t definition_count;
+    uint64_t interface_size;
+    uint64_t object_size;
+};
+
+}  // namespace bundle
+
+// Writes a bundle of `object`, compiled for `triple`, exporting `interface`.
+void WriteBundle(const BundleInterface& interface, std::string_view triple,
+                 llvm::MemoryBufferRef object, llvm::raw_ostream& out);
+
+// Precompiled definitions: object code and the prototypes needed to call it, loaded without
+// parsing or compiling anything.
+class Bundle {
+public:
+    // Maps the file at `path`. Returns null and logs an error if it is not a valid bundle.
+    static std::unique_ptr<Bundle> Open(const std::string& path);
+    static std::unique_ptr<Bundle> Create(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+    std::string_view GetTriple() const;
+    const BundleInterface& GetInterface() const;
+    llvm::MemoryBufferRef GetObject() const;
+
+private:
+    explicit Bundle(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+    bool Init();
+
+    std::unique_ptr<llvm::MemoryBuffer> buffer_;
+    std::string_view triple_;
+    BundleInterface interface_;
+    std::string_view object_;
+};
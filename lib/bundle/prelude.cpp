@@ -0,0 +1,35 @@
+#include "prelude.h"
+
+std::unique_ptr<Prelude> Prelude::Create(const Bundle& bundle) {
+    auto jit = Jit::Create();
+    if (!jit || !jit->AddObject(bundle.GetObject())) {
+        return nullptr;
+    }
+    std::unique_ptr<Prelude> prelude(
+        new Prelude(std::move(jit), bundle.GetInterface(), std::string(bundle.GetTriple())));
+    // Everything is compiled now, so lookups from sessions never touch this Jit.
+    for (const auto& proto : prelude->interface_.definitions) {
+        auto* address = prelude->jit_->Lookup(proto.name);
+        if (!address) {
+            return nullptr;
+        }
+        prelude->symbols_[proto.name] = address;
+    }
+    return prelude;
+}
+
+Prelude::Prelude(std::unique_ptr<Jit> jit, BundleInterface interface, std::string triple)
+    : jit_(std::move(jit)), interface_(std::move(interface)), triple_(std::move(triple)) {
+}
+
+const BundleInterface& Prelude::GetInterface() const {
+    return interface_;
+}
+
+const std::map<std::string, void*>& Prelude::GetSymbols() const {
+    return symbols_;
+}
+
+std::string_view Prelude::GetTriple() const {
+    return triple_;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <bundle/bundle.h>
+#include <jit/jit.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+// A bundle linked once, whose code many Repls share instead of each linking their own copy.
+// Read-only once created, so Repls on any thread may use it.
+class Prelude {
+public:
+    // Links `bundle` into a Jit of its own. Returns null and logs an error if it fails.
+    static std::unique_ptr<Prelude> Create(const Bundle& bundle);
+
+    const BundleInterface& GetInterface() const;
+
+    // Addresses of the functions the bundle defines.
+    const std::map<std::string, void*>& GetSymbols() const;
+
+    std::string_view GetTriple() const;
+
+private:
+    Prelude(std::unique_ptr<Jit> jit, BundleInterface interface, std::string triple);
+
+    std::unique_ptr<Jit> jit_;
+    BundleInterface interface_;
+    std::string triple_;
+    std::map<std::string, void*> symbols_;
+};
@@ -1,6 +1,497 @@
 #include "codegen.h"
 
+#include <overloaded.h>
+#include <runtime/parallel.h>
+#include <stats/stats.h>
+
+#include <llvm/IR/Dominators.h>
+#include <llvm/Transforms/Utils/PromoteMemToReg.h>
+
+#include <algorithm>
+#include <cmath>
 #include <format>
+#include <optional>
+
+namespace {
+
+struct MathIntrinsic {
+    std::string_view name;
+    size_t arity;
+    llvm::Intrinsic::ID id;
+};
+
+// Well-known libm externs that LLVM can fold, hoist and vectorize when emitted as intrinsics.
+constexpr MathIntrinsic kMathIntrinsics[] = {
+    {"sin", 1, llvm::Intrinsic::sin},
+    {"cos", 1, llvm::Intrinsic::cos},
+    {"exp", 1, llvm::Intrinsic::exp},
+    {"exp2", 1, llvm::Intrinsic::exp2},
+    {"log", 1, llvm::Intrinsic::log},
+    {"log2", 1, llvm::Intrinsic::log2},
+    {"log10", 1, llvm::Intrinsic::log10},
+    {"sqrt", 1, llvm::Intrinsic::sqrt},
+    {"fabs", 1, llvm::Intrinsic::fabs},
+    {"floor", 1, llvm::Intrinsic::floor},
+    {"ceil", 1, llvm::Intrinsic::ceil},
+    {"trunc", 1, llvm::Intrinsic::trunc},
+    {"round", 1, llvm::Intrinsic::round},
+    {"pow", 2, llvm::Intrinsic::pow},
+    {"fmin", 2, llvm::Intrinsic::minnum},
+    {"fmax", 2, llvm::Intrinsic::maxnum},
+    {"copysign", 2, llvm::Intrinsic::copysign},
+    {"fma", 3, llvm::Intrinsic::fma},
+};
+
+std::optional<llvm::Intrinsic::ID> GetMathIntrinsic(const std::string& name, size_t arity) {
+    for (const auto& intrinsic : kMathIntrinsics) {
+        if (intrinsic.name == name && intrinsic.arity == arity) {
+            return intrinsic.id;
+        }
+    }
+    return std::nullopt;
+}
+
+// Builtins over vectors: `extract(v, lane)`, with a constant lane, and the horizontal
+// reductions `hsum`, `hprod`, `hmin` and `hmax`.
+bool IsVectorBuiltin(std::string_view name) {
+    return name == "extract" || name == "hsum" || name == "hprod" || name == "hmin" ||
+           name == "hmax";
+}
+
+// Intrinsics that lower to a few instructions rather than a libm call.
+bool IsCheapIntrinsic(llvm::Intrinsic::ID id) {
+    switch (id) {
+        case llvm::Intrinsic::sqrt:
+        case llvm::Intrinsic::fabs:
+        case llvm::Intrinsic::floor:
+        case llvm::Intrinsic::ceil:
+        case llvm::Intrinsic::trunc:
+        case llvm::Intrinsic::round:
+        case llvm::Intrinsic::minnum:
+        case llvm::Intrinsic::maxnum:
+        case llvm::Intrinsic::copysign:
+        case llvm::Intrinsic::fma:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Arms of a conditional with at most this many operations are both evaluated, then selected
+// between.
+constexpr size_t kMaxSelectArmCost = 8;
+
+// Adds the operations `node` takes to `cost`. Returns false if it can't be evaluated when its
+// value isn't needed: calls that may have side effects or are expensive, and loops.
+bool AddSpeculationCost(const ast::Node& node, const CodegenCtx& ctx, size_t* cost) {
+    return std::visit(
+        Overloaded{
+            [](const ast::Number&) { return true; },
+            [](const ast::Variable&) { return true; },
+            [&](const ast::BinaryOp& op) {
+                ++*cost;
+                return AddSpeculationCost(*op.lhs, ctx, cost) &&
+                       AddSpeculationCost(*op.rhs, ctx, cost);
+            },
+            [&](const ast::CallExpression& expr) {
+                if (ctx.defined_functions.contains(expr.callee) ||
+                    ctx.host_functions.contains(expr.callee)) {
+                    return false;
+                }
+                auto id = GetMathIntrinsic(expr.callee, expr.args.size());
+                if (!ast::ParseType(expr.callee) && !IsVectorBuiltin(expr.callee) &&
+                    (!id || !IsCheapIntrinsic(*id))) {
+                    return false;
+                }
+                ++*cost;
+                return std::ranges::all_of(expr.args, [&](const ast::NodePtr& arg) {
+                    return AddSpeculationCost(*arg, ctx, cost);
+                });
+            },
+            [](const ast::ForLoop&) { return false; },
+            [&](const ast::Conditional& cond) {
+                ++*cost;
+                return AddSpeculationCost(*cond.cond, ctx, cost) &&
+                       AddSpeculationCost(*cond.then_value, ctx, cost) &&
+                       AddSpeculationCost(*cond.else_value, ctx, cost);
+            },
+            [&](const ast::VarBinding& binding) {
+                return AddSpeculationCost(*binding.init, ctx, cost) &&
+                       AddSpeculationCost(*binding.body, ctx, cost);
+            },
+        },
+        node);
+}
+
+bool IsCheapToSpeculate(const ast::Node& node, const CodegenCtx& ctx) {
+    size_t cost = 0;
+    return AddSpeculationCost(node, ctx, &cost) && cost <= kMaxSelectArmCost;
+}
+
+llvm::Type* GetType(ast::Type type, llvm::LLVMContext& context) {
+    if (auto lanes = ast::GetLaneCount(type); lanes > 1) {
+        return llvm::FixedVectorType::get(GetType(ast::GetElementType(type), context), lanes);
+    }
+    switch (type) {
+        case ast::Type::kFloat:
+            return llvm::Type::getFloatTy(context);
+        case ast::Type::kInt64:
+            return llvm::Type::getInt64Ty(context);
+        default:
+            return llvm::Type::getDoubleTy(context);
+    }
+}
+
+std::string_view TypeName(llvm::Type* type) {
+    for (auto ast_type : ast::kTypes) {
+        if (GetType(ast_type, type->getContext()) == type) {
+            return ast::TypeName(ast_type);
+        }
+    }
+    return "unknown";
+}
+
+llvm::FunctionType* GetFunctionType(const ast::Prototype& proto, llvm::LLVMContext& context) {
+    std::vector<llvm::Type*> params;
+    for (auto type : proto.arg_types) {
+        params.push_back(GetType(type, context));
+    }
+    return llvm::FunctionType::get(GetType(proto.return_type, context), params, false);
+}
+
+// Number literals and operators over them, which take the type they are used as.
+bool IsLiteral(const ast::Node& node) {
+    if (auto* op = std::get_if<ast::BinaryOp>(&node)) {
+        return IsLiteral(*op->lhs) && IsLiteral(*op->rhs);
+    }
+    return std::holds_alternative<ast::Number>(node);
+}
+
+// `value`, generated from `node`, as a value of `type`. Literals are folded as doubles, then
+// converted if that is exact for integers. Scalars of the lane type of a vector are broadcast
+// to all lanes. Other values must have the type already: implicit conversions could silently
+// lose precision.
+llvm::Value* Coerce(llvm::Value* value, const ast::Node& node, llvm::Type* type,
+                    CodegenCtx* ctx) {
+    if (!value || value->getType() == type) {
+        return value;
+    }
+    auto* vector_type = llvm::dyn_cast<llvm::FixedVectorType>(type);
+    if (vector_type && value->getType() == vector_type->getElementType()) {
+        return ctx->builder.CreateVectorSplat(vector_type->getNumElements(), value, "splattmp");
+    }
+    auto* constant = llvm::dyn_cast<llvm::ConstantFP>(value);
+    if (!constant || !IsLiteral(node)) {
+        return LogError(std::format("Expected a {} value, got {}; convert it with {}(...)",
+                                    TypeName(type), TypeName(value->getType()), TypeName(type)));
+    }
+    double literal = constant->getValueAPF().convertToDouble();
+    auto* element_type = type->getScalarType();
+    llvm::Constant* result = nullptr;
+    if (element_type->isIntegerTy()) {
+        if (literal != std::trunc(literal) || literal < -0x1p63 || literal >= 0x1p63) {
+            return LogError(std::format("{} is not an i64", literal));
+        }
+        result = llvm::ConstantInt::get(element_type, static_cast<int64_t>(literal), true);
+    } else {
+        result = llvm::ConstantFP::get(element_type, literal);
+    }
+    if (vector_type) {
+        return llvm::ConstantVector::getSplat(vector_type->getElementCount(), result);
+    }
+    return result;
+}
+
+// Whether unifying converts the lhs to the type of the rhs: if the rhs is a vector and the lhs
+// a scalar, or else if the lhs is a literal.
+bool UnifiesToRhs(llvm::Value* lhs, const ast::Node& lhs_node, llvm::Value* rhs) {
+    if (lhs->getType()->isVectorTy() != rhs->getType()->isVectorTy()) {
+        return rhs->getType()->isVectorTy();
+    }
+    return IsLiteral(lhs_node);
+}
+
+// Gives the operands the same type, as chosen by UnifiesToRhs.
+bool Unify(llvm::Value** lhs, const ast::Node& lhs_node, llvm::Value** rhs,
+           const ast::Node& rhs_node, CodegenCtx* ctx) {
+    if (UnifiesToRhs(*lhs, lhs_node, *rhs)) {
+        *lhs = Coerce(*lhs, lhs_node, (*rhs)->getType(), ctx);
+    } else {
+        *rhs = Coerce(*rhs, rhs_node, (*lhs)->getType(), ctx);
+    }
+    return *lhs && *rhs;
+}
+
+// Whether `value` is not zero, which is what conditions test.
+llvm::Value* IsTrue(llvm::Value* value, const llvm::Twine& name, CodegenCtx* ctx) {
+    if (value->getType()->isVectorTy()) {
+        return LogError(std::format("Conditions can't be {} vectors, reduce them first",
+                                    TypeName(value->getType())));
+    }
+    auto* zero = llvm::Constant::getNullValue(value->getType());
+    if (value->getType()->isIntegerTy()) {
+        return ctx->builder.CreateICmpNE(value, zero, name);
+    }
+    return ctx->builder.CreateFCmpONE(value, zero, name);
+}
+
+// Converts `value` to `type`. Floating-point values convert to i64 rounding toward zero and
+// saturating, with NaN becoming 0, so every input has a defined result. Scalars convert to
+// vectors by converting to the lane type and broadcasting, and vectors to vectors with as
+// many lanes lane by lane.
+llvm::Value* Convert(llvm::Value* value, llvm::Type* type, CodegenCtx* ctx) {
+    auto* from = value->getType();
+    if (from == type) {
+        return value;
+    }
+    auto* vector_type = llvm::dyn_cast<llvm::FixedVectorType>(type);
+    auto* from_vector_type = llvm::dyn_cast<llvm::FixedVectorType>(from);
+    if (vector_type && !from_vector_type) {
+        auto* lane = Convert(value, vector_type->getElementType(), ctx);
+        return ctx->builder.CreateVectorSplat(vector_type->getNumElements(), lane, "splattmp");
+    }
+    if (from_vector_type &&
+        (!vector_type || vector_type->getNumElements() != from_vector_type->getNumElements())) {
+        return LogError(std::format("Can't convert {} to {}", TypeName(from), TypeName(type)));
+    }
+    if (type->isIntegerTy()) {
+        return ctx->builder.CreateIntrinsic(llvm::Intrinsic::fptosi_sat, {type, from}, {value},
+                                            nullptr, "convtmp");
+    }
+    if (from->isIntegerTy()) {
+        return ctx->builder.CreateSIToFP(value, type, "convtmp");
+    }
+    return ctx->builder.CreateFPCast(value, type, "convtmp");
+}
+
+// `double(x)`, `float(x)`, `i64(x)` or `vec4(x)`, or `vec4(a, b, c, d)` which builds a vector
+// from its lanes.
+llvm::Value* CodegenConversion(const ast::CallExpression& expr, llvm::Type* type,
+                               CodegenCtx* ctx) {
+    if (auto* vector_type = llvm::dyn_cast<llvm::FixedVectorType>(type);
+        vector_type && expr.args.size() == vector_type->getNumElements()) {
+        llvm::Value* vector = llvm::PoisonValue::get(type);
+        for (size_t i = 0; i < expr.args.size(); ++i) {
+            auto* lane = Coerce(Codegen(*expr.args[i], ctx), *expr.args[i],
+                                vector_type->getElementType(), ctx);
+            if (!lane) {
+                return nullptr;
+            }
+            vector = ctx->builder.CreateInsertElement(vector, lane, i, "vectmp");
+        }
+        return vector;
+    }
+    if (expr.args.size() != 1) {
+        if (type->isVectorTy()) {
+            return LogError(std::format("{} takes one argument or one per lane", expr.callee));
+        }
+        return LogError(std::format("Conversion to {} takes one argument", expr.callee));
+    }
+    auto* value = Codegen(*expr.args[0], ctx);
+    return value ? Convert(value, type, ctx) : nullptr;
+}
+
+llvm::Value* CodegenVectorBuiltin(const ast::CallExpression& expr, CodegenCtx* ctx) {
+    const size_t arity = expr.callee == "extract" ? 2 : 1;
+    if (expr.args.size() != arity) {
+        return LogError(std::format("{} takes {} arguments", expr.callee, arity));
+    }
+    auto* vector = Codegen(*expr.args[0], ctx);
+    if (!vector) {
+        return nullptr;
+    }
+    auto* type = llvm::dyn_cast<llvm::FixedVectorType>(vector->getType());
+    if (!type) {
+        return LogError(std::format("{} takes a vector, not {}", expr.callee,
+                                    TypeName(vector->getType())));
+    }
+    auto& builder = ctx->builder;
+    if (expr.callee == "extract") {
+        auto* lane = std::get_if<ast::Number>(expr.args[1].get());
+        if (!lane || lane->value != std::trunc(lane->value) || lane->value < 0 ||
+            lane->value >= type->getNumElements()) {
+            return LogError(std::format("The lane of extract must be a number from 0 to {}",
+                                        type->getNumElements() - 1));
+        }
+        return builder.CreateExtractElement(vector, static_cast<uint64_t>(lane->value),
+                                            "lanetmp");
+    }
+    // Sums and products are in lane order unless the floating-point mode allows reassociation.
+    if (expr.callee == "hsum") {
+        return builder.CreateFAddReduce(llvm::ConstantFP::getNegativeZero(type->getElementType()),
+                                        vector);
+    }
+    if (expr.callee == "hprod") {
+        return builder.CreateFMulReduce(llvm::ConstantFP::get(type->getElementType(), 1.0),
+                                        vector);
+    }
+    if (expr.callee == "hmin") {
+        return builder.CreateFPMinReduce(vector);
+    }
+    return builder.CreateFPMaxReduce(vector);
+}
+
+// Binds `name` in `named_values` for the lifetime of the scope, then restores the parameter or
+// outer variable it shadows.
+class ScopedBinding {
+public:
+    ScopedBinding(CodegenCtx* ctx, std::string name) : ctx_(ctx), name_(std::move(name)) {
+        if (auto it = ctx_->named_values.find(name_); it != ctx_->named_values.end()) {
+            shadowed_ = it->second;
+        }
+    }
+
+    ~ScopedBinding() {
+        if (shadowed_) {
+            ctx_->named_values[name_] = *shadowed_;
+        } else {
+            ctx_->named_values.erase(name_);
+        }
+    }
+
+    ScopedBinding(const ScopedBinding&) = delete;
+    ScopedBinding& operator=(const ScopedBinding&) = delete;
+
+    void Set(llvm::Value* value) {
+        ctx_->named_values[name_] = value;
+    }
+
+private:
+    CodegenCtx* ctx_;
+    std::string name_;
+    std::optional<llvm::Value*> shadowed_;
+};
+
+// Allocas go first in the entry block, where mem2reg and SROA look for them.
+llvm::AllocaInst* CreateEntryBlockAlloca(llvm::Function* function, llvm::Type* type,
+                                         const std::string& name) {
+    auto& entry = function->getEntryBlock();
+    llvm::IRBuilder<> builder(&entry, entry.begin());
+    return builder.CreateAlloca(type, nullptr, name);
+}
+
+// Turns the allocas of `var` bindings into registers, as mem2reg does.
+void PromoteAllocas(llvm::Function* function) {
+    std::vector<llvm::AllocaInst*> allocas;
+    for (auto& inst : function->getEntryBlock()) {
+        if (auto* alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst)) {
+            if (llvm::isAllocaPromotable(alloca)) {
+                allocas.push_back(alloca);
+            }
+        }
+    }
+    if (allocas.empty()) {
+        return;
+    }
+    llvm::DominatorTree dominators(*function);
+    llvm::PromoteMemToReg(allocas, dominators);
+}
+
+// With debug info on, gives `function` a subprogram at the line of `proto` and attributes the
+// instructions built next to that line.
+void SetDebugLocation(llvm::Function* function, const ast::Prototype& proto, CodegenCtx* ctx) {
+    auto* debug_info = ctx->GetDebugInfo();
+    if (!debug_info) {
+        return;
+    }
+    auto* unit = ctx->GetCompileUnit();
+    const auto line = static_cast<unsigned>(proto.line);
+    auto* type = debug_info->createSubroutineType(debug_info->getOrCreateTypeArray({}));
+    auto* subprogram = debug_info->createFunction(
+        unit, function->getName(), {}, unit->getFile(), line, type, line,
+        llvm::DINode::FlagPrototyped,
+        llvm::DISubprogram::SPFlagDefinition | llvm::DISubprogram::SPFlagOptimized);
+    function->setSubprogram(subprogram);
+    ctx->builder.SetCurrentDebugLocation(llvm::DILocation::get(ctx->context, line, 0, subprogram));
+}
+
+llvm::Value* CodegenHostCall(const ast::CallExpression& expr, const HostFunction& host,
+                             CodegenCtx* ctx) {
+    if (host.arity != expr.args.size()) {
+        return LogError(std::format("Invalid number of arguments passed ({} while expected {})",
+                                    expr.args.size(), host.arity));
+    }
+    auto* double_type = llvm::Type::getDoubleTy(ctx->context);
+    std::vector<llvm::Type*> params;
+    std::vector<llvm::Value*> args;
+    if (host.context) {
+        params.push_back(llvm::PointerType::getUnqual(ctx->context));
+        args.push_back(ctx->module->getOrInsertGlobal(HostContextSymbol(expr.callee),
+                                                      ctx->builder.getInt8Ty()));
+    }
+    for (auto& arg : expr.args) {
+        auto argv = Coerce(Codegen(*arg, ctx), *arg, double_type, ctx);
+        if (!argv) {
+            return nullptr;
+        }
+        params.push_back(double_type);
+        args.push_back(argv);
+    }
+    auto* type = llvm::FunctionType::get(double_type, params, false);
+    auto callee = ctx->module->getOrInsertFunction(HostFunctionSymbol(expr.callee), type);
+    return ctx->builder.CreateCall(callee, args, "calltmp");
+}
+
+// A pointer to the function named by `node`, which must take doubles as `kind` says.
+llvm::Value* CodegenFunctionArgument(const ast::Node& node, ast::BuiltinArg kind,
+                                     CodegenCtx* ctx) {
+    auto* var = std::get_if<ast::Variable>(&node);
+    if (!var) {
+        return LogError("Parallel builtins take functions by name");
+    }
+    const size_t arity = kind == ast::BuiltinArg::kIndexFunction ? 1 : 2;
+    auto* double_type = llvm::Type::getDoubleTy(ctx->context);
+    std::vector<llvm::Type*> params(arity, double_type);
+    auto* type = llvm::FunctionType::get(double_type, params, false);
+    if (!ctx->defined_functions.contains(var->name)) {
+        if (auto it = ctx->host_functions.find(var->name); it != ctx->host_functions.end()) {
+            // Callable objects need their context, which a plain function pointer can't pass.
+            if (it->second.context || it->second.arity != arity) {
+                return LogError(std::format("{} must be a plain host function of {} doubles",
+                                            var->name, arity));
+            }
+            return ctx->module->getOrInsertFunction(HostFunctionSymbol(var->name), type)
+                .getCallee();
+        }
+    }
+    llvm::Function* function = ctx->GetFunction(var->name);
+    if (!function) {
+        return LogError(std::format("Unknown function {}", var->name));
+    }
+    if (function->getFunctionType() != type) {
+        return LogError(std::format("{} must take {} doubles and return a double", var->name,
+                                    arity));
+    }
+    return function;
+}
+
+// Calls the runtime by its symbol, which runs the functions passed on the work-stealing pool.
+llvm::Value* CodegenParallelBuiltin(const ast::CallExpression& expr,
+                                    std::span<const ast::BuiltinArg> kinds, CodegenCtx* ctx) {
+    if (expr.args.size() != kinds.size()) {
+        return LogError(std::format("Invalid number of arguments passed ({} while expected {})",
+                                    expr.args.size(), kinds.size()));
+    }
+    auto* double_type = llvm::Type::getDoubleTy(ctx->context);
+    std::vector<llvm::Type*> params;
+    std::vector<llvm::Value*> args;
+    for (size_t i = 0; i < kinds.size(); ++i) {
+        auto& arg = *expr.args[i];
+        auto* argv = kinds[i] == ast::BuiltinArg::kValue
+                         ? Coerce(Codegen(arg, ctx), arg, double_type, ctx)
+                         : CodegenFunctionArgument(arg, kinds[i], ctx);
+        if (!argv) {
+            return nullptr;
+        }
+        params.push_back(argv->getType());
+        args.push_back(argv);
+    }
+    auto* type = llvm::FunctionType::get(double_type, params, false);
+    auto callee = ctx->module->getOrInsertFunction(runtime::GetSymbolName(expr.callee), type);
+    return ctx->builder.CreateCall(callee, args, "calltmp");
+}
+
+}  // namespace
 
 llvm::Value* Codegen(const ast::Number& number, CodegenCtx* ctx) {
     return llvm::ConstantFP::get(ctx->context, llvm::APFloat(number.value));
@@ -11,32 +502,56 @@ llvm::Value* Codegen(const ast::Variable& var, CodegenCtx* ctx) {
     if (it == ctx->named_values.end()) {
         return LogError(std::format("Unknown variable name {}", var.name));
     }
+    if (auto* alloca = llvm::dyn_cast<llvm::AllocaInst>(it->second)) {
+        return ctx->builder.CreateLoad(alloca->getAllocatedType(), alloca, var.name);
+    }
     return it->second;
 }
 
 llvm::Value* Codegen(const ast::BinaryOp& op, CodegenCtx* ctx) {
     auto l = Codegen(*op.lhs, ctx);
     auto r = Codegen(*op.rhs, ctx);
-    if (!l || !r) {
+    if (!l || !r || !Unify(&l, *op.lhs, &r, *op.rhs, ctx)) {
         return nullptr;
     }
 
+    auto& builder = ctx->builder;
+    auto* type = l->getType();
+    const bool is_integer = type->isIntegerTy();
     if (op.op == "+") {
-        return ctx->builder.CreateFAdd(l, r, "addtmp");
+        return is_integer ? builder.CreateAdd(l, r, "addtmp") : builder.CreateFAdd(l, r, "addtmp");
     } else if (op.op == "-") {
-        return ctx->builder.CreateFSub(l, r, "subtmp");
+        return is_integer ? builder.CreateSub(l, r, "subtmp") : builder.CreateFSub(l, r, "subtmp");
     } else if (op.op == "*") {
-        return ctx->builder.CreateFMul(l, r, "multmp");
+        return is_integer ? builder.CreateMul(l, r, "multmp") : builder.CreateFMul(l, r, "multmp");
     } else if (op.op == "<") {
-        auto result = ctx->builder.CreateFCmpULT(l, r, "cmptmp");
-        return ctx->builder.CreateUIToFP(result, llvm::Type::getDoubleTy(ctx->context), "booltmp");
+        // 1 or 0, of the type of the operands.
+        if (is_integer) {
+            return builder.CreateZExt(builder.CreateICmpSLT(l, r, "cmptmp"), type, "booltmp");
+        }
+        return builder.CreateUIToFP(builder.CreateFCmpULT(l, r, "cmptmp"), type, "booltmp");
     } else {
         return LogError(std::format("Invalid binary operator {}", op.op));
     }
 }
 
 llvm::Value* Codegen(const ast::CallExpression& expr, CodegenCtx* ctx) {
-    llvm::Function* callee = ctx->module.getFunction(expr.callee);
+    if (!ctx->defined_functions.contains(expr.callee)) {
+        if (auto it = ctx->host_functions.find(expr.callee); it != ctx->host_functions.end()) {
+            return CodegenHostCall(expr, it->second, ctx);
+        }
+        // Conversions look like calls, unless a definition has the name of the type.
+        if (auto type = ast::ParseType(expr.callee)) {
+            return CodegenConversion(expr, GetType(*type, ctx->context), ctx);
+        }
+        if (IsVectorBuiltin(expr.callee)) {
+            return CodegenVectorBuiltin(expr, ctx);
+        }
+        if (auto kinds = ast::GetParallelBuiltinArgs(expr.callee); !kinds.empty()) {
+            return CodegenParallelBuiltin(expr, kinds, ctx);
+        }
+    }
+    llvm::Function* callee = ctx->GetFunction(expr.callee);
     if (!callee) {
         return LogError(std::format("Unknown function {}", expr.callee));
     }
@@ -54,20 +569,180 @@ llvm::Value* Codegen(const ast::CallExpression& expr, CodegenCtx* ctx) {
         args.push_back(argv);
     }
 
+    // A user definition named like a libm function keeps its own semantics.
+    if (!ctx->defined_functions.contains(expr.callee)) {
+        if (auto id = GetMathIntrinsic(expr.callee, args.size())) {
+            // Math on floats or vectors uses the variant of the intrinsic for their type.
+            auto* type = llvm::Type::getDoubleTy(ctx->context);
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (!IsLiteral(*expr.args[i])) {
+                    if (!args[i]->getType()->isIntegerTy()) {
+                        type = args[i]->getType();
+                    }
+                    break;
+                }
+            }
+            for (size_t i = 0; i < args.size(); ++i) {
+                args[i] = Coerce(args[i], *expr.args[i], type, ctx);
+                if (!args[i]) {
+                    return nullptr;
+                }
+            }
+            return ctx->builder.CreateIntrinsic(*id, {type}, args, nullptr, "calltmp");
+        }
+    }
+    for (size_t i = 0; i < args.size(); ++i) {
+        args[i] = Coerce(args[i], *expr.args[i], callee->getArg(i)->getType(), ctx);
+        if (!args[i]) {
+            return nullptr;
+        }
+    }
     return ctx->builder.CreateCall(callee, args, "calltmp");
 }
 
+llvm::Value* Codegen(const ast::ForLoop& loop, CodegenCtx* ctx) {
+    auto* start = Codegen(*loop.start, ctx);
+    if (!start) {
+        return nullptr;
+    }
+    auto& builder = ctx->builder;
+    // The variable has the type of its start value.
+    auto* type = start->getType();
+    auto* function = builder.GetInsertBlock()->getParent();
+
+    ScopedBinding binding(ctx, loop.var);
+    auto condition = [&](llvm::Value* var) -> llvm::Value* {
+        binding.Set(var);
+        auto* cond = Codegen(*loop.cond, ctx);
+        return cond ? IsTrue(cond, "loopcond", ctx) : nullptr;
+    };
+
+    // A rotated loop: a guard skips it if the condition fails right away, and the latch
+    // checks it again, so the header has a single back edge and the step is the only update
+    // of the induction variable. This is the shape the vectorizer and unroller expect.
+    auto* guard = condition(start);
+    if (!guard) {
+        return nullptr;
+    }
+    auto* preheader = builder.GetInsertBlock();
+    auto* header = llvm::BasicBlock::Create(ctx->context, "loop", function);
+    auto* exit = llvm::BasicBlock::Create(ctx->context, "afterloop", function);
+    builder.CreateCondBr(guard, header, exit);
+
+    builder.SetInsertPoint(header);
+    auto* var = builder.CreatePHI(type, 2, loop.var);
+    var->addIncoming(start, preheader);
+    binding.Set(var);
+    if (!Codegen(*loop.body, ctx)) {
+        return nullptr;
+    }
+    llvm::Constant* one = type->isIntegerTy() ? llvm::ConstantInt::get(type, 1)
+                                              : llvm::ConstantFP::get(type, 1.0);
+    auto* step = loop.step ? Coerce(Codegen(*loop.step, ctx), *loop.step, type, ctx) : one;
+    if (!step) {
+        return nullptr;
+    }
+    auto* next = type->isIntegerTy() ? builder.CreateAdd(var, step, "nextvar")
+                                     : builder.CreateFAdd(var, step, "nextvar");
+    auto* latch_cond = condition(next);
+    if (!latch_cond) {
+        return nullptr;
+    }
+    var->addIncoming(next, builder.GetInsertBlock());
+    builder.CreateCondBr(latch_cond, header, exit);
+
+    builder.SetInsertPoint(exit);
+    return llvm::ConstantFP::get(ctx->context, llvm::APFloat(0.0));
+}
+
+llvm::Value* Codegen(const ast::Conditional& cond, CodegenCtx* ctx) {
+    auto* cond_value = Codegen(*cond.cond, ctx);
+    if (!cond_value) {
+        return nullptr;
+    }
+    auto& builder = ctx->builder;
+    auto* flag = IsTrue(cond_value, "ifcond", ctx);
+    if (!flag) {
+        return nullptr;
+    }
+
+    if (IsCheapToSpeculate(*cond.then_value, *ctx) &&
+        IsCheapToSpeculate(*cond.else_value, *ctx)) {
+        auto* then_value = Codegen(*cond.then_value, ctx);
+        auto* else_value = then_value ? Codegen(*cond.else_value, ctx) : nullptr;
+        if (!else_value ||
+            !Unify(&then_value, *cond.then_value, &else_value, *cond.else_value, ctx)) {
+            return nullptr;
+        }
+        return builder.CreateSelect(flag, then_value, else_value, "iftmp");
+    }
+
+    auto* function = builder.GetInsertBlock()->getParent();
+    auto* then_block = llvm::BasicBlock::Create(ctx->context, "then", function);
+    auto* else_block = llvm::BasicBlock::Create(ctx->context, "else", function);
+    auto* merge_block = llvm::BasicBlock::Create(ctx->context, "ifcont", function);
+    builder.CreateCondBr(flag, then_block, else_block);
+
+    builder.SetInsertPoint(then_block);
+    auto* then_value = Codegen(*cond.then_value, ctx);
+    if (!then_value) {
+        return nullptr;
+    }
+    builder.CreateBr(merge_block);
+    // The arm may have added blocks of its own, the PHI takes the last one.
+    then_block = builder.GetInsertBlock();
+
+    builder.SetInsertPoint(else_block);
+    auto* else_value = Codegen(*cond.else_value, ctx);
+    if (!else_value) {
+        return nullptr;
+    }
+    builder.CreateBr(merge_block);
+    else_block = builder.GetInsertBlock();
+    // Broadcasts to a vector need code, at the end of the arm they convert.
+    if (UnifiesToRhs(then_value, *cond.then_value, else_value)) {
+        builder.SetInsertPoint(then_block->getTerminator());
+        then_value = Coerce(then_value, *cond.then_value, else_value->getType(), ctx);
+    } else {
+        builder.SetInsertPoint(else_block->getTerminator());
+        else_value = Coerce(else_value, *cond.else_value, then_value->getType(), ctx);
+    }
+    if (!then_value || !else_value) {
+        return nullptr;
+    }
+
+    builder.SetInsertPoint(merge_block);
+    auto* phi = builder.CreatePHI(then_value->getType(), 2, "iftmp");
+    phi->addIncoming(then_value, then_block);
+    phi->addIncoming(else_value, else_block);
+    return phi;
+}
+
+llvm::Value* Codegen(const ast::VarBinding& binding, CodegenCtx* ctx) {
+    // The initializer still sees what the variable shadows.
+    auto* init = Codegen(*binding.init, ctx);
+    if (!init) {
+        return nullptr;
+    }
+    auto* function = ctx->builder.GetInsertBlock()->getParent();
+    auto* alloca = CreateEntryBlockAlloca(function, init->getType(), binding.var);
+    ctx->builder.CreateStore(init, alloca);
+
+    ScopedBinding scope(ctx, binding.var);
+    scope.Set(alloca);
+    return Codegen(*binding.body, ctx);
+}
+
 llvm::Value* Codegen(const ast::Node& node, CodegenCtx* ctx) {
     return std::visit([ctx](const auto& value) { return Codegen(value, ctx); }, node);
 }
 
 llvm::Function* Codegen(const ast::Prototype& proto, CodegenCtx* ctx) {
-    std::vector<llvm::Type*> doubles(proto.args.size(), llvm::Type::getDoubleTy(ctx->context));
-    llvm::FunctionType* ft =
-        llvm::FunctionType::get(llvm::Type::getDoubleTy(ctx->context), doubles, false);
+    stats::ScopedTimer timer(stats::Phase::kCodegen);
+    llvm::FunctionType* ft = GetFunctionType(proto, ctx->context);
 
     llvm::Function* f =
-        llvm::Function::Create(ft, llvm::Function::ExternalLinkage, proto.name, ctx->module);
+        llvm::Function::Create(ft, llvm::Function::ExternalLinkage, proto.name, *ctx->module);
 
     size_t idx = 0;
     for (auto& arg : f->args()) {
@@ -77,17 +752,40 @@ llvm::Function* Codegen(const ast::Prototype& proto, CodegenCtx* ctx) {
 }
 
 llvm::Function* Codegen(const ast::Function& function_expr, CodegenCtx* ctx) {
-    llvm::Function* function = ctx->module.getFunction(function_expr.GetName());
-
-    if (!function) {
-        function = Codegen(function_expr.proto, ctx);
-    }
+    stats::ScopedTimer timer(stats::Phase::kCodegen);
+    const auto& name = function_expr.GetName();
+    // Declared from this prototype unless the module already has it. `ctx` only registers the
+    // function once its body verifies, but the body sees it as defined to call itself.
+    llvm::Function* function = ctx->module->getNamedValue(name)
+                                   ? ctx->GetFunction(name)
+                                   : Codegen(function_expr.proto, ctx);
     if (!function) {
         return nullptr;
     }
+    if (function->getFunctionType() != GetFunctionType(function_expr.proto, ctx->context)) {
+        return LogError(std::format("{} is declared with another signature", name));
+    }
+    const bool was_defined = !ctx->defined_functions.insert(name).second;
+    auto fail = [&](std::string_view error) -> llvm::Function* {
+        // Other functions of the module may call the declaration, and fail along with it.
+        if (function->use_empty()) {
+            function->eraseFromParent();
+        } else {
+            function->deleteBody();
+        }
+        if (!was_defined) {
+            ctx->defined_functions.erase(name);
+        }
+        return error.empty() ? nullptr : LogError(error);
+    };
 
     llvm::BasicBlock* bb = llvm::BasicBlock::Create(ctx->context, "entry", function);
     ctx->builder.SetInsertPoint(bb);
+    SetDebugLocation(function, function_expr.proto, ctx);
+
+    auto fp_mode = ctx->GetFpMode(name);
+    ctx->builder.setFastMathFlags(GetFastMathFlags(fp_mode));
+    SetFpModeAttributes(function, fp_mode);
 
     ctx->named_values.clear();
 
@@ -96,14 +794,113 @@ llvm::Function* Codegen(const ast::Function& function_expr, CodegenCtx* ctx) {
     }
 
     llvm::Value* generated = Codegen(*function_expr.body, ctx);
+    // Top-level expressions evaluate to doubles whatever the type of the expression.
+    if (generated && name == ast::kTopLevelExprName) {
+        generated = Convert(generated, function->getReturnType(), ctx);
+    } else {
+        generated = Coerce(generated, *function_expr.body, function->getReturnType(), ctx);
+    }
     if (!generated) {
-        function->eraseFromParent();
-        return nullptr;
+        return fail({});
     }
 
     ctx->builder.CreateRet(generated);
+    PromoteAllocas(function);
+    stats::Add(stats::Counter::kIrInstructions, function->getInstructionCount());
+
+    stats::ScopedTimer verify_timer(stats::Phase::kVerify);
     if (llvm::verifyFunction(*function)) {
-        return LogError("Function verification failed");
+        return fail("Function verification failed");
     }
+    ctx->function_protos[name] = function_expr.proto;
     return function;
 }
+
+llvm::GlobalAlias* CodegenAlias(const ast::Prototype& proto, llvm::Function* aliasee,
+                                CodegenCtx* ctx) {
+    if (aliasee->getFunctionType() != GetFunctionType(proto, ctx->context)) {
+        return LogError(std::format("Cannot alias {} to {} with a different signature", proto.name,
+                                    aliasee->getName().str()));
+    }
+    auto* alias = llvm::GlobalAlias::create(llvm::Function::ExternalLinkage, "", aliasee);
+
+    // Calls compiled against a previous 'extern' go through the alias from now on.
+    if (auto* decl = ctx->module->getFunction(proto.name)) {
+        if (!decl->isDeclaration()) {
+            alias->eraseFromParent();
+            return LogError(std::format("Function {} is already defined", proto.name));
+        }
+        alias->takeName(decl);
+        decl->replaceAllUsesWith(alias);
+        decl->eraseFromParent();
+    } else {
+        alias->setName(proto.name);
+    }
+    return alias;
+}
+
+llvm::Function* CodegenColumnKernel(const ast::Prototype& proto, CodegenCtx* ctx) {
+    stats::ScopedTimer timer(stats::Phase::kCodegen);
+    llvm::Function* callee = ctx->GetFunction(proto.name);
+    if (!callee) {
+        return LogError(std::format("Unknown function {}", proto.name));
+    }
+    auto& context = ctx->context;
+    auto& builder = ctx->builder;
+    auto* ptr_type = llvm::PointerType::getUnqual(context);
+    auto* i64_type = llvm::Type::getInt64Ty(context);
+    auto* type = llvm::FunctionType::get(llvm::Type::getVoidTy(context),
+                                         {ptr_type, ptr_type, i64_type, i64_type}, false);
+    auto* kernel = llvm::Function::Create(type, llvm::Function::ExternalLinkage,
+                                          GetColumnKernelName(proto.name), *ctx->module);
+    auto* columns = kernel->getArg(0);
+    auto* out = kernel->getArg(1);
+    auto* begin = kernel->getArg(2);
+    auto* end = kernel->getArg(3);
+    columns->setName("columns");
+    out->setName("out");
+    begin->setName("begin");
+    end->setName("end");
+    // The output is never read through the columns, which lets the loop vectorize.
+    kernel->addParamAttr(1, llvm::Attribute::NoAlias);
+
+    auto* entry = llvm::BasicBlock::Create(context, "entry", kernel);
+    auto* loop = llvm::BasicBlock::Create(context, "loop", kernel);
+    auto* exit = llvm::BasicBlock::Create(context, "exit", kernel);
+    builder.SetInsertPoint(entry);
+    SetDebugLocation(kernel, proto, ctx);
+    std::vector<llvm::Value*> column_ptrs;
+    for (size_t i = 0; i < proto.args.size(); ++i) {
+        auto* slot = builder.CreateConstInBoundsGEP1_64(ptr_type, columns, i);
+        column_ptrs.push_back(builder.CreateLoad(ptr_type, slot, proto.args[i]));
+    }
+    builder.CreateCondBr(builder.CreateICmpSLT(begin, end), loop, exit);
+
+    // Files hold values packed, so vectors may be less aligned than in registers.
+    auto load_align = [&](llvm::Type* type) {
+        return ctx->module->getDataLayout().getABITypeAlign(type->getScalarType());
+    };
+    builder.SetInsertPoint(loop);
+    auto* row = builder.CreatePHI(i64_type, 2, "row");
+    row->addIncoming(begin, entry);
+    std::vector<llvm::Value*> args;
+    for (size_t i = 0; i < proto.args.size(); ++i) {
+        auto* arg_type = callee->getArg(i)->getType();
+        auto* address = builder.CreateInBoundsGEP(arg_type, column_ptrs[i], row);
+        args.push_back(builder.CreateAlignedLoad(arg_type, address, load_align(arg_type)));
+    }
+    auto* result = builder.CreateCall(callee, args, "result");
+    auto* address = builder.CreateInBoundsGEP(result->getType(), out, row);
+    builder.CreateAlignedStore(result, address, load_align(result->getType()));
+    auto* next = builder.CreateAdd(row, llvm::ConstantInt::get(i64_type, 1), "nextrow", true,
+                                   true);
+    row->addIncoming(next, loop);
+    builder.CreateCondBr(builder.CreateICmpSLT(next, end), loop, exit);
+
+    builder.SetInsertPoint(exit);
+    builder.CreateRetVoid();
+    if (llvm::verifyFunction(*kernel)) {
+        return LogError("Function verification failed");
+    }
+    return kernel;
+}
@@ -6,6 +6,9 @@
 
 #include <llvm/IR/Verifier.h>
 
+#include <string>
+#include <string_view>
+
 llvm::Value* Codegen(const ast::Number& number, CodegenCtx* ctx);
 
 llvm::Value* Codegen(const ast::Variable& var, CodegenCtx* ctx);
@@ -14,8 +17,33 @@ llvm::Value* Codegen(const ast::BinaryOp& op, CodegenCtx* ctx);
 
 llvm::Value* Codegen(const ast::CallExpression& expr, CodegenCtx* ctx);
 
+llvm::Value* Codegen(const ast::ForLoop& loop, CodegenCtx* ctx);
+
+// Lowers to a select if both arms are cheap and free of side effects, so there is no branch
+// to mispredict, and to branches otherwise.
+llvm::Value* Codegen(const ast::Conditional& cond, CodegenCtx* ctx);
+
+// Keeps the variable in an entry-block alloca, which is promoted to a register once the
+// function is complete.
+llvm::Value* Codegen(const ast::VarBinding& binding, CodegenCtx* ctx);
+
 llvm::Value* Codegen(const ast::Node& node, CodegenCtx* ctx);
 
 llvm::Function* Codegen(const ast::Prototype& proto, CodegenCtx* ctx);
 
 llvm::Function* Codegen(const ast::Function& function_expr, CodegenCtx* ctx);
+
+// Defines `proto` as another name for an already generated function with the same body.
+llvm::GlobalAlias* CodegenAlias(const ast::Prototype& proto, llvm::Function* aliasee,
+                                CodegenCtx* ctx);
+
+// `name.columns`, see CodegenColumnKernel.
+inline std::string GetColumnKernelName(std::string_view name) {
+    return std::string(name) + ".columns";
+}
+
+// Generates `void name.columns(ptr columns, ptr out, i64 begin, i64 end)`, which calls the
+// function `proto` for the rows from `begin` to `end`. `columns` points to one array per
+// argument, in order, and the results are stored in `out`. Values are packed in the arrays,
+// with no padding between them.
+llvm::Function* CodegenColumnKernel(const ast::Prototype& proto, CodegenCtx* ctx);
@@ -0,0 +1,104 @@
+#include "codegen_ctx.h"
+
+#include <codegen/codegen.h>
+#include <util.h>
+
+#include <algorithm>
+#include <format>
+#include <utility>
+
+std::string HostFunctionSymbol(std::string_view name) {
+    return std::format("host.{}", name);
+}
+
+std::string HostContextSymbol(std::string_view name) {
+    return std::format("host.{}.context", name);
+}
+
+bool TakesAndReturnsDoubles(const ast::Prototype& proto) {
+    return proto.return_type == ast::Type::kDouble &&
+           std::ranges::all_of(proto.arg_types,
+                               [](ast::Type type) { return type == ast::Type::kDouble; });
+}
+
+CodegenCtx::CodegenCtx(std::string_view name, CodegenOptions options)
+    : ts_context(std::make_unique<llvm::LLVMContext>()),
+      context(*ts_context.getContext()),
+      module(std::make_unique<llvm::Module>(name, context)),
+      builder(context),
+      options(std::move(options)),
+      name_(name) {
+    StartDebugInfo();
+}
+
+llvm::Function* CodegenCtx::GetFunction(const std::string& name) {
+    if (auto* value = module->getNamedValue(name)) {
+        if (auto* alias = llvm::dyn_cast<llvm::GlobalAlias>(value)) {
+            return llvm::dyn_cast<llvm::Function>(alias->getAliaseeObject());
+        }
+        return llvm::dyn_cast<llvm::Function>(value);
+    }
+    if (auto it = function_protos.find(name); it != function_protos.end()) {
+        return Codegen(it->second, this);
+    }
+    return nullptr;
+}
+
+llvm::orc::ThreadSafeModule CodegenCtx::TakeModule() {
+    if (debug_info_) {
+        debug_info_->finalize();
+    }
+    auto next = std::make_unique<llvm::Module>(name_, context);
+    next->setDataLayout(module->getDataLayout());
+    next->setTargetTriple(module->getTargetTriple());
+    auto taken = std::exchange(module, std::move(next));
+    StartDebugInfo();
+    return llvm::orc::ThreadSafeModule(std::move(taken), ts_context);
+}
+
+llvm::DIBuilder* CodegenCtx::GetDebugInfo() {
+    return debug_info_.get();
+}
+
+llvm::DICompileUnit* CodegenCtx::GetCompileUnit() {
+    return compile_unit_;
+}
+
+void CodegenCtx::StartDebugInfo() {
+    if (!options.debug_info) {
+        return;
+    }
+    module->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                          llvm::DEBUG_METADATA_VERSION);
+    debug_info_ = std::make_unique<llvm::DIBuilder>(*module);
+    auto* file = debug_info_->createFile(options.source_name, ".");
+    compile_unit_ = debug_info_->createCompileUnit(llvm::dwarf::DW_LANG_C, file, "Kaleidoscope",
+                                                   /*isOptimized=*/true, "", 0);
+}
+
+FpMode CodegenCtx::GetFpMode(const std::string& function) const {
+    if (auto it = options.function_fp_modes.find(function); it != options.function_fp_modes.end()) {
+        return it->second;
+    }
+    return options.fp_mode;
+}
+
+bool CodegenCtx::CanDeclare(const ast::Prototype& proto) const {
+    // Definitions take precedence over host functions.
+    if (defined_functions.contains(proto.name)) {
+        auto defined = function_protos.find(proto.name);
+        if (defined != function_protos.end() && !proto.HasSameSignature(defined->second)) {
+            LogError(std::format("{} is defined with another signature", proto.name));
+            return false;
+        }
+        return true;
+    }
+    auto host = host_functions.find(proto.name);
+    if (host != host_functions.end() &&
+        (host->second.arity != proto.args.size() || !TakesAndReturnsDoubles(proto))) {
+        LogError(std::format("{} is bound to a host function taking {} doubles", proto.name,
+                             host->second.arity));
+        return false;
+    }
+    return true;
+}
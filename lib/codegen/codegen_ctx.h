@@ -1,18 +1,81 @@
 #pragma once
 
+#include <codegen/fp_mode.h>
+#include <parser/ast.h>
+
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/IRBuilder.h>
 
 #include <map>
+#include <set>
+
+struct CodegenOptions {
+    FpMode fp_mode = FpMode::kStrict;
+    // Per-function overrides of `fp_mode`.
+    std::map<std::string, FpMode> function_fp_modes;
+    // Emits line tables, so that profilers and debuggers attribute code to the lines of the
+    // definitions in `source_name`. Expressions have no locations of their own.
+    bool debug_info = false;
+    std::string source_name = "<source>";
+};
+
+// A host function that calls jump to directly, bypassing the lookup of externs. Code refers to
+// it by HostFunctionSymbol, which the JIT running it must define at `address`.
+struct HostFunction {
+    void* address;
+    // Passed as an extra first argument if not null, e.g. the state of a callable object. Code
+    // refers to it by HostContextSymbol.
+    void* context = nullptr;
+    size_t arity = 0;
+};
+
+// The dots keep these apart from the functions of programs.
+std::string HostFunctionSymbol(std::string_view name);
+std::string HostContextSymbol(std::string_view name);
+
+// Host functions are bound to externs of this kind only.
+bool TakesAndReturnsDoubles(const ast::Prototype& proto);
 
 class CodegenCtx {
 public:
-    CodegenCtx(std::string_view name) : context(), module(name, context), builder(context) {
-    }
+    CodegenCtx(std::string_view name, CodegenOptions options = {});
 
-    llvm::LLVMContext context;
-    llvm::Module module;
+    // Looks `name` up in the current module, declaring it from `function_protos` if it lives in
+    // a module that has already been taken.
+    llvm::Function* GetFunction(const std::string& name);
+
+    // Hands out the current module and starts an empty one with the same data layout.
+    llvm::orc::ThreadSafeModule TakeModule();
+
+    // Of the current module, null unless `options.debug_info` is set.
+    llvm::DIBuilder* GetDebugInfo();
+    llvm::DICompileUnit* GetCompileUnit();
+
+    FpMode GetFpMode(const std::string& function) const;
+
+    // Whether `proto` can be declared as an extern, which must not change the signature of a
+    // function that is defined or bound to a host function. Logs an error if not.
+    bool CanDeclare(const ast::Prototype& proto) const;
+
+    llvm::orc::ThreadSafeContext ts_context;
+    llvm::LLVMContext& context;
+    std::unique_ptr<llvm::Module> module;
     llvm::IRBuilder<> builder;
     std::map<std::string, llvm::Value*> named_values;
+    std::map<std::string, ast::Prototype> function_protos;
+    // Functions with a body, as opposed to externs.
+    std::set<std::string> defined_functions;
+    // Externs bound to host functions. Definitions of the same name take precedence.
+    std::map<std::string, HostFunction> host_functions;
+    CodegenOptions options;
+
+private:
+    void StartDebugInfo();
+
+    std::string name_;
+    std::unique_ptr<llvm::DIBuilder> debug_info_;
+    llvm::DICompileUnit* compile_unit_ = nullptr;
 };
@@ -0,0 +1,114 @@
+#include "dedup.h"
+
+#include <overloaded.h>
+
+#include <bit>
+#include <cstdint>
+#include <format>
+
+namespace {
+
+struct KeyBuilder {
+    void Append(const ast::Node& node) {
+        std::visit(
+            Overloaded{
+                [this](const ast::Number& number) {
+                    key += std::format("N{:x};", std::bit_cast<uint64_t>(number.value));
+                },
+                [this](const ast::Variable& var) {
+                    if (auto it = params.find(var.name); it != params.end()) {
+                        key += std::format("P{};", it->second);
+                    } else {
+                        AppendName('V', var.name);
+                    }
+                },
+                [this](const ast::BinaryOp& op) {
+                    AppendName('B', op.op);
+                    Append(*op.lhs);
+                    Append(*op.rhs);
+                },
+                [this](const ast::CallExpression& call) {
+                    AppendName('C', call.callee);
+                    key += std::format("{};", call.args.size());
+                    for (const auto& arg : call.args) {
+                        Append(*arg);
+                    }
+                },
+                [this](const ast::ForLoop& loop) {
+                    AppendName('F', loop.var);
+                    Append(*loop.start);
+                    // The loop variable shadows a parameter of the same name.
+                    auto param = params.extract(loop.var);
+                    Append(*loop.cond);
+                    if (loop.step) {
+                        Append(*loop.step);
+                    } else {
+                        key += "S;";
+                    }
+                    Append(*loop.body);
+                    if (param) {
+                        params.insert(std::move(param));
+                    }
+                },
+                [this](const ast::Conditional& cond) {
+                    key += "I;";
+                    Append(*cond.cond);
+                    Append(*cond.then_value);
+                    Append(*cond.else_value);
+                },
+                [this](const ast::VarBinding& binding) {
+                    AppendName('L', binding.var);
+                    Append(*binding.init);
+                    auto param = params.extract(binding.var);
+                    Append(*binding.body);
+                    if (param) {
+                        params.insert(std::move(param));
+                    }
+                },
+            },
+            node);
+    }
+
+    void AppendName(char tag, const std::string& name) {
+        key += std::format("{}{}:{}", tag, name.size(), name);
+    }
+
+    std::unordered_map<std::string, size_t> params;
+    std::string key;
+};
+
+}  // namespace
+
+std::string StructuralKey(const ast::Function& function, FpMode fp_mode) {
+    KeyBuilder builder;
+    const auto& args = function.proto.args;
+    for (size_t i = 0; i < args.size(); ++i) {
+        // LLVM renames repeated argument names, so the first parameter wins, as in codegen.
+        builder.params.try_emplace(args[i], i);
+    }
+    builder.key = std::format("A{};", args.size());
+    // Functions of different types can't share code even if their bodies look the same.
+    for (auto type : function.proto.arg_types) {
+        builder.key += std::format("{};", ast::TypeName(type));
+    }
+    builder.key += std::format("R{};", ast::TypeName(function.proto.return_type));
+    // Nor can functions with different fast-math flags.
+    builder.key += std::format("M{};", FpModeName(fp_mode));
+    builder.Append(*function.body);
+    return std::move(builder.key);
+}
+
+std::optional<std::string> FunctionDeduplicator::Find(const std::string& key) const {
+    if (auto it = canonical_.find(key); it != canonical_.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+void FunctionDeduplicator::Insert(std::string key, std::string name) {
+    canonical_.emplace(std::move(key), std::move(name));
+}
+
+void FunctionDeduplicator::Erase(const std::string& key) {
+    canonical_.erase(key);
+}
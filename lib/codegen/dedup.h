@@ -0,0 +1,26 @@
+#pragma once
+
+#include <codegen/fp_mode.h>
+#include <parser/ast.h>
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Encodes the structure of a function body with parameters replaced by their positions, so
+// `def f(x) x * 2` and `def g(y) y * 2` produce the same key. Functions compiled in different
+// `fp_mode`s get different keys.
+std::string StructuralKey(const ast::Function& function, FpMode fp_mode);
+
+class FunctionDeduplicator {
+public:
+    // Name of a previously inserted function with the same structural key, if any.
+    std::optional<std::string> Find(const std::string& key) const;
+
+    void Insert(std::string key, std::string name);
+
+    void Erase(const std::string& key);
+
+private:
+    std::unordered_map<std::string, std::string> canonical_;
+};
@@ -0,0 +1,49 @@
+#include "fp_mode.h"
+
+std::optional<FpMode> ParseFpMode(std::string_view name) {
+    if (name == "strict") {
+        return FpMode::kStrict;
+    } else if (name == "contract") {
+        return FpMode::kContract;
+    } else if (name == "fast") {
+        return FpMode::kFast;
+    }
+    return std::nullopt;
+}
+
+std::string_view FpModeName(FpMode mode) {
+    switch (mode) {
+        case FpMode::kStrict:
+            return "strict";
+        case FpMode::kContract:
+            return "contract";
+        case FpMode::kFast:
+            return "fast";
+    }
+    return "unknown";
+}
+
+llvm::FastMathFlags GetFastMathFlags(FpMode mode) {
+    llvm::FastMathFlags flags;
+    switch (mode) {
+        case FpMode::kStrict:
+            break;
+        case FpMode::kContract:
+            flags.setAllowContract();
+            break;
+        case FpMode::kFast:
+            flags.setFast();
+            break;
+    }
+    return flags;
+}
+
+void SetFpModeAttributes(llvm::Function* function, FpMode mode) {
+    if (mode != FpMode::kFast) {
+        return;
+    }
+    for (auto attr : {"unsafe-fp-math", "no-infs-fp-math", "no-nans-fp-math",
+                      "no-signed-zeros-fp-math", "approx-func-fp-math"}) {
+        function->addFnAttr(attr, "true");
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Operator.h>
+
+#include <optional>
+#include <string_view>
+
+enum class FpMode {
+    // IEEE semantics, no fast-math flags.
+    kStrict,
+    // Allows fusing multiplies and adds into FMA instructions.
+    kContract,
+    // All fast-math flags: reassociation, reciprocals, no NaNs, infinities or signed zeros.
+    kFast,
+};
+
+std::optional<FpMode> ParseFpMode(std::string_view name);
+
+std::string_view FpModeName(FpMode mode);
+
+llvm::FastMathFlags GetFastMathFlags(FpMode mode);
+
+// Sets the function attributes the backend consults for floating-point transformations.
+void SetFpModeAttributes(llvm::Function* function, FpMode mode);
@@ -0,0 +1,89 @@
+#include "optimizer.h"
+
+#include <stats/stats.h>
+#include <util.h>
+
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include <mutex>
+
+namespace {
+
+llvm::TargetLibraryInfoImpl::VectorLibrary ToLLVM(VectorLibrary library) {
+    switch (library) {
+        case VectorLibrary::kNone:
+            return llvm::TargetLibraryInfoImpl::NoLibrary;
+        case VectorLibrary::kLibmvec:
+            return llvm::TargetLibraryInfoImpl::LIBMVEC_X86;
+        case VectorLibrary::kSvml:
+            return llvm::TargetLibraryInfoImpl::SVML;
+    }
+    return llvm::TargetLibraryInfoImpl::NoLibrary;
+}
+
+}  // namespace
+
+const char* GetVectorLibraryName(VectorLibrary library) {
+    switch (library) {
+        case VectorLibrary::kNone:
+            return nullptr;
+        case VectorLibrary::kLibmvec:
+            return "libmvec.so.1";
+        case VectorLibrary::kSvml:
+            return "libsvml.so";
+    }
+    return nullptr;
+}
+
+void Optimize(llvm::Module* module, llvm::TargetMachine* target_machine,
+              const OptimizerOptions& options) {
+    stats::ScopedTimer timer(stats::Phase::kOptimize);
+
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+
+    llvm::Triple triple(module->getTargetTriple());
+    llvm::TargetLibraryInfoImpl tlii(triple);
+    tlii.addVectorizableFunctionsFromVecLib(ToLLVM(options.vector_library), triple);
+    // Registered before the defaults so that it takes precedence.
+    fam.registerPass([&tlii] { return llvm::TargetLibraryAnalysis(tlii); });
+
+    llvm::PassBuilder pb(target_machine);
+    pb.registerModuleAnalyses(mam);
+    pb.registerCGSCCAnalyses(cgam);
+    pb.registerFunctionAnalyses(fam);
+    pb.registerLoopAnalyses(lam);
+    pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+    auto mpm = pb.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
+    mpm.run(*module, mam);
+}
+
+void InitializeHostTarget() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+}
+
+std::unique_ptr<llvm::TargetMachine> CreateHostTargetMachine() {
+    InitializeHostTarget();
+
+    auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!jtmb) {
+        LogError(llvm::toString(jtmb.takeError()));
+        return nullptr;
+    }
+    auto target_machine = jtmb->createTargetMachine();
+    if (!target_machine) {
+        LogError(llvm::toString(target_machine.takeError()));
+        return nullptr;
+    }
+    return std::move(*target_machine);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <memory>
+
+enum class VectorLibrary {
+    kNone,
+    // glibc's libmvec, x86 only.
+    kLibmvec,
+    // Intel short vector math library.
+    kSvml,
+};
+
+// Shared library that defines the functions of `library`, null for kNone.
+const char* GetVectorLibraryName(VectorLibrary library);
+
+struct OptimizerOptions {
+    // Vector variants the vectorizers may call in place of scalar math functions. The Jit loads
+    // the library into the process.
+    VectorLibrary vector_library = VectorLibrary::kNone;
+};
+
+// Registers the host target with LLVM. Safe to call from any thread, it only runs once.
+void InitializeHostTarget();
+
+// Target machine of the host, null and an error logged if it can't be created.
+std::unique_ptr<llvm::TargetMachine> CreateHostTargetMachine();
+
+// Runs the default O2 pipeline over `module`, tuned for `target_machine` if one is given.
+void Optimize(llvm::Module* module, llvm::TargetMachine* target_machine,
+              const OptimizerOptions& options = {});
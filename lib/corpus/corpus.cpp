@@ -0,0 +1,264 @@
+#include "corpus.h"
+
+#include <codegen/codegen.h>
+#include <parser/parser.h>
+#include <parser/token.h>
+
+#include <format>
+#include <map>
+#include <sstream>
+
+namespace corpus {
+
+namespace {
+
+// Nesting of deep expressions.
+constexpr size_t kDepth = 48;
+// Parameters of the function wide calls call.
+constexpr size_t kWidth = 32;
+// Terms of the sums of numeric literals.
+constexpr size_t kTerms = 24;
+
+constexpr std::string_view kOperators[] = {"+", "-", "*", "<"};
+
+const std::map<std::string, uint8_t> kPrecedence = {
+    {"<", 10},
+    {"+", 20},
+    {"-", 20},
+    {"*", 40},
+};
+
+// Of the names of definitions, which can't have underscores.
+std::string_view GetPrefix(Shape shape) {
+    switch (shape) {
+        case Shape::kDeepExpressions:
+            return "deep";
+        case Shape::kWideCalls:
+            return "call";
+        case Shape::kManyDefinitions:
+            return "many";
+        case Shape::kNumericLiterals:
+            return "literals";
+    }
+    return "";
+}
+
+// SplitMix64, whose output is specified exactly, unlike that of the standard distributions.
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed) {
+    }
+
+    uint64_t Next() {
+        uint64_t z = (state_ += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    // The bias of the modulo doesn't matter for the small `n` used here.
+    size_t Below(size_t n) {
+        return Next() % n;
+    }
+
+private:
+    uint64_t state_;
+};
+
+class Generator {
+public:
+    explicit Generator(uint64_t seed) : random_(seed) {
+    }
+
+    Program Generate(Shape shape, size_t definitions) {
+        if (shape == Shape::kWideCalls) {
+            WideFunction();
+        }
+        for (size_t i = 0; i < definitions; ++i) {
+            auto name = std::format("{}{}", GetPrefix(shape), i);
+            out_ += std::format("def {}(x y) ", name);
+            switch (shape) {
+                case Shape::kDeepExpressions:
+                    Deep(kDepth);
+                    break;
+                case Shape::kWideCalls:
+                    WideCall();
+                    break;
+                case Shape::kManyDefinitions:
+                    CallEarlier(shape, i);
+                    break;
+                case Shape::kNumericLiterals:
+                    Literals();
+                    break;
+            }
+            out_ += "\n";
+            program_.definitions.push_back(std::move(name));
+        }
+        program_.source = std::move(out_);
+        return std::move(program_);
+    }
+
+private:
+    // Integers, decimals, small fractions and long mantissas. Random numbers are drawn in
+    // separate statements, as the order arguments are evaluated in is unspecified.
+    void Literal() {
+        switch (random_.Below(4)) {
+            case 0:
+                out_ += std::format("{}", random_.Below(1000));
+                break;
+            case 1: {
+                auto integer = random_.Below(100);
+                out_ += std::format("{}.{:03}", integer, random_.Below(1000));
+                break;
+            }
+            case 2:
+                out_ += std::format("0.000{}", 1 + random_.Below(999));
+                break;
+            default: {
+                auto integer = random_.Below(100000);
+                out_ += std::format("{}.{:06}", integer, random_.Below(1000000));
+                break;
+            }
+        }
+    }
+
+    void Leaf() {
+        switch (random_.Below(3)) {
+            case 0:
+                out_ += "x";
+                break;
+            case 1:
+                out_ += "y";
+                break;
+            default:
+                Literal();
+                break;
+        }
+    }
+
+    void Operator() {
+        out_ += std::format(" {} ", kOperators[random_.Below(std::size(kOperators))]);
+    }
+
+    void Deep(size_t depth) {
+        if (depth == 0) {
+            Leaf();
+            return;
+        }
+        const bool parens = random_.Below(3) == 0;
+        if (parens) {
+            out_ += "(";
+        }
+        if (random_.Below(2)) {
+            Leaf();
+            Operator();
+            Deep(depth - 1);
+        } else {
+            Deep(depth - 1);
+            Operator();
+            Leaf();
+        }
+        if (parens) {
+            out_ += ")";
+        }
+    }
+
+    void WideFunction() {
+        out_ += "def wide(";
+        for (size_t i = 0; i < kWidth; ++i) {
+            out_ += std::format("{}a{}", i ? " " : "", i);
+        }
+        out_ += ") a0";
+        for (size_t i = 1; i < kWidth; ++i) {
+            Operator();
+            out_ += std::format("a{}", i);
+        }
+        out_ += "\n";
+    }
+
+    void WideCall() {
+        out_ += "wide(";
+        for (size_t i = 0; i < kWidth; ++i) {
+            out_ += i ? ", " : "";
+            Leaf();
+            Operator();
+            Leaf();
+        }
+        out_ += ")";
+    }
+
+    // Only one of the calls runs, so a call costs as much as the chain of its callees.
+    void CallEarlier(Shape shape, size_t index) {
+        if (index == 0) {
+            out_ += "x + y";
+            return;
+        }
+        auto name = GetPrefix(shape);
+        auto then_callee = random_.Below(index);
+        auto else_callee = random_.Below(index);
+        out_ += std::format("if x < y then {}{}(x, y) else {}{}(y, x)", name, then_callee, name,
+                            else_callee);
+        Operator();
+        Leaf();
+    }
+
+    void Literals() {
+        for (size_t i = 0; i < kTerms; ++i) {
+            if (i) {
+                out_ += random_.Below(2) ? " + " : " - ";
+            }
+            Literal();
+            out_ += " * ";
+            Leaf();
+        }
+    }
+
+    Random random_;
+    std::string out_;
+    Program program_;
+};
+
+}  // namespace
+
+std::string_view ShapeName(Shape shape) {
+    switch (shape) {
+        case Shape::kDeepExpressions:
+            return "deep_expressions";
+        case Shape::kWideCalls:
+            return "wide_calls";
+        case Shape::kManyDefinitions:
+            return "many_definitions";
+        case Shape::kNumericLiterals:
+            return "numeric_literals";
+    }
+    return "";
+}
+
+Program Generate(Shape shape, size_t definitions, uint64_t seed) {
+    return Generator(seed).Generate(shape, definitions);
+}
+
+std::vector<std::unique_ptr<ast::Function>> Parse(const Program& program) {
+    std::istringstream in(program.source);
+    Parser parser(kPrecedence, &in);
+    std::vector<std::unique_ptr<ast::Function>> functions;
+    while (GetTokenKind(parser.GetTokenizer()->Get()) != token::TokenKind::kEof) {
+        auto fn = parser.ParseDefinition();
+        if (!fn) {
+            return {};
+        }
+        functions.push_back(std::move(fn));
+    }
+    return functions;
+}
+
+bool CodegenAll(const std::vector<std::unique_ptr<ast::Function>>& functions, CodegenCtx* ctx) {
+    for (const auto& fn : functions) {
+        if (!Codegen(*fn, ctx)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace corpus
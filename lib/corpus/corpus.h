@@ -0,0 +1,55 @@
+#pragma once
+
+#include <codegen/codegen_ctx.h>
+#include <parser/ast.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace corpus {
+
+// Synthetic programs, each stressing another part of the compiler.
+enum class Shape {
+    // Bodies that are one deeply nested expression, partly parenthesized.
+    kDeepExpressions,
+    // Calls passing many arguments to a function with as many parameters.
+    kWideCalls,
+    // Many small definitions, each calling a few earlier ones.
+    kManyDefinitions,
+    // Sums of products that are mostly numeric literals.
+    kNumericLiterals,
+};
+
+inline constexpr Shape kShapes[] = {
+    Shape::kDeepExpressions,
+    Shape::kWideCalls,
+    Shape::kManyDefinitions,
+    Shape::kNumericLiterals,
+};
+
+// `deep_expressions`, `wide_calls`, `many_definitions` or `numeric_literals`.
+std::string_view ShapeName(Shape shape);
+
+struct Program {
+    std::string source;
+    // Definitions in source order, each taking two doubles `x` and `y`. Helpers they call
+    // aren't listed.
+    std::vector<std::string> definitions;
+};
+
+// A program of `definitions` definitions of `shape`, using only the default operators. The
+// same arguments give the same program on every platform, so that measurements on it can be
+// compared across revisions.
+Program Generate(Shape shape, size_t definitions, uint64_t seed = 1);
+
+// Every definition of `program`, helpers included, so some shapes have more functions than
+// listed definitions. Empty if one fails to parse.
+std::vector<std::unique_ptr<ast::Function>> Parse(const Program& program);
+
+// Generates IR for every function into `ctx`, false if one fails.
+bool CodegenAll(const std::vector<std::unique_ptr<ast::Function>>& functions, CodegenCtx* ctx);
+
+}  // namespace corpus
@@ -0,0 +1,55 @@
+#include "item_driver.h"
+
+#include <parser/token.h>
+
+#include <chrono>
+
+using namespace token;
+
+ItemDriver::ItemDriver(Parser* parser, bool collect_stats)
+    : parser_(parser), collect_stats_(collect_stats) {
+}
+
+void ItemDriver::Run(const ItemHandlers& handlers, const std::function<void()>& prompt) {
+    auto start = std::chrono::steady_clock::now();
+    while (true) {
+        if (prompt) {
+            prompt();
+        }
+        switch (GetTokenKind(parser_->GetTokenizer()->Get())) {
+            case TokenKind::kEof:
+                if (handlers.end) {
+                    handlers.end();
+                }
+                report_.wall_time = std::chrono::steady_clock::now() - start;
+                report_.memory = stats::GetMemorySnapshot();
+                return;
+            case TokenKind::kSemicolon:
+                parser_->GetTokenizer()->Next();
+                break;
+            case TokenKind::kDef:
+                Handle("definition", handlers.definition);
+                break;
+            case TokenKind::kExtern:
+                Handle("extern", handlers.extern_);
+                break;
+            default:
+                Handle("expression", handlers.expression);
+                break;
+        }
+    }
+}
+
+void ItemDriver::Handle(std::string_view kind, const std::function<std::string()>& handler) {
+    if (!collect_stats_) {
+        handler();
+        return;
+    }
+    stats::ItemReport item{.kind = std::string(kind)};
+    {
+        stats::ScopedCollector collector(&item.stats);
+        item.name = handler();
+    }
+    item.memory = stats::GetMemorySnapshot();
+    report_.AddItem(std::move(item));
+}
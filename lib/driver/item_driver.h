@@ -0,0 +1,42 @@
+#pragma once
+
+#include <parser/parser.h>
+#include <stats/report.h>
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+// What to do with each kind of item. Handlers parse the item with the driver's parser and
+// return its name, empty if it failed to parse.
+struct ItemHandlers {
+    std::function<std::string()> definition;
+    std::function<std::string()> extern_;
+    std::function<std::string()> expression;
+    // Called once the input ends, before the statistics of the run are taken. Optional.
+    std::function<void()> end;
+};
+
+// The item loop of the REPL and the batch compiler: reads the input item by item, hands each
+// to the handler of its kind, and records its compile statistics if asked to.
+class ItemDriver {
+public:
+    ItemDriver(Parser* parser, bool collect_stats);
+
+    // Handles items until the end of the input, skipping semicolons between them. `prompt`, if
+    // set, is called whenever the next item is awaited.
+    void Run(const ItemHandlers& handlers, const std::function<void()>& prompt = {});
+
+    // Runs `handler`, which handles an item of `kind` and returns its name, e.g. an item parsed
+    // elsewhere or work done once the input ends.
+    void Handle(std::string_view kind, const std::function<std::string()>& handler);
+
+    const stats::Report& GetReport() const {
+        return report_;
+    }
+
+private:
+    Parser* parser_;
+    bool collect_stats_;
+    stats::Report report_;
+};
@@ -0,0 +1,183 @@
+#include "engine.h"
+
+#include <codegen/codegen.h>
+#include <parser/parser.h>
+#include <parser/token.h>
+#include <util.h>
+
+#include <algorithm>
+#include <format>
+#include <sstream>
+#include <vector>
+
+using namespace token;
+
+std::unique_ptr<Engine> Engine::Create(EngineOptions options) {
+    auto jit = Jit::Create(options.optimizer, options.perf);
+    if (!jit) {
+        return nullptr;
+    }
+    return std::unique_ptr<Engine>(new Engine(std::move(jit), std::move(options)));
+}
+
+Engine::Engine(std::unique_ptr<Jit> jit, EngineOptions options)
+    : options_(std::move(options)),
+      jit_(std::move(jit)),
+      codegen_ctx_("engine", options_.codegen) {
+    jit_->ConfigureModule(codegen_ctx_.module.get());
+}
+
+bool Engine::Compile(std::string_view source, std::span<const std::string> column_kernels) {
+    std::lock_guard lock(compile_mutex_);
+    std::istringstream in{std::string(source)};
+    Parser parser(options_.binop_precedence, &in);
+
+    // Restored if an item fails, so the next Compile doesn't see its functions.
+    auto protos = codegen_ctx_.function_protos;
+    auto defined_functions = codegen_ctx_.defined_functions;
+    auto fail = [&] {
+        codegen_ctx_.TakeModule();
+        codegen_ctx_.function_protos = std::move(protos);
+        codegen_ctx_.defined_functions = std::move(defined_functions);
+        return false;
+    };
+
+    std::vector<ast::Prototype> definitions;
+    while (true) {
+        switch (GetTokenKind(parser.GetTokenizer()->Get())) {
+            case TokenKind::kEof:
+                break;
+            case TokenKind::kSemicolon:
+                parser.GetTokenizer()->Next();
+                continue;
+            case TokenKind::kDef: {
+                auto fn = parser.ParseDefinition();
+                if (!fn) {
+                    LogError("Failed to parse definition");
+                    return fail();
+                }
+                if (codegen_ctx_.defined_functions.contains(fn->GetName()) ||
+                    codegen_ctx_.host_functions.contains(fn->GetName())) {
+                    LogError(std::format("Function {} is already defined", fn->GetName()));
+                    return fail();
+                }
+                if (!Codegen(*fn, &codegen_ctx_)) {
+                    LogError("Failed to codegen");
+                    return fail();
+                }
+                definitions.push_back(fn->proto);
+                continue;
+            }
+            case TokenKind::kExtern: {
+                auto proto = parser.ParseExtern();
+                if (!proto) {
+                    return fail();
+                }
+                if (!codegen_ctx_.CanDeclare(*proto)) {
+                    return fail();
+                }
+                codegen_ctx_.function_protos[proto->name] = *proto;
+                continue;
+            }
+            default:
+                LogError("Top-level expressions can't be compiled, define a function instead");
+                return fail();
+        }
+        break;
+    }
+    for (const auto& name : column_kernels) {
+        auto proto = std::ranges::find(definitions, name, &ast::Prototype::name);
+        if (proto == definitions.end()) {
+            LogError(std::format("{} isn't defined by the source", name));
+            return fail();
+        }
+        if (!CodegenColumnKernel(*proto, &codegen_ctx_)) {
+            return fail();
+        }
+    }
+
+    // Removed if linking fails, so the functions of the source go away with the maps.
+    auto tracker = jit_->CreateResourceTracker();
+    auto unlink = [&] {
+        if (auto error = tracker->remove()) {
+            LogError(llvm::toString(std::move(error)));
+        }
+        return fail();
+    };
+    if (!jit_->AddModule(codegen_ctx_.TakeModule(), tracker)) {
+        return unlink();
+    }
+    // Looking the functions up compiles them, so callers never wait for the JIT.
+    std::map<std::string, Function, std::less<>> functions;
+    for (const auto& proto : definitions) {
+        auto* address = jit_->Lookup(proto.name);
+        if (!address) {
+            return unlink();
+        }
+        functions[proto.name] = {.address = address, .proto = proto};
+    }
+    for (const auto& name : column_kernels) {
+        auto* kernel = jit_->Lookup(GetColumnKernelName(name));
+        if (!kernel) {
+            return unlink();
+        }
+        functions[name].column_kernel = reinterpret_cast<engine::ColumnKernel>(kernel);
+    }
+    std::lock_guard functions_lock(functions_mutex_);
+    functions_.merge(functions);
+    return true;
+}
+
+bool Engine::Bind(std::string name, HostFunction function) {
+    std::lock_guard lock(compile_mutex_);
+    if (codegen_ctx_.defined_functions.contains(name)) {
+        LogError(std::format("{} is already defined", name));
+        return false;
+    }
+    if (codegen_ctx_.host_functions.contains(name)) {
+        LogError(std::format("{} is already bound to a host function", name));
+        return false;
+    }
+    auto proto = codegen_ctx_.function_protos.find(name);
+    if (proto != codegen_ctx_.function_protos.end() &&
+        (proto->second.args.size() != function.arity || !TakesAndReturnsDoubles(proto->second))) {
+        LogError(std::format("{} is declared with another signature than {} doubles", name,
+                             function.arity));
+        return false;
+    }
+    std::map<std::string, void*> symbols{{HostFunctionSymbol(name), function.address}};
+    if (function.context) {
+        symbols[HostContextSymbol(name)] = function.context;
+    }
+    if (!jit_->AddSymbols(symbols)) {
+        return false;
+    }
+    codegen_ctx_.host_functions.emplace(std::move(name), function);
+    return true;
+}
+
+void* Engine::LookupAddress(std::string_view name, std::span<const ast::Type> arg_types,
+                            ast::Type return_type) const {
+    std::shared_lock lock(functions_mutex_);
+    auto it = functions_.find(name);
+    if (it == functions_.end() || !std::ranges::equal(it->second.proto.arg_types, arg_types) ||
+        it->second.proto.return_type != return_type) {
+        return nullptr;
+    }
+    return it->second.address;
+}
+
+std::optional<ast::Prototype> Engine::GetPrototype(std::string_view name) const {
+    std::shared_lock lock(functions_mutex_);
+    auto it = functions_.find(name);
+    if (it == functions_.end()) {
+        return std::nullopt;
+    }
+    return it->second.proto;
+}
+
+engine::ColumnKernel Engine::LookupColumnKernel(std::string_view name) const {
+    std::shared_lock lock(functions_mutex_);
+    auto it = functions_.find(name);
+    return it == functions_.end() ? nullptr : it->second.column_kernel;
+}
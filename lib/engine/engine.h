@@ -0,0 +1,205 @@
+#pragma once
+
+#include <codegen/codegen_ctx.h>
+#include <codegen/optimizer.h>
+#include <jit/jit.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace engine {
+
+// Signatures of host functions: doubles in, a double out.
+template <class Signature>
+struct IsSignature : std::false_type {};
+
+template <class... Args>
+struct IsSignature<double(Args...)> : std::bool_constant<(std::is_same_v<Args, double> && ...)> {
+    static constexpr size_t kArity = sizeof...(Args);
+};
+
+// The host type of each Kaleidoscope type.
+template <class T>
+struct ValueType;
+
+template <>
+struct ValueType<double> {
+    static constexpr ast::Type kType = ast::Type::kDouble;
+};
+
+template <>
+struct ValueType<float> {
+    static constexpr ast::Type kType = ast::Type::kFloat;
+};
+
+template <>
+struct ValueType<int64_t> {
+    static constexpr ast::Type kType = ast::Type::kInt64;
+};
+
+template <class T>
+concept Value = requires { ValueType<T>::kType; };
+
+// Signatures of Kaleidoscope functions, of any value types.
+template <class Signature>
+struct FunctionType : std::false_type {};
+
+template <Value Result, Value... Args>
+struct FunctionType<Result(Args...)> : std::true_type {
+    static constexpr ast::Type kReturnType = ValueType<Result>::kType;
+    static constexpr std::array<ast::Type, sizeof...(Args)> kArgTypes = {ValueType<Args>::kType...};
+};
+
+template <class>
+using Double = double;
+
+// Calls a callable object passed as the context of a host function.
+template <class Callable, class Signature>
+struct Trampoline;
+
+template <class Callable, class... Args>
+struct Trampoline<Callable, double(Args...)> {
+    static double Call(void* context, Args... args) {
+        return (*static_cast<Callable*>(context))(args...);
+    }
+};
+
+// Evaluates a function over columns, see CodegenColumnKernel.
+using ColumnKernel = void (*)(const void* const* columns, void* out, int64_t begin, int64_t end);
+
+}  // namespace engine
+
+struct EngineOptions {
+    std::map<std::string, uint8_t> binop_precedence = {
+        {"<", 10},
+        {"+", 20},
+        {"-", 20},
+        {"*", 40},
+    };
+    CodegenOptions codegen;
+    OptimizerOptions optimizer;
+    PerfOptions perf;
+};
+
+// Compiles Kaleidoscope source for a host program to call as native functions.
+//
+//     auto engine = Engine::Create();
+//     engine->Compile("def hypot2(x y) x * x + y * y");
+//     auto* hypot2 = engine->Lookup<double(double, double)>("hypot2");
+//     hypot2(3, 4);
+//
+// Functions with typed arguments or results are looked up with the matching C++ types, e.g.
+// `def scale(x:float n:i64):float` as `float(float, int64_t)`.
+//
+// Externs can be bound to host functions with Register, calls to them then jump straight to
+// the host code instead of resolving the name in the process.
+//
+// Functions are compiled when Compile returns and never change afterwards, so the pointers
+// stay valid as long as the engine and calls through them cost what a call to C++ does.
+// Lookups and calls are thread-safe, and may run concurrently with Compile.
+class Engine {
+public:
+    // Returns null and logs an error if the JIT can't be created.
+    static std::unique_ptr<Engine> Create(EngineOptions options = {});
+
+    // Compiles the definitions and externs in `source`. Either all definitions are added or,
+    // if an item fails or redefines a function, none. Top-level expressions aren't allowed.
+    // Column kernels of the functions in `column_kernels` are compiled in the same module,
+    // so the calls to the functions are inlined.
+    bool Compile(std::string_view source, std::span<const std::string> column_kernels = {});
+
+    // Binds the extern `name` to `function` for the sources compiled afterwards. Fails if
+    // `name` is defined, already bound, or declared with another arity.
+    template <class Signature>
+    bool Register(std::string name, Signature* function) {
+        static_assert(engine::IsSignature<Signature>::value,
+                      "Kaleidoscope functions take and return doubles");
+        return Bind(std::move(name), {
+                                         .address = reinterpret_cast<void*>(function),
+                                         .arity = engine::IsSignature<Signature>::kArity,
+                                     });
+    }
+
+    // Same, but `context` is passed to `function` before the arguments.
+    template <class... Args>
+    bool Register(std::string name, void* context, double (*function)(void*, Args...)) {
+        static_assert(engine::IsSignature<double(Args...)>::value,
+                      "Kaleidoscope functions take and return doubles");
+        return Bind(std::move(name), {
+                                         .address = reinterpret_cast<void*>(function),
+                                         .context = context,
+                                         .arity = sizeof...(Args),
+                                     });
+    }
+
+    // Binds `name` to calls of `callable`, e.g. a lambda with captures, which must outlive the
+    // engine. Costs one more direct call than a plain function.
+    template <class Signature, class Callable>
+    bool Register(std::string name, Callable* callable) {
+        return Register(std::move(name), static_cast<void*>(callable),
+                        &engine::Trampoline<Callable, Signature>::Call);
+    }
+
+    // The function `name`, null if there is none with the signature of `Signature`.
+    template <class Signature>
+    Signature* Lookup(std::string_view name) const {
+        using Type = engine::FunctionType<Signature>;
+        static_assert(Type::value,
+                      "Kaleidoscope functions take and return doubles, floats or int64_t");
+        return reinterpret_cast<Signature*>(
+            LookupAddress(name, Type::kArgTypes, Type::kReturnType));
+    }
+
+    // The prototype of the function `name`, nothing if there is none.
+    std::optional<ast::Prototype> GetPrototype(std::string_view name) const;
+
+    // The column kernel of `name`, null if it wasn't compiled.
+    engine::ColumnKernel LookupColumnKernel(std::string_view name) const;
+
+    // Calls the function `name`, nothing if it can't be found or doesn't take and return
+    // doubles. Look functions up once instead to call them often.
+    template <class... Args>
+        requires(std::is_convertible_v<Args, double> && ...)
+    std::optional<double> Call(std::string_view name, Args... args) const {
+        auto* function = Lookup<double(engine::Double<Args>...)>(name);
+        if (!function) {
+            return std::nullopt;
+        }
+        return function(static_cast<double>(args)...);
+    }
+
+private:
+    struct Function {
+        void* address;
+        ast::Prototype proto;
+        // Null unless it was compiled.
+        engine::ColumnKernel column_kernel = nullptr;
+    };
+
+    Engine(std::unique_ptr<Jit> jit, EngineOptions options);
+
+    bool Bind(std::string name, HostFunction function);
+    void* LookupAddress(std::string_view name, std::span<const ast::Type> arg_types,
+                        ast::Type return_type) const;
+
+    EngineOptions options_;
+
+    // Held while compiling, guards everything below but `functions_`.
+    std::mutex compile_mutex_;
+    std::unique_ptr<Jit> jit_;
+    CodegenCtx codegen_ctx_;
+
+    mutable std::shared_mutex functions_mutex_;
+    std::map<std::string, Function, std::less<>> functions_;
+};
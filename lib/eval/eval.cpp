@@ -0,0 +1,245 @@
+#include "eval.h"
+
+#include <runtime/parallel.h>
+#include <util.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::nullptr_t LogSystemError(std::string_view what) {
+    return LogError(std::format("{}: {}", what, std::strerror(errno)));
+}
+
+size_t GetValueSize(ast::Type type) {
+    auto element = ast::GetElementType(type);
+    return ast::GetLaneCount(type) * (element == ast::Type::kFloat ? 4 : 8);
+}
+
+// A column file, either mapped whole or read and written a chunk at a time. Reads and writes
+// of different chunks may run concurrently.
+class ColumnFile {
+public:
+    ColumnFile(std::string path, int fd, size_t size)
+        : path_(std::move(path)), fd_(fd), size_(size) {
+    }
+
+    ~ColumnFile() {
+        if (mapping_) {
+            munmap(mapping_, size_);
+        }
+        close(fd_);
+    }
+
+    ColumnFile(const ColumnFile&) = delete;
+    ColumnFile& operator=(const ColumnFile&) = delete;
+
+    static std::unique_ptr<ColumnFile> Open(const std::string& path, bool map) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return LogSystemError(std::format("Cannot open {}", path));
+        }
+        struct stat status;
+        if (fstat(fd, &status) < 0) {
+            close(fd);
+            return LogSystemError(std::format("Cannot stat {}", path));
+        }
+        auto file = std::make_unique<ColumnFile>(path, fd, status.st_size);
+        if (map && !file->Map(PROT_READ)) {
+            return nullptr;
+        }
+        return file;
+    }
+
+    static std::unique_ptr<ColumnFile> Create(const std::string& path, size_t size, bool map) {
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return LogSystemError(std::format("Cannot create {}", path));
+        }
+        auto file = std::make_unique<ColumnFile>(path, fd, size);
+        if (ftruncate(fd, size) < 0) {
+            return LogSystemError(std::format("Cannot resize {}", path));
+        }
+        if (map && !file->Map(PROT_READ | PROT_WRITE)) {
+            return nullptr;
+        }
+        return file;
+    }
+
+    const std::string& GetPath() const {
+        return path_;
+    }
+
+    size_t GetSize() const {
+        return size_;
+    }
+
+    // Bytes from `offset` to `offset + size`: in the mapping, or read into `buffer`.
+    const char* Read(size_t offset, size_t size, std::vector<char>* buffer) const {
+        if (mapping_) {
+            return mapping_ + offset;
+        }
+        buffer->resize(size);
+        for (size_t done = 0; done < size;) {
+            auto read = pread(fd_, buffer->data() + done, size - done, offset + done);
+            if (read < 0 && errno == EINTR) {
+                continue;
+            }
+            if (read <= 0) {
+                return read < 0 ? LogSystemError(std::format("Cannot read {}", path_))
+                                : LogError(std::format("{} was truncated", path_));
+            }
+            done += read;
+        }
+        return buffer->data();
+    }
+
+    // Where to put the bytes from `offset` to `offset + size`: in the mapping, or in `buffer`
+    // until they are written with Write.
+    char* GetOutput(size_t offset, size_t size, std::vector<char>* buffer) {
+        if (mapping_) {
+            return mapping_ + offset;
+        }
+        buffer->resize(size);
+        return buffer->data();
+    }
+
+    bool Write(size_t offset, const char* data, size_t size) {
+        if (mapping_) {
+            return true;
+        }
+        for (size_t done = 0; done < size;) {
+            auto written = pwrite(fd_, data + done, size - done, offset + done);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written < 0) {
+                LogSystemError(std::format("Cannot write {}", path_));
+                return false;
+            }
+            done += written;
+        }
+        return true;
+    }
+
+private:
+    bool Map(int protection) {
+        // Empty files can't be mapped, and have nothing to read anyway.
+        if (size_ == 0) {
+            return true;
+        }
+        void* mapping = mmap(nullptr, size_, protection, MAP_SHARED, fd_, 0);
+        if (mapping == MAP_FAILED) {
+            LogSystemError(std::format("Cannot map {}", path_));
+            return false;
+        }
+        mapping_ = static_cast<char*>(mapping);
+        return true;
+    }
+
+    std::string path_;
+    int fd_;
+    size_t size_;
+    char* mapping_ = nullptr;
+};
+
+}  // namespace
+
+std::optional<EvalSummary> EvaluateColumns(const Engine& engine, std::string_view name,
+                                           const std::map<std::string, std::string>& columns,
+                                           const std::string& output,
+                                           const EvalOptions& options) {
+    auto proto = engine.GetPrototype(name);
+    auto kernel = engine.LookupColumnKernel(name);
+    if (!proto || !kernel) {
+        LogError(std::format("{} isn't compiled with its column kernel", name));
+        return std::nullopt;
+    }
+    if (proto->args.empty()) {
+        LogError(std::format("{} takes no columns to evaluate it on", name));
+        return std::nullopt;
+    }
+
+    std::vector<std::unique_ptr<ColumnFile>> inputs;
+    std::vector<size_t> value_sizes;
+    size_t rows = 0;
+    for (size_t i = 0; i < proto->args.size(); ++i) {
+        auto path = columns.find(proto->args[i]);
+        if (path == columns.end()) {
+            LogError(std::format("No column for argument {} of {}", proto->args[i], name));
+            return std::nullopt;
+        }
+        auto file = ColumnFile::Open(path->second, !options.stream);
+        if (!file) {
+            return std::nullopt;
+        }
+        auto value_size = GetValueSize(proto->arg_types[i]);
+        if (file->GetSize() % value_size != 0) {
+            LogError(std::format("{} isn't a column of {}", path->second,
+                                 ast::TypeName(proto->arg_types[i])));
+            return std::nullopt;
+        }
+        if (i > 0 && file->GetSize() / value_size != rows) {
+            LogError(std::format("{} has {} rows, other columns {}", path->second,
+                                 file->GetSize() / value_size, rows));
+            return std::nullopt;
+        }
+        rows = file->GetSize() / value_size;
+        inputs.push_back(std::move(file));
+        value_sizes.push_back(value_size);
+    }
+    const size_t result_size = GetValueSize(proto->return_type);
+    auto out = ColumnFile::Create(output, rows * result_size, !options.stream);
+    if (!out) {
+        return std::nullopt;
+    }
+
+    EvalSummary summary{.rows = rows};
+    const size_t chunk_rows = std::max<size_t>(options.chunk_rows, 1);
+    summary.chunks = (rows + chunk_rows - 1) / chunk_rows;
+    summary.threads = options.threads ? options.threads
+                                      : std::max(std::thread::hardware_concurrency(), 1u);
+    // The calling thread evaluates chunks too.
+    runtime::WorkStealingPool pool(summary.threads - 1);
+    std::atomic<bool> failed = false;
+    pool.ParallelFor(summary.chunks, [&](size_t chunk) {
+        if (failed) {
+            return;
+        }
+        const size_t begin = chunk * chunk_rows;
+        const size_t count = std::min(rows - begin, chunk_rows);
+        // Only used when streaming.
+        std::vector<std::vector<char>> buffers(inputs.size() + 1);
+        std::vector<const void*> chunk_columns;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            auto* data = inputs[i]->Read(begin * value_sizes[i], count * value_sizes[i],
+                                         &buffers[i]);
+            if (!data) {
+                failed = true;
+                return;
+            }
+            chunk_columns.push_back(data);
+        }
+        auto* results = out->GetOutput(begin * result_size, count * result_size, &buffers.back());
+        kernel(chunk_columns.data(), results, 0, static_cast<int64_t>(count));
+        if (!out->Write(begin * result_size, results, count * result_size)) {
+            failed = true;
+        }
+    });
+    if (failed) {
+        return std::nullopt;
+    }
+    return summary;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <engine/engine.h>
+
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+struct EvalOptions {
+    // Threads evaluating chunks, including the caller. One per core if 0.
+    size_t threads = 0;
+    // Rows a thread evaluates at a time.
+    size_t chunk_rows = size_t{1} << 16;
+    // Reads and writes the files a chunk at a time rather than mapping them, so memory use is
+    // bounded by the chunks in flight rather than the size of the files.
+    bool stream = false;
+};
+
+struct EvalSummary {
+    size_t rows = 0;
+    size_t chunks = 0;
+    size_t threads = 0;
+};
+
+// Evaluates the function `name` of `engine` on every row of its columns and writes the
+// results as another column. Columns are files of values of one type, packed in native byte
+// order with no header, e.g. 8 bytes per row for doubles and 16 for vec4f.
+//
+// `columns` maps the names of the arguments of the function to the files of their columns,
+// which must have as many rows. The function must have been compiled with its column kernel,
+// see Engine::Compile. Returns nothing and logs an error if a column is missing or a file
+// can't be read or written.
+std::optional<EvalSummary> EvaluateColumns(const Engine& engine, std::string_view name,
+                                           const std::map<std::string, std::string>& columns,
+                                           const std::string& output,
+                                           const EvalOptions& options = {});
@@ -0,0 +1,382 @@
+#include "jit.h"
+
+#include <codegen/optimizer.h>
+#include <jit/perf_map.h>
+#include <runtime/parallel.h>
+#include <stats/memory.h>
+#include <stats/stats.h>
+#include <util.h>
+
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/Object/ObjectFile.h>
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+uint64_t TextSize(const llvm::MemoryBuffer& buffer) {
+    auto object = llvm::object::ObjectFile::createObjectFile(buffer.getMemBufferRef());
+    if (!object) {
+        llvm::consumeError(object.takeError());
+        return 0;
+    }
+    uint64_t size = 0;
+    for (const auto& section : (*object)->sections()) {
+        if (section.isText()) {
+            size += section.getSize();
+        }
+    }
+    return size;
+}
+
+// Times machine code emission and counts the bytes of code it produces.
+class InstrumentedCompiler : public llvm::orc::IRCompileLayer::IRCompiler {
+public:
+    explicit InstrumentedCompiler(std::unique_ptr<IRCompiler> compiler)
+        : IRCompiler(compiler->getManglingOptions()), compiler_(std::move(compiler)) {
+    }
+
+    llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> operator()(llvm::Module& module) override {
+        stats::ScopedTimer timer(stats::Phase::kEmit);
+        auto object = (*compiler_)(module);
+        if (object && stats::IsCollecting()) {
+            stats::Add(stats::Counter::kMachineCodeBytes, TextSize(**object));
+        }
+        return object;
+    }
+
+private:
+    std::unique_ptr<IRCompiler> compiler_;
+};
+
+// Rough size of the IR held by `module`. LLVM does not expose its allocations, so this adds up
+// the sizes of the objects making up the module.
+size_t EstimateModuleBytes(const llvm::Module& module) {
+    size_t bytes = sizeof(llvm::Module) + module.alias_size() * sizeof(llvm::GlobalAlias) +
+                   module.global_size() * sizeof(llvm::GlobalVariable);
+    for (const auto& function : module) {
+        bytes += sizeof(llvm::Function) + function.arg_size() * sizeof(llvm::Argument);
+        for (const auto& block : function) {
+            bytes += sizeof(llvm::BasicBlock);
+            for (const auto& inst : block) {
+                bytes += sizeof(llvm::Instruction) + inst.getNumOperands() * sizeof(llvm::Use);
+            }
+        }
+    }
+    return bytes;
+}
+
+// Accounts a module to the IR pool until the JIT compiles or discards it.
+class TrackedIRMaterializationUnit : public llvm::orc::IRMaterializationUnit {
+public:
+    TrackedIRMaterializationUnit(llvm::orc::IRLayer& layer, llvm::orc::ThreadSafeModule module)
+        : IRMaterializationUnit(layer.getExecutionSession(), *layer.getManglingOptions(),
+                                std::move(module)),
+          layer_(layer),
+          bytes_(TSM.withModuleDo(EstimateModuleBytes)) {
+        stats::TrackAllocation(stats::MemoryPool::kIr, bytes_);
+    }
+
+    ~TrackedIRMaterializationUnit() override {
+        stats::TrackDeallocation(stats::MemoryPool::kIr, bytes_);
+    }
+
+private:
+    void materialize(std::unique_ptr<llvm::orc::MaterializationResponsibility> r) override {
+        stats::TrackDeallocation(stats::MemoryPool::kIr, std::exchange(bytes_, 0));
+        layer_.emit(std::move(r), std::move(TSM));
+    }
+
+    llvm::orc::IRLayer& layer_;
+    size_t bytes_;
+};
+
+// Accounts sections of a loaded object to the JIT pools until the object is unloaded.
+class TrackingMemoryManager : public llvm::SectionMemoryManager {
+public:
+    ~TrackingMemoryManager() override {
+        stats::TrackDeallocation(stats::MemoryPool::kJitCode, code_bytes_);
+        stats::TrackDeallocation(stats::MemoryPool::kJitData, data_bytes_);
+    }
+
+    uint8_t* allocateCodeSection(uintptr_t size, unsigned alignment, unsigned section_id,
+                                 llvm::StringRef section_name) override {
+        code_bytes_ += size;
+        stats::TrackAllocation(stats::MemoryPool::kJitCode, size);
+        return SectionMemoryManager::allocateCodeSection(size, alignment, section_id,
+                                                         section_name);
+    }
+
+    uint8_t* allocateDataSection(uintptr_t size, unsigned alignment, unsigned section_id,
+                                 llvm::StringRef section_name, bool is_read_only) override {
+        data_bytes_ += size;
+        stats::TrackAllocation(stats::MemoryPool::kJitData, size);
+        return SectionMemoryManager::allocateDataSection(size, alignment, section_id,
+                                                         section_name, is_read_only);
+    }
+
+private:
+    size_t code_bytes_ = 0;
+    size_t data_bytes_ = 0;
+};
+
+// Notifies `listeners` of every object loaded.
+std::unique_ptr<llvm::orc::ObjectLayer> CreateObjectLayer(
+    llvm::orc::ExecutionSession& session, const std::vector<llvm::JITEventListener*>& listeners) {
+    auto layer = std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(
+        session, [](const llvm::MemoryBuffer&) { return std::make_unique<TrackingMemoryManager>(); });
+    for (auto* listener : listeners) {
+        layer->registerJITEventListener(*listener);
+    }
+    return layer;
+}
+
+llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> CreateCompiler(
+    llvm::orc::JITTargetMachineBuilder jtmb) {
+    auto target_machine = jtmb.createTargetMachine();
+    if (!target_machine) {
+        return target_machine.takeError();
+    }
+    return std::make_unique<InstrumentedCompiler>(
+        std::make_unique<llvm::orc::TMOwningSimpleCompiler>(std::move(*target_machine)));
+}
+
+std::nullptr_t LogError(llvm::Error error) {
+    return ::LogError(llvm::toString(std::move(error)));
+}
+
+// Runs instead of a function whose code failed to link when first called through its stub, the
+// error having been reported by the session. Every function returns a double, so this can stand
+// in for any of them.
+double FailedCallThrough() {
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+}  // namespace
+
+std::unique_ptr<Jit> Jit::Create(OptimizerOptions optimizer_options, PerfOptions perf) {
+    InitializeHostTarget();
+
+    std::vector<llvm::JITEventListener*> listeners;
+    if (perf.perf_map) {
+        listeners.push_back(&GetPerfMapListener());
+    }
+    if (perf.jitdump) {
+        // A process-wide listener, null unless LLVM was built with perf support.
+        auto* listener = llvm::JITEventListener::createPerfJITEventListener();
+        if (!listener) {
+            return ::LogError("LLVM was built without LLVM_USE_PERF, it can't write jitdump");
+        }
+        listeners.push_back(listener);
+    }
+
+    auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!jtmb) {
+        return LogError(jtmb.takeError());
+    }
+    auto target_machine = jtmb->createTargetMachine();
+    if (!target_machine) {
+        return LogError(target_machine.takeError());
+    }
+    auto lljit = llvm::orc::LLJITBuilder()
+                     .setJITTargetMachineBuilder(std::move(*jtmb))
+                     .setCompileFunctionCreator(CreateCompiler)
+                     .setObjectLinkingLayerCreator(
+                         [listeners](llvm::orc::ExecutionSession& session, const llvm::Triple&)
+                             -> llvm::Expected<std::unique_ptr<llvm::orc::ObjectLayer>> {
+                             return CreateObjectLayer(session, listeners);
+                         })
+                     .create();
+    if (!lljit) {
+        return LogError(lljit.takeError());
+    }
+
+    // Externs resolve to symbols of the host process.
+    auto process_symbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*lljit)->getDataLayout().getGlobalPrefix());
+    if (!process_symbols) {
+        return LogError(process_symbols.takeError());
+    }
+    (*lljit)->getMainJITDylib().addGenerator(std::move(*process_symbols));
+
+    // So do the vector variants of math functions the vectorizers call.
+    if (const char* library = GetVectorLibraryName(optimizer_options.vector_library)) {
+        auto library_symbols = llvm::orc::DynamicLibrarySearchGenerator::Load(
+            library, (*lljit)->getDataLayout().getGlobalPrefix());
+        if (!library_symbols) {
+            return LogError(library_symbols.takeError());
+        }
+        (*lljit)->getMainJITDylib().addGenerator(std::move(*library_symbols));
+    }
+
+    auto call_through = llvm::orc::createLocalLazyCallThroughManager(
+        (*lljit)->getTargetTriple(), (*lljit)->getExecutionSession(),
+        llvm::orc::ExecutorAddr::fromPtr(&FailedCallThrough));
+    if (!call_through) {
+        return LogError(call_through.takeError());
+    }
+
+    std::unique_ptr<Jit> jit(new Jit(std::move(*lljit), std::move(*target_machine),
+                                     std::move(optimizer_options), std::move(*call_through)));
+    // Code calls the builtins by name, so that it links in whichever process loads it.
+    if (!jit->AddSymbols(runtime::GetSymbols())) {
+        return nullptr;
+    }
+    return jit;
+}
+
+Jit::Jit(std::unique_ptr<llvm::orc::LLJIT> lljit,
+         std::unique_ptr<llvm::TargetMachine> target_machine, OptimizerOptions optimizer_options,
+         std::unique_ptr<llvm::orc::LazyCallThroughManager> call_through)
+    : lljit_(std::move(lljit)),
+      target_machine_(std::move(target_machine)),
+      optimizer_options_(std::move(optimizer_options)),
+      call_through_(std::move(call_through)),
+      stubs_(llvm::orc::createLocalIndirectStubsManagerBuilder(lljit_->getTargetTriple())()),
+      stubs_tracker_(lljit_->getMainJITDylib().createResourceTracker()) {
+    lljit_->getIRTransformLayer().setTransform(
+        [this](llvm::orc::ThreadSafeModule module, llvm::orc::MaterializationResponsibility&) {
+            module.withModuleDo([this](llvm::Module& m) {
+                Optimize(&m, target_machine_.get(), optimizer_options_);
+            });
+            return llvm::Expected<llvm::orc::ThreadSafeModule>(std::move(module));
+        });
+}
+
+void Jit::ConfigureModule(llvm::Module* module) const {
+    module->setDataLayout(lljit_->getDataLayout());
+    module->setTargetTriple(lljit_->getTargetTriple().str());
+}
+
+llvm::orc::ResourceTrackerSP Jit::CreateResourceTracker() {
+    return lljit_->getMainJITDylib().createResourceTracker();
+}
+
+bool Jit::AddModule(llvm::orc::ThreadSafeModule module, llvm::orc::ResourceTrackerSP tracker) {
+    if (!tracker) {
+        tracker = lljit_->getMainJITDylib().getDefaultResourceTracker();
+    }
+    auto& layer = lljit_->getIRTransformLayer();
+    auto unit = std::make_unique<TrackedIRMaterializationUnit>(layer, std::move(module));
+    if (auto error = tracker->getJITDylib().define(std::move(unit), tracker)) {
+        LogError(std::move(error));
+        return false;
+    }
+    return true;
+}
+
+bool Jit::AddObject(llvm::MemoryBufferRef object, llvm::orc::ResourceTrackerSP tracker) {
+    if (!tracker) {
+        tracker = lljit_->getMainJITDylib().getDefaultResourceTracker();
+    }
+    auto buffer = llvm::MemoryBuffer::getMemBufferCopy(object.getBuffer(),
+                                                       object.getBufferIdentifier());
+    if (auto error = lljit_->addObjectFile(tracker, std::move(buffer))) {
+        LogError(std::move(error));
+        return false;
+    }
+    return true;
+}
+
+bool Jit::AddAlias(const std::string& name, const std::string& aliasee,
+                   llvm::orc::ResourceTrackerSP tracker) {
+    if (!tracker) {
+        tracker = lljit_->getMainJITDylib().getDefaultResourceTracker();
+    }
+    llvm::orc::SymbolAliasMap aliases;
+    aliases[lljit_->mangleAndIntern(name)] = {lljit_->mangleAndIntern(aliasee),
+                                              llvm::JITSymbolFlags::Exported |
+                                                  llvm::JITSymbolFlags::Callable};
+    if (auto error = tracker->getJITDylib().define(llvm::orc::symbolAliases(aliases), tracker)) {
+        LogError(std::move(error));
+        return false;
+    }
+    return true;
+}
+
+bool Jit::AddSymbols(const std::map<std::string, void*>& symbols) {
+    llvm::orc::SymbolMap map;
+    for (const auto& [name, address] : symbols) {
+        map[lljit_->mangleAndIntern(name)] = {llvm::orc::ExecutorAddr::fromPtr(address),
+                                              llvm::JITSymbolFlags::Exported |
+                                                  llvm::JITSymbolFlags::Callable};
+    }
+    auto& dylib = lljit_->getMainJITDylib();
+    if (auto error = dylib.define(llvm::orc::absoluteSymbols(std::move(map)))) {
+        LogError(std::move(error));
+        return false;
+    }
+    return true;
+}
+
+bool Jit::SetStub(const std::string& name, const std::string& target) {
+    // Looking `target` up here would compile it, failing if it calls a function that is only
+    // declared so far. The stub goes through a trampoline instead, which compiles `target` on
+    // the first call and then points the stub straight at its code.
+    auto trampoline = call_through_->getCallThroughTrampoline(
+        lljit_->getMainJITDylib(), lljit_->mangleAndIntern(target),
+        [this, name, target](llvm::orc::ExecutorAddr address) -> llvm::Error {
+            std::lock_guard lock(stubs_mutex_);
+            auto it = stub_targets_.find(name);
+            if (it == stub_targets_.end() || it->second != target) {
+                return llvm::Error::success();
+            }
+            return stubs_->updatePointer(name, address);
+        });
+    if (!trampoline) {
+        LogError(trampoline.takeError());
+        return false;
+    }
+    std::lock_guard lock(stubs_mutex_);
+    if (stubs_->findStub(name, true).getAddress()) {
+        // A single pointer-sized store: concurrent callers run either the old or the new code.
+        if (auto error = stubs_->updatePointer(name, *trampoline)) {
+            LogError(std::move(error));
+            return false;
+        }
+        stub_targets_[name] = target;
+        return true;
+    }
+    if (auto error = stubs_->createStub(name, *trampoline,
+                                        llvm::JITSymbolFlags::Exported |
+                                            llvm::JITSymbolFlags::Callable)) {
+        LogError(std::move(error));
+        return false;
+    }
+    stub_targets_[name] = target;
+    llvm::orc::SymbolMap symbols;
+    symbols[lljit_->mangleAndIntern(name)] = stubs_->findStub(name, true);
+    if (auto error = stubs_tracker_->getJITDylib().define(
+            llvm::orc::absoluteSymbols(std::move(symbols)), stubs_tracker_)) {
+        LogError(std::move(error));
+        return false;
+    }
+    return true;
+}
+
+bool Jit::RemoveStubs() {
+    if (auto error = stubs_tracker_->remove()) {
+        LogError(std::move(error));
+        return false;
+    }
+    std::lock_guard lock(stubs_mutex_);
+    stubs_ = llvm::orc::createLocalIndirectStubsManagerBuilder(lljit_->getTargetTriple())();
+    stub_targets_.clear();
+    stubs_tracker_ = lljit_->getMainJITDylib().createResourceTracker();
+    return true;
+}
+
+void* Jit::Lookup(const std::string& name) {
+    // Includes materialization; optimization and emission are timed separately.
+    stats::ScopedTimer timer(stats::Phase::kLink);
+    auto symbol = lljit_->lookup(name);
+    if (!symbol) {
+        return LogError(symbol.takeError());
+    }
+    return symbol->toPtr<void*>();
+}
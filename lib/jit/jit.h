@@ -0,0 +1,80 @@
+#pragma once
+
+#include <codegen/optimizer.h>
+
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/LazyReexports.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Descriptions of the code the JIT emits for `perf`, which otherwise sees anonymous addresses.
+struct PerfOptions {
+    // Names every function in /tmp/perf-<pid>.map, which `perf report` reads by itself.
+    bool perf_map = false;
+    // Writes the code and line tables of every function to jit-<pid>.dump in $JITDUMPDIR or
+    // ~/.debug/jit, for `perf inject --jit` on a `perf record -k 1` profile. Line tables need
+    // CodegenOptions::debug_info. Needs LLVM built with LLVM_USE_PERF.
+    bool jitdump = false;
+};
+
+class Jit {
+public:
+    // Returns null and logs an error if the JIT can't be created, or `perf` asks for jitdump
+    // records that LLVM can't write.
+    static std::unique_ptr<Jit> Create(OptimizerOptions optimizer_options = {},
+                                       PerfOptions perf = {});
+
+    // Sets the data layout and target triple modules must have to be added.
+    void ConfigureModule(llvm::Module* module) const;
+
+    llvm::orc::ResourceTrackerSP CreateResourceTracker();
+
+    // Optimizes and adds `module`. Its code is freed once `tracker` is removed.
+    bool AddModule(llvm::orc::ThreadSafeModule module,
+                   llvm::orc::ResourceTrackerSP tracker = nullptr);
+
+    // Links precompiled object code. It is copied, so `object` may go away afterwards.
+    bool AddObject(llvm::MemoryBufferRef object, llvm::orc::ResourceTrackerSP tracker = nullptr);
+
+    // Makes `name` resolve to the already added symbol `aliasee` until `tracker` is removed.
+    bool AddAlias(const std::string& name, const std::string& aliasee,
+                  llvm::orc::ResourceTrackerSP tracker = nullptr);
+
+    // Makes each name resolve to code that is already in memory, e.g. added to another Jit,
+    // which must outlive this one.
+    bool AddSymbols(const std::map<std::string, void*>& symbols);
+
+    // Points the stub `name` at the code of `target`, creating the stub on first use. Callers
+    // of `name` jump through the stub, so this swaps the code they run without recompiling
+    // them. `target` is compiled on the first call through the stub, so it may call functions
+    // that are not defined yet.
+    bool SetStub(const std::string& name, const std::string& target);
+
+    // Removes every stub, so their names can be defined directly again.
+    bool RemoveStubs();
+
+    void* Lookup(const std::string& name);
+
+private:
+    Jit(std::unique_ptr<llvm::orc::LLJIT> lljit,
+        std::unique_ptr<llvm::TargetMachine> target_machine, OptimizerOptions optimizer_options,
+        std::unique_ptr<llvm::orc::LazyCallThroughManager> call_through);
+
+    std::unique_ptr<llvm::orc::LLJIT> lljit_;
+    std::unique_ptr<llvm::TargetMachine> target_machine_;
+    OptimizerOptions optimizer_options_;
+    // Compiles the target of a stub on its first call, then points the stub at the code.
+    std::unique_ptr<llvm::orc::LazyCallThroughManager> call_through_;
+    // Guards `stubs_` and `stub_targets_`, which calls through stubs update from any thread.
+    std::mutex stubs_mutex_;
+    std::unique_ptr<llvm::orc::IndirectStubsManager> stubs_;
+    // Symbol each stub is set to, so a late first call to an old target leaves the stub alone.
+    std::map<std::string, std::string> stub_targets_;
+    // Owns the symbols of `stubs_` in the main JITDylib.
+    llvm::orc::ResourceTrackerSP stubs_tracker_;
+};
@@ -0,0 +1,84 @@
+#include "perf_map.h"
+
+#include <util.h>
+
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <unistd.h>
+
+#include <format>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+class PerfMapListener : public llvm::JITEventListener {
+public:
+    void notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile& object,
+                            const llvm::RuntimeDyld::LoadedObjectInfo& info) override {
+        // Symbols of the debug object have their load addresses.
+        auto debug_object = info.getObjectForDebug(object);
+        if (!debug_object.getBinary()) {
+            return;
+        }
+        std::string entries;
+        for (const auto& [symbol, size] :
+             llvm::object::computeSymbolSizes(*debug_object.getBinary())) {
+            auto type = symbol.getType();
+            if (!type || *type != llvm::object::SymbolRef::ST_Function || size == 0) {
+                llvm::consumeError(type.takeError());
+                continue;
+            }
+            auto name = symbol.getName();
+            auto address = symbol.getAddress();
+            if (!name || !address) {
+                llvm::consumeError(name.takeError());
+                llvm::consumeError(address.takeError());
+                continue;
+            }
+            entries += std::format("{:x} {:x} {}\n", *address, size, name->str());
+        }
+
+        std::lock_guard lock(mutex_);
+        if (!Open()) {
+            return;
+        }
+        // Whole lines at once, so perf never reads half of one.
+        *out_ << entries;
+        out_->flush();
+    }
+
+private:
+    bool Open() {
+        if (out_) {
+            return true;
+        }
+        if (failed_) {
+            return false;
+        }
+        auto path = std::format("/tmp/perf-{}.map", getpid());
+        std::error_code error;
+        out_ = std::make_unique<llvm::raw_fd_ostream>(path, error, llvm::sys::fs::OF_Append);
+        if (error) {
+            LogError(std::format("Cannot open {}: {}", path, error.message()));
+            out_.reset();
+            failed_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    std::mutex mutex_;
+    std::unique_ptr<llvm::raw_fd_ostream> out_;
+    // Logged once rather than for every object.
+    bool failed_ = false;
+};
+
+}  // namespace
+
+llvm::JITEventListener& GetPerfMapListener() {
+    static PerfMapListener listener;
+    return listener;
+}
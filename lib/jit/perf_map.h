@@ -0,0 +1,9 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/JITEventListener.h>
+
+// Appends `<address> <size> <name>` in hex for every function of the objects loaded to
+// /tmp/perf-<pid>.map, which `perf report` reads to name samples in JIT'd code. The file is
+// opened on the first object and shared by all the JITs of the process. Entries stay when
+// their code is freed, as perf maps can't remove any.
+llvm::JITEventListener& GetPerfMapListener();
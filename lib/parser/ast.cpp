@@ -0,0 +1,151 @@
+#include "ast.h"
+
+#include <overloaded.h>
+
+namespace ast {
+
+namespace {
+
+// Short strings live inside the node.
+size_t HeapBytes(const std::string& s) {
+    return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+}
+
+}  // namespace
+
+size_t OwnedBytes(const Node& node) {
+    return std::visit(Overloaded{
+                          [](const Number&) -> size_t { return 0; },
+                          [](const Variable& var) { return HeapBytes(var.name); },
+                          [](const BinaryOp& op) { return HeapBytes(op.op); },
+                          [](const CallExpression& call) {
+                              return HeapBytes(call.callee) +
+                                     call.args.capacity() * sizeof(NodePtr);
+                          },
+                          [](const ForLoop& loop) { return HeapBytes(loop.var); },
+                          [](const Conditional&) -> size_t { return 0; },
+                          [](const VarBinding& binding) { return HeapBytes(binding.var); },
+                      },
+                      node);
+}
+
+void CollectCallees(const Node& node, std::set<std::string>* callees) {
+    std::visit(Overloaded{
+                   [](const Number&) {},
+                   [](const Variable&) {},
+                   [callees](const BinaryOp& op) {
+                       CollectCallees(*op.lhs, callees);
+                       CollectCallees(*op.rhs, callees);
+                   },
+                   [callees](const CallExpression& call) {
+                       callees->insert(call.callee);
+                       // Functions passed to parallel builtins are called too.
+                       auto kinds = GetParallelBuiltinArgs(call.callee);
+                       for (size_t i = 0; i < call.args.size(); ++i) {
+                           auto* var = std::get_if<Variable>(call.args[i].get());
+                           if (var && i < kinds.size() && kinds[i] != BuiltinArg::kValue) {
+                               callees->insert(var->name);
+                           }
+                           CollectCallees(*call.args[i], callees);
+                       }
+                   },
+                   [callees](const ForLoop& loop) {
+                       CollectCallees(*loop.start, callees);
+                       CollectCallees(*loop.cond, callees);
+                       if (loop.step) {
+                           CollectCallees(*loop.step, callees);
+                       }
+                       CollectCallees(*loop.body, callees);
+                   },
+                   [callees](const Conditional& cond) {
+                       CollectCallees(*cond.cond, callees);
+                       CollectCallees(*cond.then_value, callees);
+                       CollectCallees(*cond.else_value, callees);
+                   },
+                   [callees](const VarBinding& binding) {
+                       CollectCallees(*binding.init, callees);
+                       CollectCallees(*binding.body, callees);
+                   },
+               },
+               node);
+}
+
+std::string_view TypeName(Type type) {
+    switch (type) {
+        case Type::kDouble:
+            return "double";
+        case Type::kFloat:
+            return "float";
+        case Type::kInt64:
+            return "i64";
+        case Type::kVec4:
+            return "vec4";
+        case Type::kVec8:
+            return "vec8";
+        case Type::kVec4f:
+            return "vec4f";
+        case Type::kVec8f:
+            return "vec8f";
+    }
+    return "";
+}
+
+std::optional<Type> ParseType(std::string_view name) {
+    for (auto type : kTypes) {
+        if (TypeName(type) == name) {
+            return type;
+        }
+    }
+    return std::nullopt;
+}
+
+size_t GetLaneCount(Type type) {
+    switch (type) {
+        case Type::kVec4:
+        case Type::kVec4f:
+            return 4;
+        case Type::kVec8:
+        case Type::kVec8f:
+            return 8;
+        default:
+            return 1;
+    }
+}
+
+Type GetElementType(Type type) {
+    switch (type) {
+        case Type::kVec4:
+        case Type::kVec8:
+            return Type::kDouble;
+        case Type::kVec4f:
+        case Type::kVec8f:
+            return Type::kFloat;
+        default:
+            return type;
+    }
+}
+
+std::span<const BuiltinArg> GetParallelBuiltinArgs(std::string_view name) {
+    using enum BuiltinArg;
+    static constexpr BuiltinArg kSum[] = {kIndexFunction, kValue};
+    static constexpr BuiltinArg kMap[] = {kIndexFunction, kValue, kBinaryFunction};
+    static constexpr BuiltinArg kReduce[] = {kIndexFunction, kValue, kBinaryFunction, kValue};
+    if (name == "parallel_sum") {
+        return kSum;
+    }
+    if (name == "parallel_map") {
+        return kMap;
+    }
+    if (name == "parallel_reduce") {
+        return kReduce;
+    }
+    return {};
+}
+
+void NodeDeleter::operator()(Node* node) const {
+    stats::TrackDeallocation(stats::MemoryPool::kAst, owned_bytes);
+    std::destroy_at(node);
+    NodeAllocator().deallocate(node, 1);
+}
+
+}  // namespace ast
@@ -1,6 +1,14 @@
 #pragma once
 
+#include <stats/memory.h>
+#include <stats/stats.h>
+
+#include <memory>
+#include <optional>
+#include <set>
+#include <span>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -11,9 +19,29 @@ struct Number;
 struct Variable;
 struct BinaryOp;
 struct CallExpression;
+struct ForLoop;
+struct Conditional;
+struct VarBinding;
+
+using Node =
+    std::variant<Number, Variable, BinaryOp, CallExpression, ForLoop, Conditional, VarBinding>;
+// Nodes are accounted to the AST memory pool, including the strings and vectors they own.
+struct NodeDeleter {
+    void operator()(Node* node) const;
+
+    // Charged for the strings and vectors when the node was made, released as is since passes
+    // may change them.
+    size_t owned_bytes = 0;
+};
 
-using Node = std::variant<Number, Variable, BinaryOp, CallExpression>;
-using NodePtr = std::unique_ptr<Node>;
+using NodePtr = std::unique_ptr<Node, NodeDeleter>;
+using NodeAllocator = stats::TrackingAllocator<Node, stats::MemoryPool::kAst>;
+
+// Heap bytes owned by `node` itself, not counting its children.
+size_t OwnedBytes(const Node& node);
+
+// Adds the names of all functions called in `node` to `callees`.
+void CollectCallees(const Node& node, std::set<std::string>* callees);
 
 struct Number {
     double value;
@@ -34,11 +62,89 @@ struct CallExpression {
     std::vector<NodePtr> args;
 };
 
+// `for var = start, cond, step in body`: runs `body` while `cond` is not zero, checked before
+// every iteration, then adds `step` to `var`. Evaluates to 0.
+struct ForLoop {
+    std::string var;
+    NodePtr start;
+    NodePtr cond;
+    // Null for the default step of 1.
+    NodePtr step;
+    NodePtr body;
+};
+
+// `if cond then then_value else else_value`, evaluating only the arm that is chosen.
+struct Conditional {
+    NodePtr cond;
+    NodePtr then_value;
+    NodePtr else_value;
+};
+
+// `var var = init in body`: evaluates `body` with `var` bound to the value of `init`.
+// `var a = 1, b = a in body` is parsed as one binding nested in another.
+struct VarBinding {
+    std::string var;
+    NodePtr init;
+    NodePtr body;
+};
+
+// Types of values. Arguments and results without an annotation are doubles.
+enum class Type {
+    kDouble,
+    kFloat,
+    kInt64,
+    // Vectors of 4 or 8 doubles or floats, which operators work on lane by lane.
+    kVec4,
+    kVec8,
+    kVec4f,
+    kVec8f,
+};
+
+inline constexpr Type kTypes[] = {
+    Type::kDouble, Type::kFloat, Type::kInt64, Type::kVec4, Type::kVec8, Type::kVec4f, Type::kVec8f,
+};
+
+// As written in annotations and conversions: `double`, `float`, `i64`, `vec4`, `vec8`, `vec4f`
+// and `vec8f`.
+std::string_view TypeName(Type type);
+std::optional<Type> ParseType(std::string_view name);
+
+// Lanes of vectors, 1 for scalars.
+size_t GetLaneCount(Type type);
+// Type of the lanes of vectors. Scalars are their own.
+Type GetElementType(Type type);
+
+// Arguments of the parallel builtins, which take functions by name: `parallel_sum(f, n)`,
+// `parallel_map(f, n, out)` and `parallel_reduce(f, n, combine, identity)`.
+enum class BuiltinArg {
+    kValue,
+    // `def f(i)`, called with indices.
+    kIndexFunction,
+    // `def f(a b)`.
+    kBinaryFunction,
+};
+
+// The arguments of the parallel builtin `name`, empty if it isn't one.
+std::span<const BuiltinArg> GetParallelBuiltinArgs(std::string_view name);
+
 struct Prototype {
     std::string name;
     std::vector<std::string> args;
+    // One per argument.
+    std::vector<Type> arg_types;
+    Type return_type = Type::kDouble;
+    // Of the definition in its source, 0 if unknown.
+    size_t line = 0;
+
+    // Whether calls to either can call the other.
+    bool HasSameSignature(const Prototype& other) const {
+        return arg_types == other.arg_types && return_type == other.return_type;
+    }
 };
 
+// Name of the functions wrapping top-level expressions.
+inline constexpr std::string_view kTopLevelExprName = "__anon_expr";
+
 struct Function {
     Prototype proto;
     NodePtr body;
@@ -50,7 +156,13 @@ struct Function {
 
 template <class T>
 NodePtr MakeNodePtr(T&& value) {
-    return std::make_unique<Node>(std::forward<T>(value));
+    stats::Add(stats::Counter::kAstNodes);
+    NodeAllocator allocator;
+    auto* node = allocator.allocate(1);
+    std::construct_at(node, std::forward<T>(value));
+    const auto owned_bytes = OwnedBytes(*node);
+    stats::TrackAllocation(stats::MemoryPool::kAst, owned_bytes);
+    return NodePtr(node, NodeDeleter{.owned_bytes = owned_bytes});
 }
 
 template <class T, class... Args>
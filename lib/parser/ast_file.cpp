@@ -0,0 +1,414 @@
+#include "ast_file.h"
+
+#include <overloaded.h>
+#include <util.h>
+
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+
+using namespace ast_file;
+
+namespace {
+
+constexpr uint32_t kNoBody = std::numeric_limits<uint32_t>::max();
+constexpr size_t kAlignment = 8;
+
+size_t AlignUp(size_t offset) {
+    return (offset + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+class Writer {
+public:
+    explicit Writer(std::span<const ast::Item> items) {
+        for (const auto& item : items) {
+            std::visit(Overloaded{
+                           [this](const ast::Prototype& proto) {
+                               AddItem(ItemKind::kExtern, proto, kNoBody);
+                           },
+                           [this](const ast::Function& fn) {
+                               AddItem(ItemKind::kFunction, fn.proto, AddNode(*fn.body));
+                           },
+                       },
+                       item);
+        }
+    }
+
+    void Write(llvm::raw_ostream& out) const {
+        Header header{
+            .magic = kMagic,
+            .version = kVersion,
+            .string_count = static_cast<uint32_t>(strings_.size()),
+            .string_bytes = static_cast<uint32_t>(string_bytes_.size()),
+            .node_count = static_cast<uint32_t>(nodes_.size()),
+            .operand_count = static_cast<uint32_t>(operands_.size()),
+            .item_count = static_cast<uint32_t>(items_.size()),
+            .reserved = 0,
+        };
+        size_t offset = 0;
+        auto write = [&](const void* data, size_t size) {
+            out.write(static_cast<const char*>(data), size);
+            offset += size;
+            out.write_zeros(AlignUp(offset) - offset);
+            offset = AlignUp(offset);
+        };
+        write(&header, sizeof(header));
+        write(strings_.data(), strings_.size() * sizeof(StringRecord));
+        write(string_bytes_.data(), string_bytes_.size());
+        write(nodes_.data(), nodes_.size() * sizeof(NodeRecord));
+        write(operands_.data(), operands_.size() * sizeof(uint32_t));
+        write(items_.data(), items_.size() * sizeof(ItemRecord));
+    }
+
+private:
+    uint32_t AddString(const std::string& s) {
+        auto [it, inserted] = string_indices_.try_emplace(s, strings_.size());
+        if (inserted) {
+            strings_.push_back({static_cast<uint32_t>(string_bytes_.size()),
+                                static_cast<uint32_t>(s.size())});
+            string_bytes_ += s;
+        }
+        return it->second;
+    }
+
+    uint32_t AddNode(const ast::Node& node) {
+        auto record = std::visit(
+            Overloaded{
+                [](const ast::Number& number) {
+                    return NodeRecord{NodeKind::kNumber, 0, std::bit_cast<uint64_t>(number.value)};
+                },
+                [this](const ast::Variable& var) {
+                    return NodeRecord{NodeKind::kVariable, AddString(var.name), 0};
+                },
+                [this](const ast::BinaryOp& op) {
+                    uint64_t lhs = AddNode(*op.lhs);
+                    uint64_t rhs = AddNode(*op.rhs);
+                    return NodeRecord{NodeKind::kBinaryOp, AddString(op.op), lhs | rhs << 32};
+                },
+                [this](const ast::CallExpression& call) {
+                    std::vector<uint32_t> args;
+                    for (const auto& arg : call.args) {
+                        args.push_back(AddNode(*arg));
+                    }
+                    uint64_t first = operands_.size();
+                    operands_.insert(operands_.end(), args.begin(), args.end());
+                    return NodeRecord{NodeKind::kCall, AddString(call.callee),
+                                      first | static_cast<uint64_t>(args.size()) << 32};
+                },
+                [this](const ast::ForLoop& loop) {
+                    std::vector<uint32_t> children{AddNode(*loop.start), AddNode(*loop.cond)};
+                    if (loop.step) {
+                        children.push_back(AddNode(*loop.step));
+                    }
+                    children.push_back(AddNode(*loop.body));
+                    uint64_t first = operands_.size();
+                    operands_.insert(operands_.end(), children.begin(), children.end());
+                    return NodeRecord{NodeKind::kFor, AddString(loop.var),
+                                      first | static_cast<uint64_t>(children.size()) << 32};
+                },
+                [this](const ast::Conditional& cond) {
+                    uint32_t children[] = {AddNode(*cond.cond), AddNode(*cond.then_value),
+                                           AddNode(*cond.else_value)};
+                    uint64_t first = operands_.size();
+                    operands_.insert(operands_.end(), std::begin(children), std::end(children));
+                    return NodeRecord{NodeKind::kIf, 0, first};
+                },
+                [this](const ast::VarBinding& binding) {
+                    uint64_t init = AddNode(*binding.init);
+                    uint64_t body = AddNode(*binding.body);
+                    return NodeRecord{NodeKind::kVar, AddString(binding.var), init | body << 32};
+                },
+            },
+            node);
+        nodes_.push_back(record);
+        return nodes_.size() - 1;
+    }
+
+    void AddItem(ItemKind kind, const ast::Prototype& proto, uint32_t body) {
+        ItemRecord record{
+            .kind = kind,
+            .name = AddString(proto.name),
+            .first_arg = static_cast<uint32_t>(operands_.size()),
+            .arg_count = static_cast<uint32_t>(proto.args.size()),
+            .body = body,
+            .return_type = proto.return_type,
+        };
+        for (const auto& arg : proto.args) {
+            operands_.push_back(AddString(arg));
+        }
+        for (auto type : proto.arg_types) {
+            operands_.push_back(static_cast<uint32_t>(type));
+        }
+        items_.push_back(record);
+    }
+
+    std::unordered_map<std::string, uint32_t> string_indices_;
+    std::vector<StringRecord> strings_;
+    std::string string_bytes_;
+    std::vector<NodeRecord> nodes_;
+    std::vector<uint32_t> operands_;
+    std::vector<ItemRecord> items_;
+};
+
+}  // namespace
+
+void WriteAstFile(std::span<const ast::Item> items, llvm::raw_ostream& out) {
+    Writer(items).Write(out);
+}
+
+std::unique_ptr<AstFile> AstFile::Open(const std::string& path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                              /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        return LogError(std::format("Cannot open {}: {}", path, buffer.getError().message()));
+    }
+    return Create(std::move(*buffer));
+}
+
+std::unique_ptr<AstFile> AstFile::Create(std::unique_ptr<llvm::MemoryBuffer> buffer) {
+    std::unique_ptr<AstFile> file(new AstFile(std::move(buffer)));
+    if (!file->Init()) {
+        return nullptr;
+    }
+    return file;
+}
+
+AstFile::AstFile(std::unique_ptr<llvm::MemoryBuffer> buffer) : buffer_(std::move(buffer)) {
+}
+
+bool AstFile::Init() {
+    const char* data = buffer_->getBufferStart();
+    const size_t size = buffer_->getBufferSize();
+    if (reinterpret_cast<uintptr_t>(data) % kAlignment != 0) {
+        LogError("AST file is not aligned");
+        return false;
+    }
+    if (size < sizeof(Header)) {
+        LogError("Not an AST file");
+        return false;
+    }
+    const auto* header = reinterpret_cast<const Header*>(data);
+    if (header->magic != kMagic) {
+        LogError("Not an AST file, or written on a host with another byte order");
+        return false;
+    }
+    if (header->version != kVersion) {
+        LogError(std::format("AST file version {} is not supported, expected {}",
+                             header->version, kVersion));
+        return false;
+    }
+
+    size_t offset = AlignUp(sizeof(Header));
+    auto section = [&]<class T>(std::span<const T>* out, size_t count) {
+        if (offset > size || count > (size - offset) / sizeof(T)) {
+            return false;
+        }
+        *out = {reinterpret_cast<const T*>(data + offset), count};
+        offset = AlignUp(offset + count * sizeof(T));
+        return true;
+    };
+    std::span<const char> string_bytes;
+    if (!section(&strings_, header->string_count) ||
+        !section(&string_bytes, header->string_bytes) ||
+        !section(&nodes_, header->node_count) || !section(&operands_, header->operand_count) ||
+        !section(&items_, header->item_count)) {
+        LogError("Truncated AST file");
+        return false;
+    }
+    string_bytes_ = {string_bytes.data(), string_bytes.size()};
+
+    // Loading trusts the indices checked here. Children come before their parents, so there
+    // are no cycles, and each node has one parent, so that loading builds no more nodes than
+    // the file has.
+    auto valid_operands = [&](uint64_t first, uint64_t count) {
+        return first <= operands_.size() && count <= operands_.size() - first;
+    };
+    for (const auto& record : strings_) {
+        if (record.offset > string_bytes_.size() ||
+            record.size > string_bytes_.size() - record.offset) {
+            LogError("Invalid string in AST file");
+            return false;
+        }
+    }
+    std::vector<bool> referenced(nodes_.size());
+    std::vector<uint32_t> depths(nodes_.size(), 1);
+    auto refer = [&](uint64_t child, size_t parent) {
+        if (child >= parent || referenced[child] || depths[child] >= kMaxDepth) {
+            return false;
+        }
+        referenced[child] = true;
+        depths[parent] = std::max(depths[parent], depths[child] + 1);
+        return true;
+    };
+    auto refer_operands = [&](uint64_t first, uint64_t count, size_t parent) {
+        return valid_operands(first, count) &&
+               std::ranges::all_of(operands_.subspan(first, count),
+                                   [&](uint32_t child) { return refer(child, parent); });
+    };
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        const auto& node = nodes_[i];
+        uint64_t low = node.payload & 0xffffffff;
+        uint64_t high = node.payload >> 32;
+        bool valid = false;
+        switch (node.kind) {
+            case NodeKind::kNumber:
+                valid = true;
+                break;
+            case NodeKind::kVariable:
+                valid = node.name < strings_.size();
+                break;
+            case NodeKind::kBinaryOp:
+                valid = node.name < strings_.size() && refer(low, i) && refer(high, i);
+                break;
+            case NodeKind::kCall:
+                valid = node.name < strings_.size() && refer_operands(low, high, i);
+                break;
+            case NodeKind::kFor:
+                valid = node.name < strings_.size() && (high == 3 || high == 4) &&
+                        refer_operands(low, high, i);
+                break;
+            case NodeKind::kIf:
+                valid = high == 0 && refer_operands(low, 3, i);
+                break;
+            case NodeKind::kVar:
+                valid = node.name < strings_.size() && refer(low, i) && refer(high, i);
+                break;
+        }
+        if (!valid) {
+            LogError(std::format("Invalid node {} in AST file", i));
+            return false;
+        }
+    }
+    auto valid_type = [](uint32_t type) { return type < std::size(ast::kTypes); };
+    for (const auto& item : items_) {
+        bool valid =
+            item.name < strings_.size() &&
+            valid_operands(item.first_arg, uint64_t{item.arg_count} * 2) &&
+            std::ranges::all_of(operands_.subspan(item.first_arg, item.arg_count),
+                                [this](uint32_t arg) { return arg < strings_.size(); }) &&
+            std::ranges::all_of(operands_.subspan(item.first_arg + item.arg_count, item.arg_count),
+                                valid_type) &&
+            valid_type(static_cast<uint32_t>(item.return_type));
+        switch (item.kind) {
+            case ItemKind::kExtern:
+                break;
+            case ItemKind::kFunction:
+                valid = valid && item.body < nodes_.size() && !referenced[item.body];
+                if (valid) {
+                    referenced[item.body] = true;
+                }
+                break;
+            default:
+                valid = false;
+        }
+        if (!valid) {
+            LogError("Invalid item in AST file");
+            return false;
+        }
+    }
+    if (!std::ranges::all_of(referenced, std::identity{})) {
+        LogError("Unreferenced node in AST file");
+        return false;
+    }
+    return true;
+}
+
+size_t AstFile::GetItemCount() const {
+    return items_.size();
+}
+
+std::string_view AstFile::GetItemName(size_t index) const {
+    return GetString(items_[index].name);
+}
+
+bool AstFile::IsExtern(size_t index) const {
+    return items_[index].kind == ItemKind::kExtern;
+}
+
+ast::Item AstFile::LoadItem(size_t index) const {
+    const auto& record = items_[index];
+    ast::Prototype proto{
+        .name = std::string(GetString(record.name)),
+        .args = GetOperandStrings(record.first_arg, record.arg_count),
+        .return_type = record.return_type,
+    };
+    for (auto type : operands_.subspan(record.first_arg + record.arg_count, record.arg_count)) {
+        proto.arg_types.push_back(static_cast<ast::Type>(type));
+    }
+    if (record.kind == ItemKind::kExtern) {
+        return proto;
+    }
+    return ast::Function{std::move(proto), LoadNode(record.body)};
+}
+
+std::vector<ast::Item> AstFile::Load() const {
+    std::vector<ast::Item> items;
+    items.reserve(items_.size());
+    for (size_t i = 0; i < items_.size(); ++i) {
+        items.push_back(LoadItem(i));
+    }
+    return items;
+}
+
+std::string_view AstFile::GetString(uint32_t index) const {
+    const auto& record = strings_[index];
+    return string_bytes_.substr(record.offset, record.size);
+}
+
+std::vector<std::string> AstFile::GetOperandStrings(uint32_t first, uint32_t count) const {
+    std::vector<std::string> strings;
+    strings.reserve(count);
+    for (auto index : operands_.subspan(first, count)) {
+        strings.emplace_back(GetString(index));
+    }
+    return strings;
+}
+
+ast::NodePtr AstFile::LoadNode(uint32_t index) const {
+    const auto& record = nodes_[index];
+    const auto low = static_cast<uint32_t>(record.payload);
+    const auto high = static_cast<uint32_t>(record.payload >> 32);
+    switch (record.kind) {
+        case NodeKind::kNumber:
+            return ast::MakeNodePtr(ast::Number{std::bit_cast<double>(record.payload)});
+        case NodeKind::kVariable:
+            return ast::MakeNodePtr(ast::Variable{std::string(GetString(record.name))});
+        case NodeKind::kBinaryOp:
+            return ast::MakeNodePtr(
+                ast::BinaryOp{std::string(GetString(record.name)), LoadNode(low), LoadNode(high)});
+        case NodeKind::kCall: {
+            std::vector<ast::NodePtr> args;
+            args.reserve(high);
+            for (auto arg : operands_.subspan(low, high)) {
+                args.push_back(LoadNode(arg));
+            }
+            return ast::MakeNodePtr(
+                ast::CallExpression{std::string(GetString(record.name)), std::move(args)});
+        }
+        case NodeKind::kFor: {
+            auto children = operands_.subspan(low, high);
+            return ast::MakeNodePtr(ast::ForLoop{
+                .var = std::string(GetString(record.name)),
+                .start = LoadNode(children[0]),
+                .cond = LoadNode(children[1]),
+                .step = high == 4 ? LoadNode(children[2]) : nullptr,
+                .body = LoadNode(children.back()),
+            });
+        }
+        case NodeKind::kIf: {
+            auto children = operands_.subspan(low, 3);
+            return ast::MakeNodePtr(ast::Conditional{
+                .cond = LoadNode(children[0]),
+                .then_value = LoadNode(children[1]),
+                .else_value = LoadNode(children[2]),
+            });
+        }
+        case NodeKind::kVar:
+            return ast::MakeNodePtr(ast::VarBinding{std::string(GetString(record.name)),
+                                                    LoadNode(low), LoadNode(high)});
+    }
+    return nullptr;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "ast.h"
+
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace ast {
+
+// A top-level item: an extern, or a definition or top-level expression.
+using Item = std::variant<Prototype, Function>;
+
+}  // namespace ast
+
+namespace ast_file {
+
+inline constexpr uint32_t kMagic = 0x5453414b;  // "KAST"
+inline constexpr uint32_t kVersion = 6;
+// Deepest nesting of nodes a file may have, since loading them recurses.
+inline constexpr uint32_t kMaxDepth = 1000;
+
+// Followed by the sections in this order, each aligned to 8 bytes.
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t string_count;
+    uint32_t string_bytes;
+    uint32_t node_count;
+    uint32_t operand_count;
+    uint32_t item_count;
+    uint32_t reserved;
+};
+
+struct StringRecord {
+    uint32_t offset;
+    uint32_t size;
+};
+
+enum class NodeKind : uint32_t {
+    kNumber,
+    kVariable,
+    kBinaryOp,
+    kCall,
+    kFor,
+    kIf,
+    kVar,
+};
+
+// Numbers keep the bits of their value in `payload`. Variables, operators and callees are
+// `name`. Binary operators pack their operand nodes into `payload` as lhs | rhs << 32, calls
+// their first operand and argument count. Loops name their variable and pack their first
+// operand and operand count: start, condition, step if there is one, and body. Conditionals
+// pack their first operand: condition, then and else. Bindings name their variable and pack
+// init | body << 32.
+struct NodeRecord {
+    NodeKind kind;
+    uint32_t name;
+    uint64_t payload;
+};
+
+enum class ItemKind : uint32_t {
+    kExtern,
+    kFunction,
+};
+
+// Argument names are `arg_count` strings listed in the operands from `first_arg`, followed by
+// as many argument types. Only functions have a `body`.
+struct ItemRecord {
+    ItemKind kind;
+    uint32_t name;
+    uint32_t first_arg;
+    uint32_t arg_count;
+    uint32_t body;
+    ast::Type return_type;
+};
+
+}  // namespace ast_file
+
+// Writes `items` in the binary AST format read by AstFile, see ast_file::Header. Everything is
+// in host byte order and nodes come after their children.
+void WriteAstFile(std::span<const ast::Item> items, llvm::raw_ostream& out);
+
+// A binary AST file, read in place. Items can be inspected without rebuilding them.
+class AstFile {
+public:
+    // Maps the file at `path`. Returns null and logs an error if it is not a valid AST file.
+    static std::unique_ptr<AstFile> Open(const std::string& path);
+    static std::unique_ptr<AstFile> Create(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+    size_t GetItemCount() const;
+    std::string_view GetItemName(size_t index) const;
+    bool IsExtern(size_t index) const;
+
+    ast::Item LoadItem(size_t index) const;
+    std::vector<ast::Item> Load() const;
+
+private:
+    explicit AstFile(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+    // Sets up the sections, false if they don't fit in the buffer or refer out of bounds.
+    bool Init();
+    std::string_view GetString(uint32_t index) const;
+    std::vector<std::string> GetOperandStrings(uint32_t first, uint32_t count) const;
+    ast::NodePtr LoadNode(uint32_t index) const;
+
+    std::unique_ptr<llvm::MemoryBuffer> buffer_;
+    std::span<const ast_file::StringRecord> strings_;
+    std::string_view string_bytes_;
+    std::span<const ast_file::NodeRecord> nodes_;
+    std::span<const uint32_t> operands_;
+    std::span<const ast_file::ItemRecord> items_;
+};
@@ -24,15 +24,46 @@ std::ostream& operator<<(std::ostream& out, Debug<ast::CallExpression> call) {
     return out << ")";
 }
 
+std::ostream& operator<<(std::ostream& out, Debug<ast::ForLoop> loop) {
+    out << "(<for> " << loop.inner->var << " " << Debug{loop.inner->start.get()} << " "
+        << Debug{loop.inner->cond.get()} << " ";
+    if (loop.inner->step) {
+        out << Debug{loop.inner->step.get()} << " ";
+    }
+    return out << Debug{loop.inner->body.get()} << ")";
+}
+
+std::ostream& operator<<(std::ostream& out, Debug<ast::Conditional> cond) {
+    return out << "(<if> " << Debug{cond.inner->cond.get()} << " "
+               << Debug{cond.inner->then_value.get()} << " " << Debug{cond.inner->else_value.get()}
+               << ")";
+}
+
+std::ostream& operator<<(std::ostream& out, Debug<ast::VarBinding> binding) {
+    return out << "(<var> " << binding.inner->var << " " << Debug{binding.inner->init.get()}
+               << " " << Debug{binding.inner->body.get()} << ")";
+}
+
 std::ostream& operator<<(std::ostream& out, Debug<ast::Node> node) {
     std::visit([&out](const auto& inner) { out << Debug{&inner}; }, *node.inner);
     return out;
 }
 
 std::ostream& operator<<(std::ostream& out, Debug<ast::Prototype> proto) {
+    // Only annotations that aren't the default are printed.
+    auto annotate = [&out](ast::Type type) {
+        if (type != ast::Type::kDouble) {
+            out << ":" << ast::TypeName(type);
+        }
+    };
     out << "(<proto> " << proto.inner->name;
-    for (const auto& arg : proto.inner->args) {
-        out << " " << arg;
+    for (size_t i = 0; i < proto.inner->args.size(); ++i) {
+        out << " " << proto.inner->args[i];
+        annotate(proto.inner->arg_types[i]);
+    }
+    if (proto.inner->return_type != ast::Type::kDouble) {
+        out << " ";
+        annotate(proto.inner->return_type);
     }
     out << ")";
     return out;
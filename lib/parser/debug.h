@@ -14,6 +14,9 @@ std::ostream& operator<<(std::ostream& out, Debug<ast::Variable> var);
 std::ostream& operator<<(std::ostream& out, Debug<ast::Number> number);
 std::ostream& operator<<(std::ostream& out, Debug<ast::BinaryOp> op);
 std::ostream& operator<<(std::ostream& out, Debug<ast::CallExpression> call);
+std::ostream& operator<<(std::ostream& out, Debug<ast::ForLoop> loop);
+std::ostream& operator<<(std::ostream& out, Debug<ast::Conditional> cond);
+std::ostream& operator<<(std::ostream& out, Debug<ast::VarBinding> binding);
 std::ostream& operator<<(std::ostream& out, Debug<ast::Node> node);
 std::ostream& operator<<(std::ostream& out, Debug<ast::Prototype> proto);
 std::ostream& operator<<(std::ostream& out, Debug<ast::Function> func);
@@ -0,0 +1,341 @@
+#include "incremental_parser.h"
+
+#include "parser.h"
+
+#include <util.h>
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+using namespace token;
+
+namespace {
+
+bool IsSpace(char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+}
+
+bool IsAlpha(char c) {
+    return std::isalpha(static_cast<unsigned char>(c));
+}
+
+bool IsAlnum(char c) {
+    return std::isalnum(static_cast<unsigned char>(c));
+}
+
+bool IsNumberCharacter(char c) {
+    return std::isdigit(static_cast<unsigned char>(c)) || c == '.';
+}
+
+// Same as Tokenizer's.
+bool IsOperatorCharacter(char c) {
+    constexpr std::string_view forbidden_characters = "(),;#";
+    return !IsSpace(c) && !IsAlnum(c) && forbidden_characters.find(c) == std::string_view::npos;
+}
+
+// Tokens that never appear within an expression, so they end one even if it's incomplete.
+bool EndsExpression(TokenKind kind) {
+    return kind == TokenKind::kDef || kind == TokenKind::kExtern ||
+           kind == TokenKind::kSemicolon || kind == TokenKind::kEof;
+}
+
+}  // namespace
+
+IncrementalParser::IncrementalParser(std::map<std::string, uint8_t> precedence)
+    : precedence_(std::move(precedence)) {
+}
+
+void IncrementalParser::Feed(std::string_view chunk) {
+    buffer_ += chunk;
+    for (; pos_ < buffer_.size(); ++pos_) {
+        Lex(buffer_[pos_]);
+        // Counted after the character ends a token, so that the token has the line it is on.
+        line_ += buffer_[pos_] == '\n';
+    }
+    Compact();
+}
+
+void IncrementalParser::Close() {
+    if (closed_) {
+        return;
+    }
+    if (lex_state_ != LexState::kSpace && lex_state_ != LexState::kComment) {
+        EndToken();
+    }
+    OnToken(TokenKind::kEof, pos_, pos_);
+    closed_ = true;
+    buffer_.clear();
+    pos_ = 0;
+}
+
+std::optional<ast::Item> IncrementalParser::Next() {
+    while (!ready_.empty()) {
+        auto parsed = std::move(ready_.front());
+        ready_.pop_front();
+        for (const auto& error : parsed.errors) {
+            LogError(error);
+        }
+        if (parsed.item) {
+            return std::move(parsed.item);
+        }
+    }
+    return std::nullopt;
+}
+
+bool IncrementalParser::IsDone() const {
+    return closed_ && ready_.empty();
+}
+
+void IncrementalParser::Lex(char c) {
+    switch (lex_state_) {
+        case LexState::kComment:
+            if (c == '\n') {
+                lex_state_ = LexState::kSpace;
+            }
+            return;
+        case LexState::kIdent:
+            if (IsAlnum(c)) {
+                return;
+            }
+            EndToken();
+            break;
+        case LexState::kNumber:
+            if (IsNumberCharacter(c)) {
+                return;
+            }
+            EndToken();
+            break;
+        case LexState::kOperator:
+            if (IsOperatorCharacter(c)) {
+                return;
+            }
+            EndToken();
+            break;
+        case LexState::kSpace:
+            break;
+    }
+
+    if (IsSpace(c)) {
+        return;
+    }
+    if (c == '#') {
+        lex_state_ = LexState::kComment;
+    } else if (IsAlpha(c)) {
+        StartToken(LexState::kIdent);
+    } else if (IsNumberCharacter(c)) {
+        StartToken(LexState::kNumber);
+    } else if (c == '(' || c == ')') {
+        OnToken(TokenKind::kBracket, pos_, pos_ + 1);
+    } else if (c == ',') {
+        OnToken(TokenKind::kComma, pos_, pos_ + 1);
+    } else if (c == ';') {
+        OnToken(TokenKind::kSemicolon, pos_, pos_ + 1);
+    } else {
+        StartToken(LexState::kOperator);
+    }
+}
+
+void IncrementalParser::StartToken(LexState state) {
+    lex_state_ = state;
+    token_begin_ = pos_;
+}
+
+void IncrementalParser::EndToken() {
+    auto kind = TokenKind::kOperator;
+    if (lex_state_ == LexState::kNumber) {
+        kind = TokenKind::kNumber;
+    } else if (lex_state_ == LexState::kIdent) {
+        std::string_view ident(buffer_.data() + token_begin_, pos_ - token_begin_);
+        kind = ident == "def"      ? TokenKind::kDef
+               : ident == "extern" ? TokenKind::kExtern
+               : ident == "for"    ? TokenKind::kFor
+               : ident == "in"     ? TokenKind::kIn
+               : ident == "if"     ? TokenKind::kIf
+               : ident == "then"   ? TokenKind::kThen
+               : ident == "else"   ? TokenKind::kElse
+               : ident == "var"    ? TokenKind::kVar
+                                   : TokenKind::kIdent;
+    }
+    lex_state_ = LexState::kSpace;
+    OnToken(kind, token_begin_, pos_);
+}
+
+void IncrementalParser::OnToken(TokenKind kind, size_t begin, size_t end) {
+    switch (item_state_) {
+        case ItemState::kNone:
+            if (kind == TokenKind::kSemicolon || kind == TokenKind::kEof) {
+                return;
+            }
+            item_kind_ = kind;
+            item_begin_ = begin;
+            // Tokens don't span lines, so the item starts on the current one.
+            item_line_ = line_;
+            if (kind == TokenKind::kDef) {
+                item_state_ = ItemState::kPrototype;
+                return;
+            }
+            if (kind == TokenKind::kExtern) {
+                item_state_ = ItemState::kExtern;
+                return;
+            }
+            item_state_ = ItemState::kExpression;
+            depth_ = 0;
+            open_headers_ = 0;
+            open_branches_ = 0;
+            after_operand_ = false;
+            OnExpressionToken(kind, begin, end);
+            return;
+        case ItemState::kExtern:
+            item_state_ = ItemState::kPrototype;
+            if (kind != TokenKind::kDef) {
+                // Without `def` the extern is malformed, the parser will tell how.
+                OnToken(kind, begin, end);
+            }
+            return;
+        case ItemState::kPrototype:
+            if (EndsExpression(kind)) {
+                EndItem(begin);
+                OnToken(kind, begin, end);
+            } else if (buffer_[begin] == ')') {
+                item_state_ = ItemState::kAfterPrototype;
+            } else if (kind != TokenKind::kIdent && kind != TokenKind::kBracket &&
+                       !IsColon(kind, begin, end)) {
+                // The prototype is malformed, the parser will tell how.
+                EndItem(end);
+            }
+            return;
+        case ItemState::kAfterPrototype:
+            if (IsColon(kind, begin, end)) {
+                item_state_ = ItemState::kReturnType;
+                return;
+            }
+            EndPrototype(begin);
+            OnToken(kind, begin, end);
+            return;
+        case ItemState::kReturnType:
+            if (kind == TokenKind::kIdent) {
+                EndPrototype(end);
+            } else if (EndsExpression(kind)) {
+                EndItem(begin);
+                OnToken(kind, begin, end);
+            } else {
+                EndItem(end);
+            }
+            return;
+        case ItemState::kExpression:
+            OnExpressionToken(kind, begin, end);
+            return;
+    }
+}
+
+void IncrementalParser::OnExpressionToken(TokenKind kind, size_t begin, size_t end) {
+    if (EndsExpression(kind)) {
+        EndItem(begin);
+        OnToken(kind, begin, end);
+        return;
+    }
+    const bool open = kind == TokenKind::kBracket && buffer_[begin] == '(';
+    const bool close = kind == TokenKind::kBracket && !open;
+    if (depth_ > 0) {
+        depth_ += open;
+        depth_ -= close;
+        if (depth_ == 0) {
+            after_operand_ = true;
+            after_ident_ = false;
+        }
+        return;
+    }
+
+    // Outside brackets, commas and `in` belong to the header of a loop or binding if one is open.
+    const bool in_header = open_headers_ > 0 && after_operand_;
+    if (in_header && (kind == TokenKind::kComma || kind == TokenKind::kIn)) {
+        open_headers_ -= kind == TokenKind::kIn;
+        after_operand_ = false;
+        return;
+    }
+    // Likewise, `then` and `else` go on a conditional.
+    if (open_branches_ > 0 && after_operand_ &&
+        (kind == TokenKind::kThen || kind == TokenKind::kElse)) {
+        --open_branches_;
+        after_operand_ = false;
+        return;
+    }
+    if (after_operand_) {
+        if (kind == TokenKind::kOperator) {
+            after_operand_ = false;
+        } else if (open && after_ident_) {
+            depth_ = 1;
+        } else {
+            // The token starts the next item.
+            EndItem(begin);
+            OnToken(kind, begin, end);
+        }
+        return;
+    }
+    if (kind == TokenKind::kIdent || kind == TokenKind::kNumber) {
+        after_operand_ = true;
+        after_ident_ = kind == TokenKind::kIdent;
+    } else if (open) {
+        depth_ = 1;
+    } else if (kind == TokenKind::kFor || kind == TokenKind::kVar) {
+        ++open_headers_;
+    } else if (kind == TokenKind::kIf) {
+        open_branches_ += 2;
+    } else {
+        // Can't start an operand, the parser will tell why.
+        EndItem(end);
+    }
+}
+
+void IncrementalParser::EndPrototype(size_t end) {
+    if (item_kind_ == TokenKind::kExtern) {
+        EndItem(end);
+        return;
+    }
+    item_state_ = ItemState::kExpression;
+    depth_ = 0;
+    open_headers_ = 0;
+    open_branches_ = 0;
+    after_operand_ = false;
+}
+
+bool IncrementalParser::IsColon(TokenKind kind, size_t begin, size_t end) const {
+    return kind == TokenKind::kOperator &&
+           std::string_view(buffer_).substr(begin, end - begin) == ":";
+}
+
+void IncrementalParser::EndItem(size_t end) {
+    item_state_ = ItemState::kNone;
+    std::istringstream in(buffer_.substr(item_begin_, end - item_begin_));
+    Parser parser(precedence_, &in, item_line_);
+    Parsed parsed;
+    ScopedErrorSink sink([&](std::string_view error) { parsed.errors.emplace_back(error); });
+    if (item_kind_ == TokenKind::kDef) {
+        if (auto fn = parser.ParseDefinition()) {
+            parsed.item = std::move(*fn);
+        } else {
+            LogError("Failed to parse definition");
+        }
+    } else if (item_kind_ == TokenKind::kExtern) {
+        if (auto proto = parser.ParseExtern()) {
+            parsed.item = std::move(*proto);
+        }
+    } else if (auto fn = parser.ParseTopLevelExpr()) {
+        parsed.item = std::move(*fn);
+    }
+    ready_.push_back(std::move(parsed));
+}
+
+void IncrementalParser::Compact() {
+    size_t keep = pos_;
+    if (item_state_ != ItemState::kNone) {
+        keep = item_begin_;
+    } else if (lex_state_ != LexState::kSpace && lex_state_ != LexState::kComment) {
+        keep = token_begin_;
+    }
+    buffer_.erase(0, keep);
+    pos_ -= keep;
+    item_begin_ -= std::min(item_begin_, keep);
+    token_begin_ -= std::min(token_begin_, keep);
+}
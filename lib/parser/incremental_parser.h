@@ -0,0 +1,107 @@
+#pragma once
+
+#include "ast_file.h"
+#include "token.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Push-style parser for input that arrives in chunks, e.g. from non-blocking pipes or sockets,
+// so one thread can serve many inputs. Feed never blocks: a resumable tokenizer scans the new
+// bytes, and every top-level item that is complete is parsed and queued.
+//
+// Like with Tokenizer, an expression is complete once the token after it has arrived, since
+// that token decides whether it goes on. The same goes for externs, which a return type may
+// follow.
+class IncrementalParser {
+public:
+    explicit IncrementalParser(std::map<std::string, uint8_t> precedence);
+
+    // Scans the next bytes of the input.
+    void Feed(std::string_view chunk);
+
+    // Marks the end of the input, which completes the last item.
+    void Close();
+
+    // Takes the next complete item. Items that fail to parse are dropped, and their errors are
+    // logged once reached here, on the thread taking the items.
+    std::optional<ast::Item> Next();
+
+    // Whether the input is closed and every item has been taken.
+    bool IsDone() const;
+
+private:
+    enum class LexState {
+        kSpace,
+        kComment,
+        kIdent,
+        kNumber,
+        kOperator,
+    };
+
+    enum class ItemState {
+        // Between items.
+        kNone,
+        // After `extern`, where the `def` of its prototype comes.
+        kExtern,
+        // In the prototype of a definition or extern, up to its closing bracket.
+        kPrototype,
+        // Right after the closing bracket of a prototype, where a return type may come.
+        kAfterPrototype,
+        // After the `:` of a return type.
+        kReturnType,
+        kExpression,
+    };
+
+    // A complete item, or the errors of one that failed to parse.
+    struct Parsed {
+        std::optional<ast::Item> item;
+        std::vector<std::string> errors;
+    };
+
+    void Lex(char c);
+    void StartToken(LexState state);
+    void EndToken();
+    // Advances the item over the token in `buffer_[begin, end)`.
+    void OnToken(token::TokenKind kind, size_t begin, size_t end);
+    void OnExpressionToken(token::TokenKind kind, size_t begin, size_t end);
+    // Ends the prototype of the current item, which starts the body of a definition.
+    void EndPrototype(size_t end);
+    bool IsColon(token::TokenKind kind, size_t begin, size_t end) const;
+    // Parses `buffer_[item_begin_, end)` as a whole item.
+    void EndItem(size_t end);
+    // Drops the bytes no item or token needs anymore.
+    void Compact();
+
+    std::map<std::string, uint8_t> precedence_;
+    std::deque<Parsed> ready_;
+    bool closed_ = false;
+
+    // Input from the start of the current item, or of the current token between items.
+    std::string buffer_;
+    size_t pos_ = 0;
+    // Line of `pos_` in the whole input, from 1.
+    size_t line_ = 1;
+    LexState lex_state_ = LexState::kSpace;
+    size_t token_begin_ = 0;
+
+    ItemState item_state_ = ItemState::kNone;
+    token::TokenKind item_kind_ = token::TokenKind::kEof;
+    size_t item_begin_ = 0;
+    size_t item_line_ = 1;
+    // Open brackets in the expression.
+    size_t depth_ = 0;
+    // Loops and bindings outside brackets whose `in` hasn't come yet.
+    size_t open_headers_ = 0;
+    // `then`s and `else`s that conditionals outside brackets still expect.
+    size_t open_branches_ = 0;
+    // Whether the last token ended an operand, and whether that was an identifier, which an
+    // open bracket turns into a call.
+    bool after_operand_ = false;
+    bool after_ident_ = false;
+};
@@ -2,6 +2,10 @@
 
 #include <overloaded.h>
 #include <parser/token.h>
+#include <stats/stats.h>
+
+#include <format>
+#include <ranges>
 #include <utility>
 
 using namespace token;
@@ -48,6 +52,9 @@ ast::NodePtr Parser::ParsePrimary() {
     return std::visit(Overloaded{
                           [this](Ident ident) { return ParseIdentifierExpr(); },
                           [this](Number number) { return ParseNumberExpr(); },
+                          [this](For) { return ParseForExpr(); },
+                          [this](If) { return ParseIfExpr(); },
+                          [this](Var) { return ParseVarExpr(); },
                           [this](Bracket bracket) -> ast::NodePtr {
                               if (bracket.kind != BracketKind::kOpen) {
                                   return LogError(msg);
@@ -82,6 +89,128 @@ ast::NodePtr Parser::ParseParenExpr() {
     return v;
 }
 
+ast::NodePtr Parser::ParseForExpr() {
+    tokenizer_.Next();
+    auto ident = std::get_if<Ident>(&tokenizer_.Get());
+    if (!ident) {
+        return LogError("Expected identifier after for");
+    }
+    std::string var = ident->value;
+    tokenizer_.Next();
+
+    if (tokenizer_.Get() != Token{Operator{"="}}) {
+        return LogError("Expected '=' after for");
+    }
+    tokenizer_.Next();
+
+    auto start = ParseExpression();
+    if (!start) {
+        return nullptr;
+    }
+    if (tokenizer_.Get() != Token{Comma{}}) {
+        return LogError("Expected ',' after for start value");
+    }
+    tokenizer_.Next();
+
+    auto cond = ParseExpression();
+    if (!cond) {
+        return nullptr;
+    }
+
+    ast::NodePtr step;
+    if (tokenizer_.Get() == Token{Comma{}}) {
+        tokenizer_.Next();
+        step = ParseExpression();
+        if (!step) {
+            return nullptr;
+        }
+    }
+
+    if (tokenizer_.Get() != Token{In{}}) {
+        return LogError("Expected 'in' after for");
+    }
+    tokenizer_.Next();
+
+    auto body = ParseExpression();
+    if (!body) {
+        return nullptr;
+    }
+    return ast::MakeNodePtr(std::in_place_type<ast::ForLoop>, std::move(var), std::move(start),
+                            std::move(cond), std::move(step), std::move(body));
+}
+
+ast::NodePtr Parser::ParseIfExpr() {
+    tokenizer_.Next();
+    auto cond = ParseExpression();
+    if (!cond) {
+        return nullptr;
+    }
+
+    if (tokenizer_.Get() != Token{Then{}}) {
+        return LogError("Expected then");
+    }
+    tokenizer_.Next();
+    auto then_value = ParseExpression();
+    if (!then_value) {
+        return nullptr;
+    }
+
+    if (tokenizer_.Get() != Token{Else{}}) {
+        return LogError("Expected else");
+    }
+    tokenizer_.Next();
+    auto else_value = ParseExpression();
+    if (!else_value) {
+        return nullptr;
+    }
+    return ast::MakeNodePtr(std::in_place_type<ast::Conditional>, std::move(cond),
+                            std::move(then_value), std::move(else_value));
+}
+
+ast::NodePtr Parser::ParseVarExpr() {
+    tokenizer_.Next();
+    std::vector<std::pair<std::string, ast::NodePtr>> bindings;
+    while (true) {
+        auto ident = std::get_if<Ident>(&tokenizer_.Get());
+        if (!ident) {
+            return LogError("Expected identifier after var");
+        }
+        std::string var = ident->value;
+        tokenizer_.Next();
+
+        if (tokenizer_.Get() != Token{Operator{"="}}) {
+            return LogError("Expected '=' after var name");
+        }
+        tokenizer_.Next();
+        auto init = ParseExpression();
+        if (!init) {
+            return nullptr;
+        }
+        bindings.emplace_back(std::move(var), std::move(init));
+
+        if (tokenizer_.Get() != Token{Comma{}}) {
+            break;
+        }
+        tokenizer_.Next();
+    }
+
+    if (tokenizer_.Get() != Token{In{}}) {
+        return LogError("Expected 'in' after var");
+    }
+    tokenizer_.Next();
+
+    auto body = ParseExpression();
+    if (!body) {
+        return nullptr;
+    }
+    // Later bindings are in the scope of earlier ones.
+    for (auto& [var, init] : bindings | std::views::reverse) {
+        body = ast::MakeNodePtr(std::in_place_type<ast::VarBinding>, std::move(var),
+                                std::move(init), std::move(body));
+    }
+    return body;
+}
+
 ast::NodePtr Parser::ParseBinOpRHS(uint8_t lhs_prec, ast::NodePtr lhs) {
     auto operator_not_found = [](std::string_view op) {
         return LogError(std::format("Operator {} not found", op));
@@ -144,6 +273,7 @@ std::unique_ptr<ast::Prototype> Parser::ParsePrototype() {
         return LogError("Expected function name in prototype");
     }
     auto fn_name = ident->value;
+    const auto line = tokenizer_.GetLine();
     tokenizer_.Next();
 
     if (tokenizer_.Get() != Token{Bracket{BracketKind::kOpen}}) {
@@ -152,19 +282,50 @@ std::unique_ptr<ast::Prototype> Parser::ParsePrototype() {
     tokenizer_.Next();
 
     std::vector<std::string> arg_names;
+    std::vector<ast::Type> arg_types;
     while (auto ident = std::get_if<Ident>(&tokenizer_.Get())) {
         arg_names.push_back(ident->value);
         tokenizer_.Next();
+        auto type = ParseTypeAnnotation(ast::Type::kDouble);
+        if (!type) {
+            return nullptr;
+        }
+        arg_types.push_back(*type);
     }
     if (tokenizer_.Get() != Token{Bracket{BracketKind::kClose}}) {
         return LogError("Expected ')' in prototype");
     }
     tokenizer_.Next();
 
-    return std::make_unique<ast::Prototype>(std::move(fn_name), std::move(arg_names));
+    auto return_type = ParseTypeAnnotation(ast::Type::kDouble);
+    if (!return_type) {
+        return nullptr;
+    }
+    return std::make_unique<ast::Prototype>(std::move(fn_name), std::move(arg_names),
+                                            std::move(arg_types), *return_type, line);
+}
+
+std::optional<ast::Type> Parser::ParseTypeAnnotation(ast::Type fallback) {
+    if (tokenizer_.Get() != Token{Operator{":"}}) {
+        return fallback;
+    }
+    tokenizer_.Next();
+    auto ident = std::get_if<Ident>(&tokenizer_.Get());
+    if (!ident) {
+        LogError("Expected type after ':'");
+        return std::nullopt;
+    }
+    auto type = ast::ParseType(ident->value);
+    if (!type) {
+        LogError(std::format("Unknown type {}", ident->value));
+        return std::nullopt;
+    }
+    tokenizer_.Next();
+    return type;
 }
 
 std::unique_ptr<ast::Function> Parser::ParseDefinition() {
+    stats::ScopedTimer timer(stats::Phase::kParse);
     auto proto = ParsePrototype();
     if (!proto) {
         return nullptr;
@@ -179,6 +340,8 @@ std::unique_ptr<ast::Function> Parser::ParseDefinition() {
 }
 
 std::unique_ptr<ast::Function> Parser::ParseTopLevelExpr() {
+    stats::ScopedTimer timer(stats::Phase::kParse);
+    const auto line = tokenizer_.GetLine();
     auto expr = ParseExpression();
     if (!expr) {
         return nullptr;
@@ -186,13 +349,15 @@ std::unique_ptr<ast::Function> Parser::ParseTopLevelExpr() {
     auto proto = std::make_unique<ast::Prototype>("__anon_expr", std::vector<std::string>{});
     return std::make_unique<ast::Function>(
         ast::Prototype{
-            .name = "__anon_expr",
+            .name = std::string(ast::kTopLevelExprName),
             .args = {},
+            .line = line,
         },
         std::move(expr));
 }
 
 std::unique_ptr<ast::Prototype> Parser::ParseExtern() {
+    stats::ScopedTimer timer(stats::Phase::kParse);
     tokenizer_.Next();
     return ParsePrototype();
 }
@@ -7,8 +7,8 @@
 #include <map>
 
 struct Parser {
-    Parser(std::map<std::string, uint8_t> precedence, std::istream* in)
-        : precedence_(std::move(precedence)), tokenizer_(in) {
+    Parser(std::map<std::string, uint8_t> precedence, std::istream* in, size_t first_line = 1)
+        : precedence_(std::move(precedence)), tokenizer_(in, first_line) {
     }
 
     ast::NodePtr ParseExpression();
@@ -22,9 +22,14 @@ private:
     ast::NodePtr ParseIdentifierExpr();
     ast::NodePtr ParseParenExpr();
     ast::NodePtr ParseNumberExpr();
+    ast::NodePtr ParseForExpr();
+    ast::NodePtr ParseIfExpr();
+    ast::NodePtr ParseVarExpr();
     ast::NodePtr ParsePrimary();
     ast::NodePtr ParseBinOpRHS(uint8_t expr_prec, ast::NodePtr lhs);
     std::unique_ptr<ast::Prototype> ParsePrototype();
+    // Parses `:type` if it comes next, returning `fallback` otherwise.
+    std::optional<ast::Type> ParseTypeAnnotation(ast::Type fallback);
 
     std::optional<uint8_t> GetBinopPrecedence(const std::string& op) const;
     std::optional<std::string> GetNextOperator() const;
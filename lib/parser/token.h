@@ -8,6 +8,12 @@
 #define FORALL_TOKEN_KINDS_SEP(op, sep) \
     op(Eof) sep op(Def)                 \
     sep op(Extern)                      \
+    sep op(For)                         \
+    sep op(In)                          \
+    sep op(If)                          \
+    sep op(Then)                        \
+    sep op(Else)                        \
+    sep op(Var)                         \
     sep op(Ident)                       \
     sep op(Number)                      \
     sep op(Bracket)                     \
@@ -38,6 +44,30 @@ struct Extern {
     bool operator==(const Extern&) const = default;
 };
 
+struct For {
+    bool operator==(const For&) const = default;
+};
+
+struct In {
+    bool operator==(const In&) const = default;
+};
+
+struct If {
+    bool operator==(const If&) const = default;
+};
+
+struct Then {
+    bool operator==(const Then&) const = default;
+};
+
+struct Else {
+    bool operator==(const Else&) const = default;
+};
+
+struct Var {
+    bool operator==(const Var&) const = default;
+};
+
 struct Ident {
     std::string value;
 
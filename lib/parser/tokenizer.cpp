@@ -1,5 +1,7 @@
 #include "tokenizer.h"
 
+#include <stats/stats.h>
+
 #include <cassert>
 #include <cctype>
 
@@ -15,12 +17,15 @@ bool IsOperatorCharacter(char c) {
 
 }  // namespace
 
-Tokenizer::Tokenizer(std::istream* in) : in_(in) {
+Tokenizer::Tokenizer(std::istream* in, size_t first_line) : in_(in), line_(first_line) {
     Next();
 }
 
 void Tokenizer::Next() {
+    stats::ScopedTimer timer(stats::Phase::kTokenize);
+    stats::Add(stats::Counter::kTokens);
     SkipSpacesAndComments();
+    cur_line_ = line_;
     const auto cur_c = in_->peek();
 
     if (std::isalpha(cur_c)) {
@@ -37,6 +42,30 @@ void Tokenizer::Next() {
             cur_token_ = Extern{};
             return;
         }
+        if (ident == "for") {
+            cur_token_ = For{};
+            return;
+        }
+        if (ident == "in") {
+            cur_token_ = In{};
+            return;
+        }
+        if (ident == "if") {
+            cur_token_ = If{};
+            return;
+        }
+        if (ident == "then") {
+            cur_token_ = Then{};
+            return;
+        }
+        if (ident == "else") {
+            cur_token_ = Else{};
+            return;
+        }
+        if (ident == "var") {
+            cur_token_ = Var{};
+            return;
+        }
         cur_token_ = Ident{std::move(ident)};
         return;
     }
@@ -90,9 +119,16 @@ const Token& Tokenizer::Get() const {
     return cur_token_;
 }
 
+size_t Tokenizer::GetLine() const {
+    return cur_line_;
+}
+
 void Tokenizer::SkipSpacesAndComments() {
+    // Tokens never contain newlines, so lines are only counted here.
     while (std::isspace(in_->peek())) {
-        in_->get();
+        if (in_->get() == '\n') {
+            ++line_;
+        }
     }
     if (in_->peek() != '#') {
         return;
@@ -5,15 +5,21 @@
 #include <istream>
 
 struct Tokenizer {
-    Tokenizer(std::istream* in);
+    // `first_line` numbers the first line of `in`, e.g. if it starts in the middle of a file.
+    Tokenizer(std::istream* in, size_t first_line = 1);
 
     void Next();
 
     const Token& Get() const;
 
+    // Line of the current token, from 1.
+    size_t GetLine() const;
+
 private:
     void SkipSpacesAndComments();
 
     std::istream* in_;
     Token cur_token_;
+    size_t line_ = 1;
+    size_t cur_line_ = 1;
 };
@@ -0,0 +1,250 @@
+#include "pipeline.h"
+
+#include <parser/token.h>
+#include <codegen/codegen.h>
+#include <util.h>
+
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/Support/Format.h>
+
+#include <chrono>
+#include <format>
+#include <thread>
+
+using namespace token;
+
+Pipeline::Pipeline(std::istream* in, llvm::raw_ostream* out,
+                   std::map<std::string, uint8_t> binop_precedence, std::unique_ptr<Jit> jit,
+                   PipelineOptions options)
+    : parser_(std::move(binop_precedence), in),
+      out_(out),
+      jit_(std::move(jit)),
+      options_(std::move(options)),
+      parsed_(options_.queue_capacity),
+      compiled_(options_.queue_capacity) {
+}
+
+void Pipeline::Run() {
+    auto start = std::chrono::steady_clock::now();
+    const size_t compile_threads = std::max<size_t>(options_.compile_threads, 1);
+    // Target registration isn't thread-safe, so the machines are created up front.
+    std::vector<std::unique_ptr<llvm::TargetMachine>> target_machines(compile_threads);
+    for (auto& target_machine : target_machines) {
+        target_machine = CreateHostTargetMachine();
+    }
+    std::vector<stats::Stats> compile_stats(compile_threads);
+    stats::Stats parse_stats;
+    stats::Stats link_stats;
+    {
+        std::vector<std::jthread> threads;
+        threads.emplace_back([&] {
+            stats::ScopedCollector collector(options_.collect_stats ? &parse_stats : nullptr);
+            Parse();
+        });
+        for (size_t i = 0; i < compile_threads; ++i) {
+            threads.emplace_back([&, i] {
+                auto* stats = options_.collect_stats ? &compile_stats[i] : nullptr;
+                Compile(target_machines[i].get(), stats);
+            });
+        }
+
+        // Objects arrive in any order, they are linked in input order.
+        stats::ScopedCollector collector(options_.collect_stats ? &link_stats : nullptr);
+        std::map<size_t, CompiledItem> pending;
+        size_t next = 0;
+        for (size_t ended = 0; ended < compile_threads;) {
+            auto item = compiled_.Pop();
+            if (item.end) {
+                ++ended;
+                continue;
+            }
+            pending.emplace(item.index, std::move(item));
+            for (auto it = pending.find(next); it != pending.end(); it = pending.find(++next)) {
+                Link(std::move(it->second));
+                pending.erase(it);
+            }
+        }
+    }
+
+    report_.wall_time = std::chrono::steady_clock::now() - start;
+    report_.memory = stats::GetMemorySnapshot();
+    if (options_.collect_stats) {
+        report_.AddItem({.kind = "stage", .name = "parse", .stats = parse_stats});
+        for (size_t i = 0; i < compile_stats.size(); ++i) {
+            report_.AddItem(
+                {.kind = "stage", .name = std::format("compile.{}", i), .stats = compile_stats[i]});
+        }
+        report_.AddItem({.kind = "stage", .name = "link", .stats = link_stats});
+    }
+}
+
+const stats::Report& Pipeline::GetReport() const {
+    return report_;
+}
+
+void Pipeline::Parse() {
+    // Prototypes of every function seen so far, in input order, so compile threads don't
+    // depend on each other.
+    std::map<std::string, ast::Prototype> protos;
+    std::set<std::string> defined;
+    size_t index = 0;
+    auto forget_unlinked = [&] {
+        std::lock_guard lock(unlinked_mutex_);
+        for (const auto& name : unlinked_) {
+            protos.erase(name);
+            defined.erase(name);
+        }
+        unlinked_.clear();
+    };
+    auto push = [&](std::unique_ptr<ast::Function> fn, bool expression) {
+        forget_unlinked();
+        ParsedItem item{.index = index++, .expression = expression};
+        std::set<std::string> callees;
+        ast::CollectCallees(*fn->body, &callees);
+        for (const auto& callee : callees) {
+            if (auto it = protos.find(callee); it != protos.end()) {
+                item.callees.push_back(it->second);
+            }
+            if (defined.contains(callee)) {
+                item.defined_callees.insert(callee);
+            }
+        }
+        item.function = std::move(fn);
+        parsed_.Push(std::move(item));
+    };
+
+    while (true) {
+        switch (GetTokenKind(parser_.GetTokenizer()->Get())) {
+            case TokenKind::kEof:
+                for (size_t i = 0; i < std::max<size_t>(options_.compile_threads, 1); ++i) {
+                    parsed_.Push({});
+                }
+                return;
+            case TokenKind::kSemicolon:
+                parser_.GetTokenizer()->Next();
+                break;
+            case TokenKind::kDef: {
+                auto fn = parser_.ParseDefinition();
+                if (!fn) {
+                    LogError("Failed to parse definition");
+                    parser_.GetTokenizer()->Next();
+                    break;
+                }
+                const auto& name = fn->GetName();
+                forget_unlinked();
+                if (defined.contains(name)) {
+                    LogError(std::format("Function {} is already defined", name));
+                    break;
+                }
+                // Recursive calls need the function's own prototype.
+                protos[name] = fn->proto;
+                defined.insert(name);
+                push(std::move(fn), false);
+                break;
+            }
+            case TokenKind::kExtern: {
+                auto proto = parser_.ParseExtern();
+                if (!proto) {
+                    parser_.GetTokenizer()->Next();
+                    break;
+                }
+                forget_unlinked();
+                if (defined.contains(proto->name) &&
+                    !proto->HasSameSignature(protos.at(proto->name))) {
+                    LogError(std::format("{} is defined with another signature", proto->name));
+                    break;
+                }
+                protos[proto->name] = *proto;
+                break;
+            }
+            default: {
+                auto fn = parser_.ParseTopLevelExpr();
+                if (!fn) {
+                    parser_.GetTokenizer()->Next();
+                    break;
+                }
+                push(std::move(fn), true);
+                break;
+            }
+        }
+    }
+}
+
+void Pipeline::Compile(llvm::TargetMachine* target_machine, stats::Stats* stats) {
+    stats::ScopedCollector collector(stats);
+    CodegenCtx ctx("pipeline", options_.codegen);
+    if (target_machine) {
+        ctx.module->setDataLayout(target_machine->createDataLayout());
+        ctx.module->setTargetTriple(target_machine->getTargetTriple().str());
+    }
+
+    while (true) {
+        auto item = parsed_.Pop();
+        auto* fn = item.function.get();
+        if (!fn) {
+            compiled_.Push({.end = true});
+            return;
+        }
+        // Expressions are all named __anon_expr, they may be linked at the same time.
+        CompiledItem compiled{
+            .index = item.index,
+            .name = item.expression ? std::format("{}.{}", fn->GetName(), item.index)
+                                    : fn->GetName(),
+            .expression = item.expression,
+        };
+        for (auto& proto : item.callees) {
+            auto name = proto.name;
+            ctx.function_protos[name] = std::move(proto);
+        }
+        ctx.defined_functions.insert(item.defined_callees.begin(), item.defined_callees.end());
+
+        auto* fn_ir = target_machine ? Codegen(*fn, &ctx) : nullptr;
+        if (!fn_ir) {
+            compiled_.Push(std::move(compiled));
+            ctx.TakeModule();
+            continue;
+        }
+        fn_ir->setName(compiled.name);
+
+        auto module = ctx.TakeModule();
+        module.withModuleDo([&](llvm::Module& m) {
+            Optimize(&m, target_machine, options_.optimizer);
+            stats::ScopedTimer timer(stats::Phase::kEmit);
+            auto object = llvm::orc::SimpleCompiler(*target_machine)(m);
+            if (!object) {
+                LogError(llvm::toString(object.takeError()));
+                return;
+            }
+            compiled.object = std::move(*object);
+        });
+        compiled_.Push(std::move(compiled));
+    }
+}
+
+void Pipeline::Link(CompiledItem item) {
+    if (!item.expression) {
+        if (item.object && jit_->AddObject(item.object->getMemBufferRef())) {
+            return;
+        }
+        if (item.object) {
+            LogError(std::format("Failed to link {}", item.name));
+        }
+        std::lock_guard lock(unlinked_mutex_);
+        unlinked_.insert(item.name);
+        return;
+    }
+    if (!item.object) {
+        return;
+    }
+    // The expression's code is freed right after it is evaluated.
+    auto tracker = jit_->CreateResourceTracker();
+    if (!jit_->AddObject(item.object->getMemBufferRef(), tracker)) {
+        return;
+    }
+    if (auto* fn_ptr = reinterpret_cast<double (*)()>(jit_->Lookup(item.name))) {
+        (*out_) << "Evaluated to " << llvm::format("%f", fn_ptr()) << '\n';
+    }
+    if (auto error = tracker->remove()) {
+        LogError(llvm::toString(std::move(error)));
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "queue.h"
+
+#include <parser/parser.h>
+#include <codegen/codegen_ctx.h>
+#include <codegen/optimizer.h>
+#include <jit/jit.h>
+#include <stats/report.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+struct PipelineOptions {
+    CodegenOptions codegen;
+    OptimizerOptions optimizer;
+    // Threads running codegen, optimization and emission.
+    size_t compile_threads = 2;
+    // Items in flight between two stages.
+    size_t queue_capacity = 64;
+    // Records compile statistics of every stage, see Pipeline::GetReport.
+    bool collect_stats = false;
+};
+
+// Runs a program in stages connected by bounded queues, so a streamed program takes about as
+// long as its slowest stage. One thread parses items, `compile_threads` threads generate,
+// optimize and emit object code for them, and the calling thread links the objects in input
+// order and evaluates top-level expressions. Functions can't be redefined.
+class Pipeline {
+public:
+    Pipeline(std::istream* in, llvm::raw_ostream* out,
+             std::map<std::string, uint8_t> binop_precedence, std::unique_ptr<Jit> jit,
+             PipelineOptions options = {});
+
+    // Runs the program to the end of the input.
+    void Run();
+
+    // One item per stage.
+    const stats::Report& GetReport() const;
+
+private:
+    struct ParsedItem {
+        size_t index = 0;
+        // Null at the end of the input.
+        std::unique_ptr<ast::Function> function;
+        bool expression = false;
+        // Prototypes of the functions called by `function`, and which of them have a body.
+        std::vector<ast::Prototype> callees;
+        std::set<std::string> defined_callees;
+    };
+
+    struct CompiledItem {
+        size_t index = 0;
+        // Null if compilation failed.
+        std::unique_ptr<llvm::MemoryBuffer> object;
+        std::string name;
+        bool expression = false;
+        bool end = false;
+    };
+
+    void Parse();
+    // Null `target_machine` fails every item.
+    void Compile(llvm::TargetMachine* target_machine, stats::Stats* stats);
+    void Link(CompiledItem item);
+
+    Parser parser_;
+    llvm::raw_ostream* out_;
+    std::unique_ptr<Jit> jit_;
+    PipelineOptions options_;
+    BoundedQueue<ParsedItem> parsed_;
+    BoundedQueue<CompiledItem> compiled_;
+    stats::Report report_;
+
+    // Definitions that failed to compile or link, which Parse forgets so that they can be
+    // defined again and calls in between fail to compile.
+    std::mutex unlinked_mutex_;
+    std::set<std::string> unlinked_;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+// Bounded multi-producer multi-consumer queue after Dmitry Vyukov's design. Each cell has a
+// sequence number telling whose turn it is, so pushes and pops only race on one atomic index
+// and never take a lock. A full or empty queue blocks on the cell's sequence number instead of
+// spinning.
+template <class T>
+class BoundedQueue {
+public:
+    // `capacity` is rounded up to a power of two.
+    explicit BoundedQueue(size_t capacity)
+        : mask_(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+          cells_(std::make_unique<Cell[]>(mask_ + 1)) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    void Push(T value) {
+        auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& cell = cells_[pos & mask_];
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                                       std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    cell.sequence.notify_all();
+                    return;
+                }
+            } else if (diff < 0) {
+                // Full: wait for a consumer to free the cell.
+                cell.sequence.wait(sequence, std::memory_order_acquire);
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    T Pop() {
+        auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& cell = cells_[pos & mask_];
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                                       std::memory_order_relaxed)) {
+                    T value = std::move(cell.value);
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    cell.sequence.notify_all();
+                    return value;
+                }
+            } else if (diff < 0) {
+                // Empty: wait for a producer to fill the cell.
+                cell.sequence.wait(sequence, std::memory_order_acquire);
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    // On separate cache lines, producers and consumers don't contend on each other's index.
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) std::atomic<size_t> dequeue_pos_{0};
+};
@@ -1,14 +1,24 @@
 #include "repl.h"
 
-#include <parser/token.h>
 #include <codegen/codegen.h>
+#include <overloaded.h>
 #include <util.h>
 
-using namespace token;
+#include <llvm/Support/Format.h>
+
+#include <algorithm>
+#include <format>
 
 Repl::Repl(std::istream* in, llvm::raw_ostream* out,
-           std::map<std::string, uint8_t> binop_precedence)
-    : parser_(std::move(binop_precedence), in), codegen_ctx_("my cool jit"), out_(out) {
+           std::map<std::string, uint8_t> binop_precedence, std::unique_ptr<Jit> jit,
+           ReplOptions options)
+    : parser_(std::move(binop_precedence), in),
+      driver_(&parser_, options.collect_stats),
+      jit_(std::move(jit)),
+      codegen_ctx_("my cool jit", options.codegen),
+      options_(std::move(options)),
+      out_(out) {
+    jit_->ConfigureModule(codegen_ctx_.module.get());
 }
 
 void Repl::Prompt(llvm::raw_ostream* out) {
@@ -16,75 +26,396 @@ void Repl::Prompt(llvm::raw_ostream* out) {
 }
 
 void Repl::MainLoop() {
-    while (true) {
-        Prompt(out_);
-        switch (GetTokenKind(parser_.GetTokenizer()->Get())) {
-            case TokenKind::kEof:
-                return;
-            case TokenKind::kSemicolon:
-                parser_.GetTokenizer()->Next();
-                break;
-            case TokenKind::kDef:
-                HandleDefinition();
-                break;
-            case TokenKind::kExtern:
-                HandleExtern();
-                break;
-            default:
-                HandleTopLevelExpression();
-                break;
+    driver_.Run(
+        {
+            .definition = [this] { return HandleDefinition(); },
+            .extern_ = [this] { return HandleExtern(); },
+            .expression = [this] { return HandleTopLevelExpression(); },
+        },
+        [this] { Prompt(out_); });
+}
+
+const stats::Report& Repl::GetReport() const {
+    return driver_.GetReport();
+}
+
+void Repl::Handle(ast::Item item) {
+    std::visit(Overloaded{
+                   [this](ast::Prototype& proto) {
+                       driver_.Handle("extern", [&] {
+                           AddExtern(proto);
+                           return proto.name;
+                       });
+                   },
+                   [this](ast::Function& fn) {
+                       auto name = fn.GetName();
+                       if (name == ast::kTopLevelExprName) {
+                           driver_.Handle("expression", [&] {
+                               Evaluate(fn);
+                               return name;
+                           });
+                           return;
+                       }
+                       driver_.Handle("definition", [&] {
+                           AddFunction(std::make_unique<ast::Function>(std::move(fn)));
+                           return name;
+                       });
+                   },
+               },
+               item);
+}
+
+void Repl::Load(std::vector<ast::Item> items) {
+    echo_ = false;
+    for (auto& item : items) {
+        Handle(std::move(item));
+    }
+    echo_ = true;
+}
+
+bool Repl::LoadBundle(const Bundle& bundle) {
+    if (!CanLink(bundle.GetTriple(), bundle.GetInterface()) ||
+        !jit_->AddObject(bundle.GetObject())) {
+        return false;
+    }
+    AddInterface(bundle.GetInterface());
+    return true;
+}
+
+bool Repl::LoadPrelude(const Prelude& prelude) {
+    if (!CanLink(prelude.GetTriple(), prelude.GetInterface()) ||
+        !jit_->AddSymbols(prelude.GetSymbols())) {
+        return false;
+    }
+    AddInterface(prelude.GetInterface());
+    return true;
+}
+
+bool Repl::CanLink(std::string_view triple, const BundleInterface& interface) const {
+    if (triple != codegen_ctx_.module->getTargetTriple()) {
+        LogError(std::format("Bundle is compiled for {}, not {}", triple,
+                             codegen_ctx_.module->getTargetTriple()));
+        return false;
+    }
+    for (const auto& proto : interface.definitions) {
+        if (definitions_.contains(proto.name) || bundled_.contains(proto.name)) {
+            LogError(std::format("Bundle redefines {}", proto.name));
+            return false;
         }
     }
+    return true;
+}
+
+void Repl::AddInterface(const BundleInterface& interface) {
+    for (const auto& proto : interface.definitions) {
+        codegen_ctx_.function_protos[proto.name] = proto;
+        codegen_ctx_.defined_functions.insert(proto.name);
+        bundled_.insert(proto.name);
+    }
+    for (const auto& proto : interface.externs) {
+        codegen_ctx_.function_protos.try_emplace(proto.name, proto);
+    }
 }
 
-void Repl::HandleDefinition() {
+std::string Repl::HandleDefinition() {
     auto fn = parser_.ParseDefinition();
     if (!fn) {
         LogError("Failed to parse definition");
         parser_.GetTokenizer()->Next();
+        return {};
+    }
+    auto name = fn->GetName();
+    AddFunction(std::move(fn));
+    return name;
+}
+
+void Repl::AddFunction(std::unique_ptr<ast::Function> fn) {
+    if (bundled_.contains(fn->GetName())) {
+        LogError(std::format("{} is defined by a bundle and can't be redefined", fn->GetName()));
+    } else if (definitions_.contains(fn->GetName())) {
+        Redefine(std::move(fn));
+    } else {
+        Define(std::move(fn), "Read function definition: ");
+    }
+}
+
+bool Repl::Define(std::unique_ptr<ast::Function> fn, std::string_view header) {
+    auto pending = Prepare(*fn, header);
+    if (!pending) {
+        return false;
+    }
+    pending->definition.function = std::move(fn);
+    if (!Link(*pending)) {
+        if (pending->definition.aliasee.empty()) {
+            deduplicator_.Erase(pending->key);
+        }
+        return false;
+    }
+    return true;
+}
+
+void Repl::Redefine(std::unique_ptr<ast::Function> fn) {
+    // Declarations left in the current module by failed items may have the old signature.
+    codegen_ctx_.TakeModule();
+    const auto name = fn->GetName();
+    if (!fn->proto.HasSameSignature(definitions_.at(name).function->proto)) {
+        for (const auto& [caller, definition] : definitions_) {
+            if (caller != name && definition.callees.contains(name)) {
+                LogError(std::format("Cannot change the signature of {}, {} calls it", name,
+                                     caller));
+                return;
+            }
+        }
+    }
+
+    // The old definition and its dependents are about to go, so they can't be aliased.
+    auto dependents = FindDependents(name, !options_.call_stubs);
+    std::vector<Definition> old;
+    old.push_back(ExtractDefinition(name));
+    for (const auto& dependent : dependents) {
+        old.push_back(ExtractDefinition(dependent));
+    }
+
+    // Every new version is generated before any old code goes.
+    std::vector<PendingDefinition> pending;
+    for (size_t i = 0; i < old.size(); ++i) {
+        auto& function = i == 0 ? fn : old[i].function;
+        auto prepared = Prepare(*function, i == 0 ? "Read function definition: "
+                                                  : "Recompiled dependent function: ");
+        if (!prepared) {
+            if (i > 0) {
+                LogError(std::format("Failed to recompile {}", function->GetName()));
+            }
+            Restore(std::move(old), std::move(pending), 0, false);
+            return;
+        }
+        prepared->definition.function = std::move(function);
+        pending.push_back(std::move(*prepared));
+    }
+
+    // Direct calls bind to the names, which must be free before they are defined again. Stubs
+    // keep pointing at the old code until all new versions are linked.
+    if (!options_.call_stubs) {
+        for (const auto& definition : old) {
+            RemoveCode(definition);
+        }
+    }
+    for (size_t i = 0; i < pending.size(); ++i) {
+        if (!Link(pending[i])) {
+            Restore(std::move(old), std::move(pending), i, !options_.call_stubs);
+            return;
+        }
+    }
+    if (options_.call_stubs) {
+        for (const auto& definition : old) {
+            RemoveCode(definition);
+        }
+    }
+}
+
+void Repl::Devirtualize() {
+    if (!options_.call_stubs) {
         return;
     }
-    auto* fn_ir = Codegen(*fn, &codegen_ctx_);
-    if (!fn_ir) {
-        LogError("Failed to codegen");
+    options_.call_stubs = false;
+    std::vector<Definition> old;
+    while (!definitions_.empty()) {
+        old.push_back(ExtractDefinition(definitions_.begin()->first));
+    }
+    for (const auto& definition : old) {
+        RemoveCode(definition);
+    }
+    if (!jit_->RemoveStubs()) {
         return;
     }
-    Out() << "Read function definition: ";
-    fn_ir->print(Out());
-    Out() << '\n';
+    // Functions with their own code come first, so aliases find them again.
+    std::ranges::stable_partition(old, [](const auto& definition) {
+        return definition.aliasee.empty();
+    });
+    for (auto& definition : old) {
+        auto name = definition.function->GetName();
+        if (!Define(std::move(definition.function), "Devirtualized function: ")) {
+            LogError(std::format("Failed to recompile {}", name));
+        }
+    }
 }
 
-void Repl::HandleExtern() {
+std::optional<Repl::PendingDefinition> Repl::Prepare(const ast::Function& fn,
+                                                    std::string_view header) {
+    PendingDefinition pending;
+    pending.name = fn.GetName();
+    pending.key = StructuralKey(fn, codegen_ctx_.GetFpMode(pending.name));
+    if (auto canonical = deduplicator_.Find(pending.key)) {
+        codegen_ctx_.function_protos[pending.name] = fn.proto;
+        codegen_ctx_.defined_functions.insert(pending.name);
+        Out() << header << pending.name << " is an alias of " << *canonical << '\n';
+        pending.definition.aliasee = std::move(*canonical);
+    } else {
+        auto* fn_ir = Codegen(fn, &codegen_ctx_);
+        if (!fn_ir) {
+            LogError("Failed to codegen");
+            return std::nullopt;
+        }
+        Out() << header;
+        fn_ir->print(Out());
+        Out() << '\n';
+        pending.definition.impl = pending.name;
+        if (options_.call_stubs) {
+            pending.definition.impl = std::format("{}.{}", pending.name, ++next_impl_);
+            fn_ir->setName(pending.definition.impl);
+        }
+        pending.module = codegen_ctx_.TakeModule();
+        deduplicator_.Insert(pending.key, pending.name);
+    }
+    ast::CollectCallees(*fn.body, &pending.definition.callees);
+    return pending;
+}
+
+bool Repl::Link(PendingDefinition& pending) {
+    auto& definition = pending.definition;
+    definition.tracker = jit_->CreateResourceTracker();
+    if (!definition.aliasee.empty()) {
+        definition.impl = definitions_.at(definition.aliasee).impl;
+        if (!(options_.call_stubs
+                  ? jit_->SetStub(pending.name, definition.impl)
+                  : jit_->AddAlias(pending.name, definition.impl, definition.tracker))) {
+            return false;
+        }
+    } else {
+        if (!jit_->AddModule(std::move(pending.module), definition.tracker)) {
+            return false;
+        }
+        if (options_.call_stubs && !jit_->SetStub(pending.name, definition.impl)) {
+            RemoveCode(definition);
+            return false;
+        }
+    }
+    definitions_[pending.name] = std::move(definition);
+    return true;
+}
+
+void Repl::Restore(std::vector<Definition> old, std::vector<PendingDefinition> pending,
+                   size_t linked, bool removed) {
+    for (size_t i = 0; i < pending.size(); ++i) {
+        if (i < linked) {
+            pending[i].definition = std::move(definitions_.extract(pending[i].name).mapped());
+            RemoveCode(pending[i].definition);
+        }
+        if (pending[i].definition.aliasee.empty()) {
+            deduplicator_.Erase(pending[i].key);
+        }
+        // The new version of the redefined function itself is dropped.
+        if (i > 0) {
+            old[i].function = std::move(pending[i].definition.function);
+        }
+    }
+    for (auto& definition : old) {
+        const auto name = definition.function->GetName();
+        codegen_ctx_.function_protos[name] = definition.function->proto;
+        if (removed) {
+            if (!Define(std::move(definition.function), "Restored function: ")) {
+                LogError(std::format("Failed to restore {}", name));
+            }
+            continue;
+        }
+        // Stubs of the linked definitions point at their new code.
+        if (linked > 0 && !jit_->SetStub(name, definition.impl)) {
+            LogError(std::format("Failed to restore {}", name));
+        }
+        if (definition.aliasee.empty()) {
+            auto key = StructuralKey(*definition.function, codegen_ctx_.GetFpMode(name));
+            deduplicator_.Insert(std::move(key), name);
+        }
+        definitions_[name] = std::move(definition);
+    }
+}
+
+Repl::Definition Repl::ExtractDefinition(const std::string& name) {
+    auto definition = std::move(definitions_.extract(name).mapped());
+    if (definition.aliasee.empty()) {
+        deduplicator_.Erase(StructuralKey(*definition.function, codegen_ctx_.GetFpMode(name)));
+    }
+    return definition;
+}
+
+void Repl::RemoveCode(const Definition& definition) {
+    if (auto error = definition.tracker->remove()) {
+        LogError(llvm::toString(std::move(error)));
+    }
+}
+
+std::vector<std::string> Repl::FindDependents(const std::string& name, bool callers) const {
+    std::vector<std::string> dependents;
+    std::set<std::string> seen{name};
+    for (size_t i = 0; i <= dependents.size(); ++i) {
+        const auto& target = i == 0 ? name : dependents[i - 1];
+        for (const auto& [other, definition] : definitions_) {
+            if (!seen.contains(other) && (definition.aliasee == target ||
+                                          (callers && definition.callees.contains(target)))) {
+                seen.insert(other);
+                dependents.push_back(other);
+            }
+        }
+    }
+    return dependents;
+}
+
+std::string Repl::HandleExtern() {
     auto fn = parser_.ParseExtern();
     if (!fn) {
         parser_.GetTokenizer()->Next();
+        return {};
+    }
+    AddExtern(*fn);
+    return fn->name;
+}
+
+void Repl::AddExtern(const ast::Prototype& proto) {
+    if (!codegen_ctx_.CanDeclare(proto)) {
         return;
     }
-    auto fn_ir = Codegen(*fn, &codegen_ctx_);
+    auto fn_ir = Codegen(proto, &codegen_ctx_);
     if (!fn_ir) {
         return;
     }
+    codegen_ctx_.function_protos[proto.name] = proto;
     Out() << "Read extern: ";
     fn_ir->print(Out());
     Out() << '\n';
 }
 
-void Repl::HandleTopLevelExpression() {
+std::string Repl::HandleTopLevelExpression() {
     auto fn = parser_.ParseTopLevelExpr();
     if (!fn) {
         parser_.GetTokenizer()->Next();
-        return;
+        return {};
     }
-    auto fn_ir = Codegen(*fn, &codegen_ctx_);
+    Evaluate(*fn);
+    return fn->GetName();
+}
+
+void Repl::Evaluate(const ast::Function& fn) {
+    auto fn_ir = Codegen(fn, &codegen_ctx_);
     if (!fn_ir) {
         return;
     }
     Out() << "Read top-level expression: ";
     fn_ir->print(Out());
     Out() << '\n';
-    fn_ir->eraseFromParent();
+
+    // The anonymous expression's code is freed right after it is evaluated.
+    auto tracker = jit_->CreateResourceTracker();
+    if (!jit_->AddModule(codegen_ctx_.TakeModule(), tracker)) {
+        return;
+    }
+    if (auto* fn_ptr = reinterpret_cast<double (*)()>(jit_->Lookup(fn.GetName()))) {
+        Out() << "Evaluated to " << llvm::format("%f", fn_ptr()) << '\n';
+    }
+    if (auto error = tracker->remove()) {
+        LogError(llvm::toString(std::move(error)));
+    }
 }
 
 llvm::raw_ostream& Repl::Out() const {
-    return *out_;
+    return echo_ ? *out_ : llvm::nulls();
 }
@@ -1,24 +1,130 @@
 #pragma once
 
+#include <bundle/bundle.h>
+#include <bundle/prelude.h>
+#include <parser/ast_file.h>
 #include <parser/parser.h>
 #include <codegen/codegen_ctx.h>
+#include <codegen/dedup.h>
+#include <driver/item_driver.h>
+#include <jit/jit.h>
+#include <stats/report.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+struct ReplOptions {
+    CodegenOptions codegen;
+    // Records compile statistics of every item, see Repl::GetReport.
+    bool collect_stats = false;
+    // Calls to definitions go through stubs, so redefining a function swaps its code without
+    // recompiling its callers. See Repl::Devirtualize.
+    bool call_stubs = true;
+};
 
 class Repl {
 public:
-    Repl(std::istream* in, llvm::raw_ostream* out, std::map<std::string, uint8_t> binop_precedence);
+    Repl(std::istream* in, llvm::raw_ostream* out, std::map<std::string, uint8_t> binop_precedence,
+         std::unique_ptr<Jit> jit, ReplOptions options = {});
 
     void MainLoop();
 
+    // Handles an item parsed elsewhere, e.g. by an IncrementalParser, as MainLoop would.
+    void Handle(ast::Item item);
+
+    // Adds items parsed earlier, e.g. loaded from an AST file, without echoing them.
+    void Load(std::vector<ast::Item> items);
+
+    // Links the code of `bundle`, whose functions can then be called but not redefined.
+    bool LoadBundle(const Bundle& bundle);
+
+    // Links the already compiled code of `prelude`, which must outlive the Repl. Like with
+    // bundles, its functions can't be redefined.
+    bool LoadPrelude(const Prelude& prelude);
+
     static void Prompt(llvm::raw_ostream* out);
 
+    const stats::Report& GetReport() const;
+
+    // Recompiles every definition with direct calls and drops the stubs, for peak speed once
+    // the code is frozen. Later redefinitions recompile the callers instead.
+    void Devirtualize();
+
 private:
-    void HandleDefinition();
-    void HandleExtern();
-    void HandleTopLevelExpression();
+    // A function defined in the session. Each lives in its own module and resource tracker, so
+    // redefining it frees the old code and IR.
+    struct Definition {
+        std::unique_ptr<ast::Function> function;
+        // Functions called by `function`.
+        std::set<std::string> callees;
+        // Function this one is an alias of, empty if it has its own code.
+        std::string aliasee;
+        // Symbol of the code: the function's own name with direct calls, a versioned name behind
+        // the stub otherwise. Aliases share the code of `aliasee`.
+        std::string impl;
+        llvm::orc::ResourceTrackerSP tracker;
+    };
+
+    // Whether code compiled for `triple` and defining `interface` can be linked.
+    bool CanLink(std::string_view triple, const BundleInterface& interface) const;
+    void AddInterface(const BundleInterface& interface);
+
+    // Handlers return the name of the handled item, empty if it failed to parse.
+    std::string HandleDefinition();
+    std::string HandleExtern();
+    std::string HandleTopLevelExpression();
+    void AddFunction(std::unique_ptr<ast::Function> fn);
+    void AddExtern(const ast::Prototype& proto);
+    void Evaluate(const ast::Function& fn);
     llvm::raw_ostream& Out() const;
 
+    // A definition whose code is generated but not linked yet.
+    struct PendingDefinition {
+        std::string name;
+        Definition definition;
+        std::string key;
+        // Code of the definition, empty for aliases.
+        llvm::orc::ThreadSafeModule module;
+    };
+
+    bool Define(std::unique_ptr<ast::Function> fn, std::string_view header);
+    // Replaces a definition and recompiles its dependents, which refer to the old code. With
+    // stubs these are only its aliases. Nothing changes if any of them fails to compile.
+    void Redefine(std::unique_ptr<ast::Function> fn);
+    // Generates the code of `fn`, or finds a definition it is an alias of, and reserves its key.
+    // The caller moves `fn` into the result.
+    std::optional<PendingDefinition> Prepare(const ast::Function& fn, std::string_view header);
+    // Links the code of `pending` and adds it to the definitions. Its function is kept if that
+    // fails.
+    bool Link(PendingDefinition& pending);
+    // Brings back the definitions a failed redefinition extracted and drops its `pending` ones,
+    // the first `linked` of which were linked. The `old` code is compiled again if `removed`.
+    void Restore(std::vector<Definition> old, std::vector<PendingDefinition> pending,
+                 size_t linked, bool removed);
+    // Forgets `name`, its code stays until passed to RemoveCode.
+    Definition ExtractDefinition(const std::string& name);
+    void RemoveCode(const Definition& definition);
+    // Definitions aliasing `name` and, if `callers` is set, calling it, directly or transitively.
+    std::vector<std::string> FindDependents(const std::string& name, bool callers) const;
+
     Parser parser_;
+    ItemDriver driver_;
+    std::unique_ptr<Jit> jit_;
     CodegenCtx codegen_ctx_;
+    FunctionDeduplicator deduplicator_;
+    std::map<std::string, Definition> definitions_;
+    // Functions defined by loaded bundles.
+    std::set<std::string> bundled_;
+    // Numbers the versions of definitions behind stubs.
+    size_t next_impl_ = 0;
+    ReplOptions options_;
 
     llvm::raw_ostream* out_;
+    // Whether items are echoed to `out_`.
+    bool echo_ = true;
 };
@@ -0,0 +1,213 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <optional>
+
+namespace runtime {
+
+namespace {
+
+// The pool and queue of the worker running on this thread, if any.
+thread_local WorkStealingPool* current_pool = nullptr;
+thread_local size_t current_queue = 0;
+
+// Enough chunks to keep many cores busy when some take longer than others.
+constexpr size_t kMaxChunks = 4096;
+
+size_t GetIndexCount(double n) {
+    // Also stops at NaN, and at indices doubles can't count.
+    return n > 0 ? static_cast<size_t>(std::ceil(std::min(n, 0x1p53))) : 0;
+}
+
+// Splits the indices below `count` into chunks of about the same size and calls
+// `body(chunk, begin, end)` for each on the default pool.
+template <class Body>
+void ForEachChunk(size_t count, Body&& body) {
+    const size_t chunks = std::min(count, kMaxChunks);
+    const size_t size = chunks ? count / chunks : 0;
+    const size_t rest = chunks ? count % chunks : 0;
+    WorkStealingPool::Default().ParallelFor(chunks, [&](size_t chunk) {
+        // The first `rest` chunks take one more index.
+        size_t begin = chunk * size + std::min(chunk, rest);
+        body(chunk, begin, begin + size + (chunk < rest));
+    });
+}
+
+template <class Combine>
+double Reduce(IndexFunction f, double n, Combine&& combine, double identity) {
+    std::vector<double> partials(std::min(GetIndexCount(n), kMaxChunks), identity);
+    ForEachChunk(GetIndexCount(n), [&](size_t chunk, size_t begin, size_t end) {
+        double result = identity;
+        for (size_t i = begin; i < end; ++i) {
+            result = combine(result, f(static_cast<double>(i)));
+        }
+        partials[chunk] = result;
+    });
+    // In chunk order, so the result is the same every time.
+    double result = identity;
+    for (double partial : partials) {
+        result = combine(result, partial);
+    }
+    return result;
+}
+
+}  // namespace
+
+WorkStealingPool::WorkStealingPool(size_t threads) {
+    for (size_t i = 0; i <= threads; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back([this, i] { Work(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    has_tasks_.notify_all();
+    threads_.clear();
+}
+
+WorkStealingPool& WorkStealingPool::Default() {
+    static WorkStealingPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    return pool;
+}
+
+void WorkStealingPool::ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    Job job{.body = &body, .remaining = count};
+    RunRange({.job = &job, .begin = 0, .end = count});
+    // Other threads hold the rest of the chunks. Help with whatever is queued until they are
+    // done, the tasks of this job or not, and sleep while there is nothing to help with.
+    while (true) {
+        auto finished = finished_ranges_.load(std::memory_order_acquire);
+        if (job.remaining.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+        if (!RunOne()) {
+            finished_ranges_.wait(finished, std::memory_order_acquire);
+        }
+    }
+}
+
+void WorkStealingPool::Work(size_t index) {
+    current_pool = this;
+    current_queue = index;
+    while (true) {
+        if (RunOne()) {
+            continue;
+        }
+        std::unique_lock lock(mutex_);
+        ++idle_;
+        has_tasks_.wait(lock, [this] { return stopping_ || pending_ > 0; });
+        --idle_;
+        if (stopping_) {
+            return;
+        }
+    }
+}
+
+void WorkStealingPool::RunRange(Task task) {
+    size_t done = 0;
+    for (; task.begin < task.end; ++task.begin, ++done) {
+        // Hand the second half to an idle worker, which may split it again.
+        if (task.end - task.begin > 1 && idle_ > pending_) {
+            size_t middle = task.begin + (task.end - task.begin) / 2;
+            Push({.job = task.job, .begin = middle, .end = task.end});
+            task.end = middle;
+        }
+        (*task.job->body)(task.begin);
+    }
+    // The last use of the job, which the thread waiting for it may destroy right after.
+    task.job->remaining.fetch_sub(done, std::memory_order_release);
+    finished_ranges_.fetch_add(1, std::memory_order_release);
+    finished_ranges_.notify_all();
+}
+
+void WorkStealingPool::Push(Task task) {
+    auto& queue = GetOwnQueue();
+    {
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    ++pending_;
+    // A worker going to sleep checks `pending_` after counting itself idle, so either it sees
+    // the task or it is counted here.
+    if (idle_ > 0) {
+        std::lock_guard lock(mutex_);
+        has_tasks_.notify_one();
+    }
+}
+
+bool WorkStealingPool::RunOne() {
+    std::optional<Task> task;
+    auto& own = GetOwnQueue();
+    {
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+        }
+    }
+    // Steal the oldest task of another queue, which holds the largest range.
+    for (size_t i = 0; !task && i < queues_.size(); ++i) {
+        auto& queue = *queues_[i];
+        if (&queue == &own) {
+            continue;
+        }
+        std::lock_guard lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    --pending_;
+    RunRange(*task);
+    return true;
+}
+
+WorkStealingPool::Queue& WorkStealingPool::GetOwnQueue() {
+    return current_pool == this ? *queues_[current_queue] : *queues_.back();
+}
+
+double ParallelSum(IndexFunction f, double n) {
+    return Reduce(f, n, std::plus<double>(), 0.0);
+}
+
+double ParallelMap(IndexFunction f, double n, BinaryFunction out) {
+    ForEachChunk(GetIndexCount(n), [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            auto index = static_cast<double>(i);
+            out(index, f(index));
+        }
+    });
+    return 0;
+}
+
+double ParallelReduce(IndexFunction f, double n, BinaryFunction combine, double identity) {
+    return Reduce(f, n, combine, identity);
+}
+
+std::string GetSymbolName(std::string_view name) {
+    return std::format("runtime.{}", name);
+}
+
+std::map<std::string, void*> GetSymbols() {
+    return {
+        {GetSymbolName("parallel_sum"), reinterpret_cast<void*>(&ParallelSum)},
+        {GetSymbolName("parallel_map"), reinterpret_cast<void*>(&ParallelMap)},
+        {GetSymbolName("parallel_reduce"), reinterpret_cast<void*>(&ParallelReduce)},
+    };
+}
+
+}  // namespace runtime
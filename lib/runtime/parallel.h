@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace runtime {
+
+// Threads that each keep a deque of tasks: a thread pops the newest of its own, and when it
+// runs out steals the oldest of another's. Threads waiting for their tasks to finish run
+// other tasks meanwhile, so tasks can themselves run parallel loops.
+class WorkStealingPool {
+public:
+    // `threads` workers besides the threads calling ParallelFor, which may be none.
+    explicit WorkStealingPool(size_t threads);
+
+    // Joins the threads. No ParallelFor may be running.
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Shared by the builtins, with a worker per core but the one of the caller.
+    static WorkStealingPool& Default();
+
+    // Calls `body` for each of `count` chunks and returns once all are done. Ranges of chunks
+    // are split in halves only while there are idle workers to take them, so cheap chunks
+    // don't pay for a task each.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    size_t GetThreadCount() const {
+        return threads_.size();
+    }
+
+private:
+    struct Job {
+        const std::function<void(size_t)>* body;
+        std::atomic<size_t> remaining;
+    };
+
+    struct Task {
+        Job* job;
+        size_t begin;
+        size_t end;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void Work(size_t index);
+    void RunRange(Task task);
+    void Push(Task task);
+    // Runs one task, the current thread's own if it has any. False if there were none.
+    bool RunOne();
+    Queue& GetOwnQueue();
+
+    // One per worker, then one for the other threads.
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::atomic<size_t> pending_ = 0;
+    std::atomic<size_t> idle_ = 0;
+    // Ranges run so far, which threads with nothing to run wait on for their jobs to finish.
+    // Unlike the jobs, it outlives every range.
+    std::atomic<size_t> finished_ranges_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable has_tasks_;
+    bool stopping_ = false;
+    std::vector<std::jthread> threads_;
+};
+
+// Functions compiled from `def f(i)` and `def f(a b)`.
+using IndexFunction = double (*)(double);
+using BinaryFunction = double (*)(double, double);
+
+// The builtins compiled code calls. They run `f` on the indices below `n`: 0, 1, ... up to
+// `n` rounded up, split into chunks by count only, so results don't depend on the number of
+// cores. Functions run concurrently and must be safe to.
+
+// `parallel_sum(f, n)`: the sum of `f(i)`.
+double ParallelSum(IndexFunction f, double n);
+// `parallel_map(f, n, out)`: calls `out(i, f(i))`, in no particular order. Returns 0. Programs
+// have no arrays to map into, so results go to a callback instead of an output buffer, e.g. a
+// host function storing them.
+double ParallelMap(IndexFunction f, double n, BinaryFunction out);
+// `parallel_reduce(f, n, combine, identity)`: `f(i)` folded with `combine`, which must be
+// associative with `identity` as its identity since every chunk starts from it.
+double ParallelReduce(IndexFunction f, double n, BinaryFunction combine, double identity);
+
+// Symbol compiled code calls the builtin `name` by, e.g. "runtime.parallel_sum". The dot keeps
+// it apart from the functions of programs.
+std::string GetSymbolName(std::string_view name);
+// The address of every builtin by its symbol, which a JIT defines to link code calling them.
+std::map<std::string, void*> GetSymbols();
+
+}  // namespace runtime
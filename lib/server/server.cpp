@@ -0,0 +1,278 @@
+#include "server.h"
+
+#include <parser/incremental_parser.h>
+#include <util.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+std::nullptr_t LogSystemError(std::string_view what) {
+    return LogError(std::format("{}: {}", what, std::strerror(errno)));
+}
+
+std::optional<sockaddr_un> MakeAddress(const std::string& path) {
+    sockaddr_un address{.sun_family = AF_UNIX};
+    if (path.size() >= sizeof(address.sun_path)) {
+        LogError(std::format("Socket path {} is too long", path));
+        return std::nullopt;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// Writes all of `data`, false if the connection is gone.
+bool SendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        auto sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data.remove_prefix(sent);
+    }
+    return true;
+}
+
+}  // namespace
+
+struct Server::Session {
+    Session(int fd, std::map<std::string, uint8_t> binop_precedence)
+        : fd(fd), parser(std::move(binop_precedence)), out(output) {
+    }
+
+    ~Session() {
+        close(fd);
+    }
+
+    const int fd;
+    std::mutex mutex;
+    // Fed by the polling thread and drained by the worker evaluating the session.
+    IncrementalParser parser;
+    // Whether a worker has been asked to evaluate the session.
+    bool scheduled = false;
+
+    // Only used by the worker evaluating the session.
+    std::istringstream in;
+    std::string output;
+    llvm::raw_string_ostream out;
+    std::unique_ptr<Repl> repl;
+};
+
+std::unique_ptr<Server> Server::Create(const std::string& path,
+                                       std::map<std::string, uint8_t> binop_precedence,
+                                       const Prelude* prelude, ServerOptions options) {
+    auto address = MakeAddress(path);
+    if (!address) {
+        return nullptr;
+    }
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        return LogSystemError("Cannot create socket");
+    }
+    // Replaces the socket of a previous server, but nothing else that happens to be at `path`,
+    // on which bind then fails.
+    struct stat status;
+    if (lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+        unlink(path.c_str());
+    }
+    if (bind(listen_fd, reinterpret_cast<const sockaddr*>(&*address), sizeof(*address)) < 0 ||
+        listen(listen_fd, SOMAXCONN) < 0) {
+        LogSystemError(std::format("Cannot listen on {}", path));
+        close(listen_fd);
+        return nullptr;
+    }
+    int wakeup_fds[2];
+    if (pipe2(wakeup_fds, O_CLOEXEC) < 0) {
+        LogSystemError("Cannot create pipe");
+        close(listen_fd);
+        return nullptr;
+    }
+    return std::unique_ptr<Server>(new Server(path, listen_fd, wakeup_fds,
+                                              std::move(binop_precedence), prelude,
+                                              std::move(options)));
+}
+
+Server::Server(std::string path, int listen_fd, int wakeup_fds[2],
+               std::map<std::string, uint8_t> binop_precedence, const Prelude* prelude,
+               ServerOptions options)
+    : path_(std::move(path)),
+      listen_fd_(listen_fd),
+      wakeup_fds_{wakeup_fds[0], wakeup_fds[1]},
+      binop_precedence_(std::move(binop_precedence)),
+      prelude_(prelude),
+      options_(std::move(options)),
+      pool_(options_.worker_threads) {
+}
+
+Server::~Server() {
+    close(listen_fd_);
+    close(wakeup_fds_[0]);
+    close(wakeup_fds_[1]);
+    unlink(path_.c_str());
+}
+
+void Server::Run() {
+    std::vector<pollfd> fds;
+    while (true) {
+        fds.clear();
+        fds.push_back({.fd = wakeup_fds_[0], .events = POLLIN});
+        fds.push_back({.fd = listen_fd_, .events = POLLIN});
+        for (const auto& [fd, session] : sessions_) {
+            fds.push_back({.fd = fd, .events = POLLIN});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LogSystemError("poll failed");
+            break;
+        }
+        if (fds[0].revents) {
+            char byte;
+            [[maybe_unused]] auto unused = read(wakeup_fds_[0], &byte, 1);
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            Accept();
+        }
+        for (size_t i = 2; i < fds.size(); ++i) {
+            if (!fds[i].revents) {
+                continue;
+            }
+            auto it = sessions_.find(fds[i].fd);
+            auto session = it->second;
+            if (!Read(session.get())) {
+                // Nothing more to read; the session lives on while its items are evaluated.
+                sessions_.erase(it);
+            }
+            Schedule(session);
+        }
+    }
+    // Connections that are still open are dropped with their pending input.
+    sessions_.clear();
+}
+
+void Server::Stop() {
+    char byte = 0;
+    [[maybe_unused]] auto unused = write(wakeup_fds_[1], &byte, 1);
+}
+
+void Server::Accept() {
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+        LogSystemError("accept failed");
+        return;
+    }
+    sessions_[fd] = std::make_shared<Session>(fd, binop_precedence_);
+}
+
+bool Server::Read(Session* session) {
+    char buffer[4096];
+    auto size = read(session->fd, buffer, sizeof(buffer));
+    if (size < 0 && errno == EINTR) {
+        return true;
+    }
+    std::lock_guard lock(session->mutex);
+    if (size <= 0) {
+        session->parser.Close();
+        return false;
+    }
+    session->parser.Feed({buffer, static_cast<size_t>(size)});
+    return true;
+}
+
+void Server::Schedule(const std::shared_ptr<Session>& session) {
+    {
+        std::lock_guard lock(session->mutex);
+        if (session->scheduled) {
+            return;
+        }
+        session->scheduled = true;
+    }
+    pool_.Submit([this, session] { Evaluate(session.get()); });
+}
+
+void Server::Evaluate(Session* session) {
+    // Errors go to the client that caused them, in order with the rest of its output.
+    ScopedErrorSink sink(
+        [session](std::string_view error) { session->out << "Error: " << error << '\n'; });
+    if (!session->repl) {
+        auto jit = Jit::Create(options_.optimizer, options_.perf);
+        if (jit) {
+            session->repl = std::make_unique<Repl>(&session->in, &session->out,
+                                                   binop_precedence_, std::move(jit),
+                                                   options_.repl);
+        }
+        if (!session->repl || (prelude_ && !session->repl->LoadPrelude(*prelude_))) {
+            session->out.flush();
+            SendAll(session->fd, session->output);
+            // Stays scheduled, so the session is never evaluated again.
+            shutdown(session->fd, SHUT_RDWR);
+            return;
+        }
+    }
+    while (true) {
+        std::optional<ast::Item> item;
+        {
+            std::lock_guard lock(session->mutex);
+            item = session->parser.Next();
+            if (!item) {
+                session->scheduled = false;
+                return;
+            }
+        }
+        session->repl->Handle(std::move(*item));
+        session->out.flush();
+        SendAll(session->fd, session->output);
+        session->output.clear();
+    }
+}
+
+std::optional<std::string> RunClient(const std::string& path, std::string_view input) {
+    auto address = MakeAddress(path);
+    if (!address) {
+        return std::nullopt;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LogSystemError("Cannot create socket");
+        return std::nullopt;
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&*address), sizeof(*address)) < 0) {
+        LogSystemError(std::format("Cannot connect to {}", path));
+        close(fd);
+        return std::nullopt;
+    }
+    // The server reads input while it sends output, so sending everything first is fine.
+    SendAll(fd, input);
+    shutdown(fd, SHUT_WR);
+    std::string output;
+    char buffer[4096];
+    while (true) {
+        auto size = read(fd, buffer, sizeof(buffer));
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            break;
+        }
+        output.append(buffer, size);
+    }
+    close(fd);
+    return output;
+}
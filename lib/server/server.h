@@ -0,0 +1,79 @@
+#pragma once
+
+#include "thread_pool.h"
+
+#include <bundle/prelude.h>
+#include <repl/repl.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+struct ServerOptions {
+    ReplOptions repl;
+    OptimizerOptions optimizer;
+    // Threads evaluating the items of all sessions.
+    size_t worker_threads = std::thread::hardware_concurrency();
+    PerfOptions perf;
+};
+
+// Serves Repl sessions over a Unix domain socket, one per connection. Each session has its own
+// definitions on top of a shared prelude. One thread polls every connection and parses input
+// as it arrives, and a pool of workers evaluates the items, one session at a time per worker
+// so a session's items run in order. A session ends once its client shuts down writing and
+// every item has been evaluated; its output, errors included, is sent as it is produced.
+class Server {
+public:
+    // Listens at `path`, replacing a socket left there but no other kind of file. `prelude` may
+    // be null and must outlive the server otherwise. Returns null and logs an error if the
+    // socket can't be set up.
+    static std::unique_ptr<Server> Create(const std::string& path,
+                                          std::map<std::string, uint8_t> binop_precedence,
+                                          const Prelude* prelude, ServerOptions options = {});
+
+    // Waits for the evaluations in progress.
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    // Serves connections until Stop is called, then drops the ones still open.
+    void Run();
+
+    // Makes Run return. May be called from any thread.
+    void Stop();
+
+private:
+    struct Session;
+
+    Server(std::string path, int listen_fd, int wakeup_fds[2],
+           std::map<std::string, uint8_t> binop_precedence, const Prelude* prelude,
+           ServerOptions options);
+
+    void Accept();
+    // Feeds the input available on the session's connection, false once it is closed.
+    bool Read(Session* session);
+    void Schedule(const std::shared_ptr<Session>& session);
+    // Evaluates the parsed items of the session, on a worker.
+    void Evaluate(Session* session);
+
+    std::string path_;
+    int listen_fd_;
+    // Stop writes to the second one to wake Run up.
+    int wakeup_fds_[2];
+    std::map<std::string, uint8_t> binop_precedence_;
+    const Prelude* prelude_;
+    ServerOptions options_;
+    // Sessions whose connections are still read, by socket.
+    std::map<int, std::shared_ptr<Session>> sessions_;
+    // Last, so evaluations finish before anything they use goes away.
+    ThreadPool pool_;
+};
+
+// Sends `input` to the server at `path` as one session and returns its output, or nothing if
+// it can't connect. Stands in for a real client.
+std::optional<std::string> RunClient(const std::string& path, std::string_view input);
@@ -0,0 +1,69 @@
+#include "memory.h"
+
+#include <stats/stats.h>
+
+#include <array>
+#include <atomic>
+
+namespace stats {
+
+namespace {
+
+struct PoolCounters {
+    std::atomic<int64_t> live{0};
+    std::atomic<int64_t> peak{0};
+};
+
+std::array<PoolCounters, static_cast<size_t>(MemoryPool::kCount)> pools;
+std::atomic<int64_t> total_live{0};
+
+void UpdatePeak(std::atomic<int64_t>* peak, int64_t value) {
+    auto current = peak->load(std::memory_order_relaxed);
+    while (current < value && !peak->compare_exchange_weak(current, value)) {
+    }
+}
+
+}  // namespace
+
+std::string_view GetName(MemoryPool pool) {
+    switch (pool) {
+#define MEMORY_POOL_NAME(name, str) \
+    case MemoryPool::k##name:       \
+        return str;
+        FORALL_MEMORY_POOLS(MEMORY_POOL_NAME)
+#undef MEMORY_POOL_NAME
+        case MemoryPool::kCount:
+            break;
+    }
+    return "unknown";
+}
+
+void TrackAllocation(MemoryPool pool, size_t bytes) {
+    auto& counters = pools[static_cast<size_t>(pool)];
+    UpdatePeak(&counters.peak, counters.live.fetch_add(bytes) + bytes);
+    NoteMemoryUsage(total_live.fetch_add(bytes) + bytes);
+}
+
+void TrackDeallocation(MemoryPool pool, size_t bytes) {
+    pools[static_cast<size_t>(pool)].live.fetch_sub(bytes);
+    total_live.fetch_sub(bytes);
+}
+
+MemoryUsage GetMemoryUsage(MemoryPool pool) {
+    const auto& counters = pools[static_cast<size_t>(pool)];
+    return {.live = counters.live.load(), .peak = counters.peak.load()};
+}
+
+MemorySnapshot GetMemorySnapshot() {
+    MemorySnapshot snapshot;
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+        snapshot[i] = GetMemoryUsage(static_cast<MemoryPool>(i));
+    }
+    return snapshot;
+}
+
+int64_t GetLiveMemory() {
+    return total_live.load();
+}
+
+}  // namespace stats
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string_view>
+
+#define FORALL_MEMORY_POOLS(op) \
+    op(Ast, "ast")              \
+    op(Ir, "ir")                \
+    op(JitCode, "jit_code")     \
+    op(JitData, "jit_data")
+
+namespace stats {
+
+enum class MemoryPool {
+#define MEMORY_POOL_VARIANT(name, str) k##name,
+    FORALL_MEMORY_POOLS(MEMORY_POOL_VARIANT)
+#undef MEMORY_POOL_VARIANT
+    kCount,
+};
+
+std::string_view GetName(MemoryPool pool);
+
+struct MemoryUsage {
+    int64_t live = 0;
+    int64_t peak = 0;
+};
+
+// Process-wide accounting, safe to call from any thread.
+void TrackAllocation(MemoryPool pool, size_t bytes);
+void TrackDeallocation(MemoryPool pool, size_t bytes);
+
+MemoryUsage GetMemoryUsage(MemoryPool pool);
+
+using MemorySnapshot = std::array<MemoryUsage, static_cast<size_t>(MemoryPool::kCount)>;
+
+MemorySnapshot GetMemorySnapshot();
+
+// Live bytes over all pools.
+int64_t GetLiveMemory();
+
+// Allocator accounting everything it hands out to `Pool`.
+template <class T, MemoryPool Pool>
+struct TrackingAllocator {
+    using value_type = T;
+
+    TrackingAllocator() = default;
+
+    template <class U>
+    TrackingAllocator(const TrackingAllocator<U, Pool>&) {
+    }
+
+    T* allocate(size_t n) {
+        TrackAllocation(Pool, n * sizeof(T));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        TrackDeallocation(Pool, n * sizeof(T));
+        ::operator delete(p);
+    }
+
+    template <class U>
+    struct rebind {
+        using other = TrackingAllocator<U, Pool>;
+    };
+
+    template <class U>
+    bool operator==(const TrackingAllocator<U, Pool>&) const {
+        return true;
+    }
+};
+
+}  // namespace stats
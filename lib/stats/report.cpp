@@ -0,0 +1,106 @@
+#include "report.h"
+
+#include <llvm/Support/Format.h>
+#include <llvm/Support/JSON.h>
+
+namespace stats {
+
+namespace {
+
+double Microseconds(std::chrono::nanoseconds time) {
+    return std::chrono::duration<double, std::micro>(time).count();
+}
+
+double Kibibytes(int64_t bytes) {
+    return bytes / 1024.0;
+}
+
+void WriteStats(const Stats& stats, llvm::json::OStream& json) {
+    json.attributeObject("time_ns", [&] {
+        for (size_t i = 0; i < stats.time.size(); ++i) {
+            json.attribute(GetName(static_cast<Phase>(i)),
+                           static_cast<int64_t>(stats.time[i].count()));
+        }
+    });
+    json.attributeObject("peak_memory", [&] {
+        for (size_t i = 0; i < stats.peak_memory.size(); ++i) {
+            json.attribute(GetName(static_cast<Phase>(i)), stats.peak_memory[i]);
+        }
+    });
+    for (size_t i = 0; i < stats.counters.size(); ++i) {
+        json.attribute(GetName(static_cast<Counter>(i)),
+                       static_cast<int64_t>(stats.counters[i]));
+    }
+}
+
+void WriteMemory(const MemorySnapshot& memory, llvm::json::OStream& json) {
+    json.attributeObject("memory", [&] {
+        for (size_t i = 0; i < memory.size(); ++i) {
+            json.attributeObject(GetName(static_cast<MemoryPool>(i)), [&] {
+                json.attribute("live", memory[i].live);
+                json.attribute("peak", memory[i].peak);
+            });
+        }
+    });
+}
+
+}  // namespace
+
+void Report::AddItem(ItemReport item) {
+    total += item.stats;
+    items.push_back(std::move(item));
+}
+
+void PrintText(const Report& report, llvm::raw_ostream& out) {
+    const auto& total = report.total;
+    std::chrono::nanoseconds compile_time{0};
+    for (auto time : total.time) {
+        compile_time += time;
+    }
+
+    out << "===== Kaleidoscope statistics (" << report.items.size() << " items) =====\n";
+    for (size_t i = 0; i < total.time.size(); ++i) {
+        auto time = total.time[i];
+        auto share = compile_time.count() ? 100.0 * time.count() / compile_time.count() : 0.0;
+        out << llvm::format("%12.3f ms %5.1f%% %10.1f KiB peak  ", Microseconds(time) / 1000,
+                            share, Kibibytes(total.peak_memory[i]))
+            << GetName(static_cast<Phase>(i)) << '\n';
+    }
+    out << llvm::format("%12.3f ms         ", Microseconds(compile_time) / 1000) << "total\n";
+    out << llvm::format("%12.3f ms         ", Microseconds(report.wall_time) / 1000) << "wall\n";
+    for (size_t i = 0; i < total.counters.size(); ++i) {
+        out << llvm::format("%15llu  ", static_cast<unsigned long long>(total.counters[i]))
+            << GetName(static_cast<Counter>(i)) << '\n';
+    }
+    for (size_t i = 0; i < report.memory.size(); ++i) {
+        const auto& usage = report.memory[i];
+        out << llvm::format("%12.1f KiB live %10.1f KiB peak  ", Kibibytes(usage.live),
+                            Kibibytes(usage.peak))
+            << GetName(static_cast<MemoryPool>(i)) << '\n';
+    }
+}
+
+void PrintJson(const Report& report, llvm::raw_ostream& out) {
+    llvm::json::OStream json(out, 2);
+    json.object([&] {
+        json.attributeArray("items", [&] {
+            for (const auto& item : report.items) {
+                json.object([&] {
+                    json.attribute("kind", item.kind);
+                    json.attribute("name", item.name);
+                    WriteStats(item.stats, json);
+                    WriteMemory(item.memory, json);
+                });
+            }
+        });
+        json.attributeObject("total", [&] {
+            json.attribute("items", static_cast<int64_t>(report.items.size()));
+            json.attribute("wall_time_ns", static_cast<int64_t>(report.wall_time.count()));
+            WriteStats(report.total, json);
+            WriteMemory(report.memory, json);
+        });
+    });
+    out << '\n';
+}
+
+}  // namespace stats
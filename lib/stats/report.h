@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stats/memory.h>
+#include <stats/stats.h>
+
+#include <llvm/Support/raw_ostream.h>
+
+#include <string>
+#include <vector>
+
+namespace stats {
+
+struct ItemReport {
+    // "definition", "extern" or "expression", or "stage" for the stages of a Pipeline.
+    std::string kind;
+    std::string name;
+    Stats stats;
+    // Tracked memory right after the item was handled.
+    MemorySnapshot memory{};
+};
+
+struct Report {
+    std::vector<ItemReport> items;
+    Stats total;
+    std::chrono::nanoseconds wall_time{0};
+    // Tracked memory at the end of the run.
+    MemorySnapshot memory{};
+
+    void AddItem(ItemReport item);
+};
+
+// Totals of the run as a table.
+void PrintText(const Report& report, llvm::raw_ostream& out);
+
+// Per-item and total stats as a JSON object, times in nanoseconds and memory in bytes.
+void PrintJson(const Report& report, llvm::raw_ostream& out);
+
+}  // namespace stats
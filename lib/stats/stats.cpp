@@ -0,0 +1,103 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace stats {
+
+namespace {
+
+thread_local Stats* current_stats = nullptr;
+thread_local ScopedTimer* current_timer = nullptr;
+
+}  // namespace
+
+std::string_view GetName(Phase phase) {
+    switch (phase) {
+#define PHASE_NAME(name, str) \
+    case Phase::k##name:      \
+        return str;
+        FORALL_PHASES(PHASE_NAME)
+#undef PHASE_NAME
+        case Phase::kCount:
+            break;
+    }
+    return "unknown";
+}
+
+std::string_view GetName(Counter counter) {
+    switch (counter) {
+#define COUNTER_NAME(name, str) \
+    case Counter::k##name:      \
+        return str;
+        FORALL_COUNTERS(COUNTER_NAME)
+#undef COUNTER_NAME
+        case Counter::kCount:
+            break;
+    }
+    return "unknown";
+}
+
+Stats& Stats::operator+=(const Stats& other) {
+    for (size_t i = 0; i < time.size(); ++i) {
+        time[i] += other.time[i];
+    }
+    for (size_t i = 0; i < counters.size(); ++i) {
+        counters[i] += other.counters[i];
+    }
+    for (size_t i = 0; i < peak_memory.size(); ++i) {
+        peak_memory[i] = std::max(peak_memory[i], other.peak_memory[i]);
+    }
+    return *this;
+}
+
+ScopedCollector::ScopedCollector(Stats* stats) : previous_(current_stats) {
+    current_stats = stats;
+}
+
+ScopedCollector::~ScopedCollector() {
+    current_stats = previous_;
+}
+
+ScopedTimer::ScopedTimer(Phase phase) : stats_(current_stats), phase_(phase) {
+    if (!stats_) {
+        return;
+    }
+    parent_ = std::exchange(current_timer, this);
+    start_ = std::chrono::steady_clock::now();
+}
+
+ScopedTimer::~ScopedTimer() {
+    if (!stats_) {
+        return;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    (*stats_)[phase_] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed) - nested_;
+    if (parent_) {
+        parent_->nested_ += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+    }
+    current_timer = parent_;
+}
+
+Phase ScopedTimer::GetPhase() const {
+    return phase_;
+}
+
+void Add(Counter counter, uint64_t value) {
+    if (current_stats) {
+        (*current_stats)[counter] += value;
+    }
+}
+
+bool IsCollecting() {
+    return current_stats;
+}
+
+void NoteMemoryUsage(int64_t live_bytes) {
+    if (current_stats && current_timer) {
+        auto& peak = current_stats->peak_memory[static_cast<size_t>(current_timer->GetPhase())];
+        peak = std::max(peak, live_bytes);
+    }
+}
+
+}  // namespace stats
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+#define FORALL_PHASES(op)    \
+    op(Tokenize, "tokenize") \
+    op(Parse, "parse")       \
+    op(Codegen, "codegen")   \
+    op(Verify, "verify")     \
+    op(Optimize, "optimize") \
+    op(Emit, "emit")         \
+    op(Link, "link")
+
+#define FORALL_COUNTERS(op)               \
+    op(Tokens, "tokens")                  \
+    op(AstNodes, "ast_nodes")             \
+    op(IrInstructions, "ir_instructions") \
+    op(MachineCodeBytes, "machine_code_bytes")
+
+namespace stats {
+
+enum class Phase {
+#define PHASE_VARIANT(name, str) k##name,
+    FORALL_PHASES(PHASE_VARIANT)
+#undef PHASE_VARIANT
+    kCount,
+};
+
+enum class Counter {
+#define COUNTER_VARIANT(name, str) k##name,
+    FORALL_COUNTERS(COUNTER_VARIANT)
+#undef COUNTER_VARIANT
+    kCount,
+};
+
+std::string_view GetName(Phase phase);
+std::string_view GetName(Counter counter);
+
+struct Stats {
+    // Time spent in each phase, excluding nested phases.
+    std::array<std::chrono::nanoseconds, static_cast<size_t>(Phase::kCount)> time{};
+    std::array<uint64_t, static_cast<size_t>(Counter::kCount)> counters{};
+    // High-water mark of tracked memory, see stats/memory.h, while in each phase.
+    std::array<int64_t, static_cast<size_t>(Phase::kCount)> peak_memory{};
+
+    std::chrono::nanoseconds& operator[](Phase phase) {
+        return time[static_cast<size_t>(phase)];
+    }
+    uint64_t& operator[](Counter counter) {
+        return counters[static_cast<size_t>(counter)];
+    }
+
+    Stats& operator+=(const Stats& other);
+};
+
+// Everything recorded on this thread goes to `stats` while the collector is alive. Without an
+// active collector timers and counters cost a thread-local load.
+class ScopedCollector {
+public:
+    explicit ScopedCollector(Stats* stats);
+    ~ScopedCollector();
+
+    ScopedCollector(const ScopedCollector&) = delete;
+    ScopedCollector& operator=(const ScopedCollector&) = delete;
+
+private:
+    Stats* previous_;
+};
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Phase phase);
+    ~ScopedTimer();
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    Phase GetPhase() const;
+
+private:
+    Stats* stats_;
+    Phase phase_;
+    ScopedTimer* parent_ = nullptr;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::nanoseconds nested_{0};
+};
+
+void Add(Counter counter, uint64_t value = 1);
+
+// Whether a collector is active on this thread, to skip computing expensive counters.
+bool IsCollecting();
+
+// Raises the peak memory of the current phase to `live_bytes`.
+void NoteMemoryUsage(int64_t live_bytes);
+
+}  // namespace stats
@@ -2,7 +2,26 @@
 
 #include <iostream>
 
+namespace {
+
+thread_local ScopedErrorSink* current_sink = nullptr;
+
+}  // namespace
+
 std::nullptr_t LogError(std::string_view msg) {
-    std::cerr << "Error: " << msg << std::endl;
+    if (current_sink) {
+        current_sink->sink_(msg);
+    } else {
+        std::cerr << "Error: " << msg << std::endl;
+    }
     return nullptr;
 }
+
+ScopedErrorSink::ScopedErrorSink(std::function<void(std::string_view)> sink)
+    : sink_(std::move(sink)), previous_(current_sink) {
+    current_sink = this;
+}
+
+ScopedErrorSink::~ScopedErrorSink() {
+    current_sink = previous_;
+}
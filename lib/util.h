@@ -1,8 +1,26 @@
 #pragma once
 
 #include <cstddef>
+#include <functional>
 #include <string_view>
 
 #define JUST(...) __VA_ARGS__
 
 std::nullptr_t LogError(std::string_view);
+
+// Sends what LogError reports on this thread to `sink` instead of stderr while alive, e.g. to
+// the client of a server session.
+class ScopedErrorSink {
+public:
+    explicit ScopedErrorSink(std::function<void(std::string_view)> sink);
+    ~ScopedErrorSink();
+
+    ScopedErrorSink(const ScopedErrorSink&) = delete;
+    ScopedErrorSink& operator=(const ScopedErrorSink&) = delete;
+
+private:
+    friend std::nullptr_t LogError(std::string_view);
+
+    std::function<void(std::string_view)> sink_;
+    ScopedErrorSink* previous_;
+};
@@ -0,0 +1,144 @@
+#include "baseline.h"
+
+#include <util.h>
+
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <format>
+
+namespace perf {
+
+namespace {
+
+constexpr double kDefaultTolerance = 0.2;
+
+double GetTolerance() {
+    const char* tolerance = std::getenv("KALEIDOSCOPE_PERF_TOLERANCE");
+    return tolerance ? std::strtod(tolerance, nullptr) : kDefaultTolerance;
+}
+
+bool ShouldUpdate() {
+    const char* update = std::getenv("KALEIDOSCOPE_PERF_UPDATE");
+    return update && *update && std::string_view(update) != "0";
+}
+
+}  // namespace
+
+std::optional<Baseline> Baseline::Load() {
+    const char* directory = std::getenv("KALEIDOSCOPE_PERF_BASELINES");
+    if (!directory) {
+        LogError("KALEIDOSCOPE_PERF_BASELINES isn't set, run the tests with ctest");
+        return std::nullopt;
+    }
+    // Host names say nothing about the hardware, and would silently skip every metric of a
+    // machine without baselines.
+    const char* machine = std::getenv("KALEIDOSCOPE_PERF_MACHINE");
+    if (!machine || !*machine) {
+        LogError(
+            "KALEIDOSCOPE_PERF_MACHINE isn't set, name the machine whose baselines to compare "
+            "with, e.g. KALEIDOSCOPE_PERF_MACHINE=reference ctest -L perf");
+        return std::nullopt;
+    }
+    llvm::SmallString<256> path(directory);
+    llvm::sys::path::append(path, std::string(machine) + ".json");
+    Baseline baseline(path.str().str());
+    if (!llvm::sys::fs::exists(path)) {
+        return baseline;
+    }
+
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        LogError(std::format("Cannot open {}: {}", baseline.path_,
+                             buffer.getError().message()));
+        return std::nullopt;
+    }
+    auto json = llvm::json::parse((*buffer)->getBuffer());
+    if (!json) {
+        LogError(std::format("Cannot parse {}: {}", baseline.path_,
+                             llvm::toString(json.takeError())));
+        return std::nullopt;
+    }
+    const auto* metrics = json->getAsObject();
+    if (!metrics) {
+        LogError(std::format("{} isn't an object of metrics", baseline.path_));
+        return std::nullopt;
+    }
+    for (const auto& [name, value] : *metrics) {
+        auto number = value.getAsNumber();
+        if (!number) {
+            LogError(std::format("Metric {} of {} isn't a number", name.str(), baseline.path_));
+            return std::nullopt;
+        }
+        baseline.metrics_[name.str()] = *number;
+    }
+    return baseline;
+}
+
+std::optional<double> Baseline::Get(const std::string& metric) const {
+    auto it = metrics_.find(metric);
+    if (it == metrics_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void Baseline::Set(const std::string& metric, double value) {
+    metrics_[metric] = value;
+}
+
+bool Baseline::Save() const {
+    if (auto error = llvm::sys::fs::create_directories(llvm::sys::path::parent_path(path_))) {
+        LogError(std::format("Cannot create the directory of {}: {}", path_, error.message()));
+        return false;
+    }
+    std::error_code error;
+    llvm::raw_fd_ostream out(path_, error);
+    if (error) {
+        LogError(std::format("Cannot write {}: {}", path_, error.message()));
+        return false;
+    }
+    // Sorted and one per line, so that changes to baselines diff well.
+    llvm::json::OStream json(out, 2);
+    json.object([&] {
+        for (const auto& [name, value] : metrics_) {
+            json.attribute(name, value);
+        }
+    });
+    out << '\n';
+    return true;
+}
+
+void CheckBaseline(const std::string& metric, double value, Direction direction) {
+    auto baseline = Baseline::Load();
+    ASSERT_TRUE(baseline);
+    if (ShouldUpdate()) {
+        baseline->Set(metric, value);
+        ASSERT_TRUE(baseline->Save());
+        GTEST_SKIP() << std::format("Recorded {} = {} in {}", metric, value, baseline->GetPath());
+    }
+    auto recorded = baseline->Get(metric);
+    if (!recorded) {
+        GTEST_SKIP() << std::format(
+            "{} = {} has no baseline in {}. Rerun with KALEIDOSCOPE_PERF_UPDATE=1 to record it.",
+            metric, value, baseline->GetPath());
+    }
+
+    const double tolerance = GetTolerance();
+    const double limit = direction == Direction::kHigherIsBetter ? *recorded * (1 - tolerance)
+                                                                 : *recorded * (1 + tolerance);
+    const bool regressed = direction == Direction::kHigherIsBetter ? value < limit : value > limit;
+    EXPECT_FALSE(regressed) << std::format(
+        "{} regressed to {} from the baseline {} of {}, past the tolerance of {:.0f}%. Rerun with "
+        "KALEIDOSCOPE_PERF_UPDATE=1 to record the new value if the change is expected.",
+        metric, value, *recorded, baseline->GetPath(), tolerance * 100);
+    testing::Test::RecordProperty(metric, std::format("{}", value));
+}
+
+}  // namespace perf
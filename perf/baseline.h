@@ -0,0 +1,48 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+
+namespace perf {
+
+// Measurements recorded on one machine, by metric name, e.g. `parse/wide_calls`. Timings are
+// only comparable on the machine that took them, so each has its own file
+// `<machine>.json` in the directory in KALEIDOSCOPE_PERF_BASELINES. The machine is
+// KALEIDOSCOPE_PERF_MACHINE, which must be set.
+class Baseline {
+public:
+    // The baseline of this machine, empty if none was recorded. Nothing and logs an error if the
+    // file can't be read, or KALEIDOSCOPE_PERF_BASELINES or KALEIDOSCOPE_PERF_MACHINE isn't set.
+    static std::optional<Baseline> Load();
+
+    std::optional<double> Get(const std::string& metric) const;
+    void Set(const std::string& metric, double value);
+
+    // Writes the file back, creating the directory if needed. Logs an error if it can't.
+    bool Save() const;
+
+    const std::string& GetPath() const {
+        return path_;
+    }
+
+private:
+    explicit Baseline(std::string path) : path_(std::move(path)) {
+    }
+
+    std::string path_;
+    std::map<std::string, double> metrics_;
+};
+
+enum class Direction {
+    kHigherIsBetter,
+    kLowerIsBetter,
+};
+
+// Fails the current test if `value` of `metric` is worse than its baseline by more than the
+// fraction in KALEIDOSCOPE_PERF_TOLERANCE, 0.2 by default. Skips the test if there is no
+// baseline of the metric. Only with KALEIDOSCOPE_PERF_UPDATE set, records `value` instead and
+// skips the test, so that plain runs never write to the baselines in the source tree.
+void CheckBaseline(const std::string& metric, double value, Direction direction);
+
+}  // namespace perf
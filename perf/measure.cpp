@@ -0,0 +1,104 @@
+#include "measure.h"
+
+#include <codegen/codegen_ctx.h>
+#include <engine/engine.h>
+#include <parser/token.h>
+#include <parser/tokenizer.h>
+#include <stats/memory.h>
+#include <stats/stats.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+namespace perf {
+
+namespace {
+
+constexpr int kSamples = 5;
+constexpr auto kMinSampleTime = std::chrono::milliseconds(20);
+
+bool Tokenize(const corpus::Program& program) {
+    std::istringstream in(program.source);
+    Tokenizer tokenizer(&in);
+    while (GetTokenKind(tokenizer.Get()) != token::TokenKind::kEof) {
+        tokenizer.Next();
+    }
+    return true;
+}
+
+std::optional<double> TimeRuns(const std::function<bool()>& run) {
+    double best = std::numeric_limits<double>::infinity();
+    for (int sample = 0; sample < kSamples; ++sample) {
+        size_t runs = 0;
+        const auto start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::duration elapsed;
+        do {
+            if (!run()) {
+                return std::nullopt;
+            }
+            ++runs;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed < kMinSampleTime);
+        best = std::min(best, std::chrono::duration<double>(elapsed).count() / runs);
+    }
+    return best;
+}
+
+}  // namespace
+
+std::string_view StageName(Stage stage) {
+    switch (stage) {
+        case Stage::kTokenize:
+            return "tokenize";
+        case Stage::kParse:
+            return "parse";
+        case Stage::kCodegen:
+            return "codegen";
+    }
+    return "";
+}
+
+std::optional<double> TimeStage(Stage stage, const corpus::Program& program) {
+    switch (stage) {
+        case Stage::kTokenize:
+            return TimeRuns([&] { return Tokenize(program); });
+        case Stage::kParse:
+            return TimeRuns([&] { return !corpus::Parse(program).empty(); });
+        case Stage::kCodegen: {
+            auto functions = corpus::Parse(program);
+            if (functions.empty()) {
+                return std::nullopt;
+            }
+            // Includes freeing the module, which grows with it as much.
+            return TimeRuns([&] {
+                CodegenCtx ctx("perf");
+                return corpus::CodegenAll(functions, &ctx);
+            });
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<int64_t> MeasurePeakMemory(const corpus::Program& program) {
+    auto engine = Engine::Create();
+    if (!engine) {
+        return std::nullopt;
+    }
+    const int64_t live = stats::GetLiveMemory();
+    stats::Stats stats;
+    {
+        stats::ScopedCollector collector(&stats);
+        if (!engine->Compile(program.source)) {
+            return std::nullopt;
+        }
+    }
+    return std::max(*std::ranges::max_element(stats.peak_memory) - live, int64_t{0});
+}
+
+}  // namespace perf
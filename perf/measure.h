@@ -0,0 +1,32 @@
+#pragma once
+
+#include <corpus/corpus.h>
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace perf {
+
+// Stages of the compiler whose throughput is gated.
+enum class Stage {
+    kTokenize,
+    kParse,
+    kCodegen,
+};
+
+inline constexpr Stage kStages[] = {Stage::kTokenize, Stage::kParse, Stage::kCodegen};
+
+// `tokenize`, `parse` or `codegen`.
+std::string_view StageName(Stage stage);
+
+// Seconds one run of `stage` takes on `program`. Runs are repeated to fill samples of a few
+// milliseconds, and the fastest sample counts, as noise only ever makes runs slower. Nothing
+// if the program doesn't parse or compile.
+std::optional<double> TimeStage(Stage stage, const corpus::Program& program);
+
+// Tracked bytes live at most at once while a new engine compiles `program`, over what was live
+// before, see stats/memory.h. Nothing if the program doesn't compile.
+std::optional<int64_t> MeasurePeakMemory(const corpus::Program& program);
+
+}  // namespace perf
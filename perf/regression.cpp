@@ -0,0 +1,86 @@
+#include "baseline.h"
+#include "measure.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <format>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// Definitions of the standard corpora that baselines are measured on.
+constexpr size_t kDefinitions = 500;
+
+// Definitions of the smallest input of the scaling tests, which also time 4 and 16 times as
+// many.
+constexpr size_t kScalingDefinitions = 32;
+constexpr size_t kScalingFactors[] = {1, 4, 16};
+
+// Time may grow at most with the size of the input to this power. Linear stages stay below 1,
+// as fixed costs weigh less on larger inputs, while quadratic ones get close to 2.
+constexpr double kMaxScalingExponent = 1.3;
+
+using StageShape = std::tuple<perf::Stage, corpus::Shape>;
+
+class StageTest : public testing::TestWithParam<StageShape> {};
+
+class ShapeTest : public testing::TestWithParam<corpus::Shape> {};
+
+std::string StageShapeName(const testing::TestParamInfo<StageShape>& info) {
+    auto [stage, shape] = info.param;
+    return std::format("{}_{}", perf::StageName(stage), corpus::ShapeName(shape));
+}
+
+std::string ShapeName(const testing::TestParamInfo<corpus::Shape>& info) {
+    return std::string(corpus::ShapeName(info.param));
+}
+
+TEST_P(StageTest, Throughput) {
+    auto [stage, shape] = GetParam();
+    auto program = corpus::Generate(shape, kDefinitions);
+    auto seconds = perf::TimeStage(stage, program);
+    ASSERT_TRUE(seconds) << "The corpus doesn't compile";
+    perf::CheckBaseline(
+        std::format("{}/{}/mb_per_s", perf::StageName(stage), corpus::ShapeName(shape)),
+        program.source.size() / *seconds / 1e6, perf::Direction::kHigherIsBetter);
+}
+
+// Needs no baseline, as it compares the stage with itself on inputs of different sizes.
+TEST_P(StageTest, Scaling) {
+    auto [stage, shape] = GetParam();
+    std::vector<size_t> sizes;
+    std::vector<double> times;
+    for (auto factor : kScalingFactors) {
+        auto program = corpus::Generate(shape, kScalingDefinitions * factor);
+        auto seconds = perf::TimeStage(stage, program);
+        ASSERT_TRUE(seconds) << "The corpus doesn't compile";
+        sizes.push_back(program.source.size());
+        times.push_back(*seconds);
+    }
+    for (size_t i = 1; i < sizes.size(); ++i) {
+        const double growth = static_cast<double>(sizes[i]) / sizes[i - 1];
+        const double exponent = std::log(times[i] / times[i - 1]) / std::log(growth);
+        EXPECT_LE(exponent, kMaxScalingExponent) << std::format(
+            "{} bytes took {:.3f} ms, {} bytes {:.3f} ms", sizes[i - 1], times[i - 1] * 1e3,
+            sizes[i], times[i] * 1e3);
+    }
+}
+
+TEST_P(ShapeTest, PeakMemory) {
+    auto shape = GetParam();
+    auto bytes = perf::MeasurePeakMemory(corpus::Generate(shape, kDefinitions));
+    ASSERT_TRUE(bytes) << "The corpus doesn't compile";
+    perf::CheckBaseline(std::format("peak_memory/{}/bytes", corpus::ShapeName(shape)), *bytes,
+                        perf::Direction::kLowerIsBetter);
+}
+
+INSTANTIATE_TEST_SUITE_P(Perf, StageTest,
+                         testing::Combine(testing::ValuesIn(perf::kStages),
+                                          testing::ValuesIn(corpus::kShapes)),
+                         StageShapeName);
+
+INSTANTIATE_TEST_SUITE_P(Perf, ShapeTest, testing::ValuesIn(corpus::kShapes), ShapeName);
+
+}  // namespace
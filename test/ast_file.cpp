@@ -0,0 +1,127 @@
+#include <codegen/dedup.h>
+#include <parser/ast_file.h>
+#include <parser/parser.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+using namespace token;
+
+namespace {
+
+const std::map<std::string, uint8_t> kDefaultPrecedence = {
+    {"<", 10},
+    {"+", 20},
+    {"-", 20},
+    {"*", 40},
+};
+
+std::vector<ast::Item> Parse(std::string source) {
+    std::istringstream iss(std::move(source));
+    Parser p{kDefaultPrecedence, &iss};
+    std::vector<ast::Item> items;
+    while (true) {
+        switch (GetTokenKind(p.GetTokenizer()->Get())) {
+            case TokenKind::kEof:
+                return items;
+            case TokenKind::kDef:
+                items.emplace_back(std::move(*p.ParseDefinition()));
+                break;
+            case TokenKind::kExtern:
+                items.emplace_back(std::move(*p.ParseExtern()));
+                break;
+            default:
+                items.emplace_back(std::move(*p.ParseTopLevelExpr()));
+                break;
+        }
+    }
+}
+
+std::string Serialize(std::span<const ast::Item> items) {
+    std::string data;
+    llvm::raw_string_ostream out(data);
+    WriteAstFile(items, out);
+    return data;
+}
+
+std::unique_ptr<AstFile> Open(const std::string& data) {
+    return AstFile::Create(llvm::MemoryBuffer::getMemBufferCopy(data));
+}
+
+}  // namespace
+
+TEST(AstFile, RoundTrip) {
+    auto items = Parse(R"(
+        extern def sin(x)
+        def f(x y) sin(x) * 2.5 + y
+        def g(x) f(x, x * x) < 1e-3
+        g(4)
+        def h(n) for i = 0, i < n in f(i, for j = 1, j < i, 2 in g(j))
+        def k(x) if x < 0 then 0 else if x < 1 then x else 1
+        def l(x) var y = x * x, z = y in y + z
+        def m(x:float n:i64):float x * float(n)
+    )");
+    auto file = Open(Serialize(items));
+    ASSERT_TRUE(file);
+    ASSERT_EQ(file->GetItemCount(), items.size());
+    EXPECT_TRUE(file->IsExtern(0));
+    EXPECT_EQ(file->GetItemName(1), "f");
+    EXPECT_EQ(file->GetItemName(3), ast::kTopLevelExprName);
+
+    auto loaded = file->Load();
+    ASSERT_EQ(loaded.size(), items.size());
+    const auto& sin = std::get<ast::Prototype>(loaded[0]);
+    EXPECT_EQ(sin.name, "sin");
+    EXPECT_EQ(sin.args, std::vector<std::string>{"x"});
+    for (size_t i = 1; i < items.size(); ++i) {
+        const auto& expected = std::get<ast::Function>(items[i]);
+        const auto& actual = std::get<ast::Function>(loaded[i]);
+        EXPECT_EQ(actual.proto.name, expected.proto.name);
+        EXPECT_EQ(actual.proto.args, expected.proto.args);
+        EXPECT_EQ(StructuralKey(actual, FpMode::kStrict),
+                  StructuralKey(expected, FpMode::kStrict));
+    }
+}
+
+TEST(AstFile, RejectsInvalidFiles) {
+    auto data = Serialize(Parse("def f(x) x * 2 + g(x)"));
+    EXPECT_FALSE(Open(""));
+    EXPECT_FALSE(Open("not an AST file, just text"));
+    EXPECT_FALSE(Open(data.substr(0, data.size() - 8)));
+
+    auto bad_version = data;
+    bad_version[offsetof(ast_file::Header, version)] = 42;
+    EXPECT_FALSE(Open(bad_version));
+
+    // Point the last item's body past the nodes.
+    auto bad_body = data;
+    auto body = data.size() - sizeof(ast_file::ItemRecord) + offsetof(ast_file::ItemRecord, body);
+    bad_body[body] = 100;
+    EXPECT_FALSE(Open(bad_body));
+}
+
+TEST(AstFile, RejectsSharedNodes) {
+    auto data = Serialize(Parse("def f(x) x * x"));
+    ASSERT_TRUE(Open(data));
+    // Make the multiplication, the last of its three nodes, use its left operand twice.
+    ast_file::Header header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    auto align = [](size_t size) { return (size + 7) / 8 * 8; };
+    size_t mul = align(sizeof(header)) +
+                 align(header.string_count * sizeof(ast_file::StringRecord)) +
+                 align(header.string_bytes) + 2 * sizeof(ast_file::NodeRecord);
+    uint64_t payload = 0;
+    std::memcpy(data.data() + mul + offsetof(ast_file::NodeRecord, payload), &payload,
+                sizeof(payload));
+    EXPECT_FALSE(Open(data));
+}
+
+TEST(AstFile, RejectsDeepNesting) {
+    std::string source = "def f(x) x";
+    for (uint32_t i = 0; i < ast_file::kMaxDepth; ++i) {
+        source += " + x";
+    }
+    EXPECT_FALSE(Open(Serialize(Parse(source))));
+    EXPECT_TRUE(Open(Serialize(Parse("def f(x) x + x + x"))));
+}
@@ -0,0 +1,52 @@
+#include <batch/batch.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+const std::map<std::string, uint8_t> kDefaultPrecedence = {
+    {"<", 10},
+    {"+", 20},
+    {"-", 20},
+    {"*", 40},
+};
+
+}  // namespace
+
+TEST(Batch, SingleModule) {
+    std::istringstream in(R"(
+        extern def sin(x)
+        def f(x) x * 2 + sin(x)
+        def g(y) y * 2 + sin(y)
+        f(1);
+        g(2);
+    )");
+    Batch batch{&in, kDefaultPrecedence, CreateHostTargetMachine()};
+    ASSERT_TRUE(batch.Run());
+
+    const auto& summary = batch.GetSummary();
+    EXPECT_EQ(summary.definitions, 2);
+    EXPECT_EQ(summary.externs, 1);
+    EXPECT_EQ(summary.expressions, 2);
+    EXPECT_EQ(summary.errors, 0);
+    EXPECT_GT(summary.object_bytes, 0);
+
+    const auto& module = batch.GetModule();
+    EXPECT_TRUE(module.getFunction("f"));
+    EXPECT_TRUE(module.getNamedAlias("g"));
+    EXPECT_TRUE(module.getFunction("__anon_expr.0"));
+    EXPECT_TRUE(module.getFunction("__anon_expr.1"));
+}
+
+TEST(Batch, Errors) {
+    std::istringstream in(R"(
+        def f(x) x
+        def f(x) x + 1
+        def g(x) y
+        def h(x) f(x)
+    )");
+    Batch batch{&in, kDefaultPrecedence, CreateHostTargetMachine()};
+    EXPECT_FALSE(batch.Run());
+    EXPECT_EQ(batch.GetSummary().definitions, 2);
+    EXPECT_EQ(batch.GetSummary().errors, 2);
+}
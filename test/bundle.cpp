@@ -0,0 +1,100 @@
+#include <batch/batch.h>
+#include <bundle/bundle.h>
+#include <repl/repl.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+const std::map<std::string, uint8_t> kDefaultPrecedence = {
+    {"<", 10},
+    {"+", 20},
+    {"-", 20},
+    {"*", 40},
+};
+
+std::string CompileBundle(std::string source) {
+    std::istringstream in(std::move(source));
+    Batch batch{&in, kDefaultPrecedence, CreateHostTargetMachine()};
+    EXPECT_TRUE(batch.Run());
+    std::string data;
+    llvm::raw_string_ostream out(data);
+    WriteBundle(batch.GetInterface(), batch.GetModule().getTargetTriple(),
+                batch.GetObject()->getMemBufferRef(), out);
+    return data;
+}
+
+std::unique_ptr<Bundle> Open(const std::string& data) {
+    return Bundle::Create(llvm::MemoryBuffer::getMemBufferCopy(data));
+}
+
+}  // namespace
+
+TEST(Bundle, Interface) {
+    auto bundle = Open(CompileBundle(R"(
+        extern def sin(x)
+        def square(x) x * x
+        def wave(x y) sin(x) * y
+    )"));
+    ASSERT_TRUE(bundle);
+    const auto& interface = bundle->GetInterface();
+    ASSERT_EQ(interface.definitions.size(), 2);
+    EXPECT_EQ(interface.definitions[0].name, "square");
+    EXPECT_EQ(interface.definitions[1].args, (std::vector<std::string>{"x", "y"}));
+    ASSERT_EQ(interface.externs.size(), 1);
+    EXPECT_EQ(interface.externs[0].name, "sin");
+    EXPECT_GT(bundle->GetObject().getBufferSize(), 0);
+}
+
+TEST(Bundle, CallFromRepl) {
+    auto bundle = Open(CompileBundle(R"(
+        def square(x) x * x
+        def plus1(x) x + 1
+    )"));
+    ASSERT_TRUE(bundle);
+
+    std::istringstream in(R"(
+        def f(x) square(plus1(x))
+        f(2);
+        def square(x) x
+    )");
+    std::string output;
+    llvm::raw_string_ostream out(output);
+    Repl repl{&in, &out, kDefaultPrecedence, Jit::Create()};
+    ASSERT_TRUE(repl.LoadBundle(*bundle));
+    EXPECT_FALSE(repl.LoadBundle(*bundle));
+    repl.MainLoop();
+    EXPECT_NE(output.find("Evaluated to 9.000000"), std::string::npos);
+}
+
+TEST(Bundle, CallsRuntimeByName) {
+    // Links against whichever process loads the bundle, not the one that compiled it.
+    auto data = CompileBundle(R"(
+        def square(i) i * i
+        def total(n) parallel_sum(square, n)
+    )");
+    EXPECT_NE(data.find("runtime.parallel_sum"), std::string::npos);
+    auto bundle = Open(data);
+    ASSERT_TRUE(bundle);
+
+    std::istringstream in("total(4);");
+    std::string output;
+    llvm::raw_string_ostream out(output);
+    Repl repl{&in, &out, kDefaultPrecedence, Jit::Create()};
+    ASSERT_TRUE(repl.LoadBundle(*bundle));
+    repl.MainLoop();
+    EXPECT_NE(output.find("Evaluated to 14.000000"), std::string::npos);
+}
+
+TEST(Bundle, RejectsOtherTargets) {
+    auto data = CompileBundle("def f(x) x");
+    auto triple_offset = (sizeof(bundle::Header) + 7) & ~size_t{7};
+    data[triple_offset] = 'z';
+    auto bundle = Open(data);
+    ASSERT_TRUE(bundle);
+    std::istringstream in;
+    std::string output;
+    llvm::raw_string_ostream out(output);
+    Repl repl{&in, &out, kDefaultPrecedence, Jit::Create()};
+    EXPECT_FALSE(repl.LoadBundle(*bundle));
+}
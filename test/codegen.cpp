@@ -0,0 +1,190 @@
+#include <codegen/codegen.h>
+#include <codegen/optimizer.h>
+#include <parser/parser.h>
+
+#include <gtest/gtest.h>
+
+using namespace token;
+
+namespace {
+
+const std::map<std::string, uint8_t> kDefaultPrecedence = {
+    {"<", 10},
+    {"+", 20},
+    {"-", 20},
+    {"*", 40},
+};
+
+void CodegenSource(std::string input, CodegenCtx* ctx) {
+    std::istringstream iss(std::move(input));
+    Parser p{kDefaultPrecedence, &iss};
+    while (true) {
+        switch (GetTokenKind(p.GetTokenizer()->Get())) {
+            case TokenKind::kEof:
+                return;
+            case TokenKind::kDef: {
+                auto fn = p.ParseDefinition();
+                ASSERT_TRUE(fn);
+                ASSERT_TRUE(Codegen(*fn, ctx));
+                break;
+            }
+            case TokenKind::kExtern: {
+                auto proto = p.ParseExtern();
+                ASSERT_TRUE(proto);
+                ASSERT_TRUE(Codegen(*proto, ctx));
+                ctx->function_protos[proto->name] = *proto;
+                break;
+            }
+            default:
+                FAIL() << "Unexpected token";
+        }
+    }
+}
+
+std::string FunctionIR(const CodegenCtx& ctx, const std::string& name) {
+    std::string ir;
+    llvm::raw_string_ostream out(ir);
+    ctx.module->getFunction(name)->print(out);
+    return ir;
+}
+
+}  // namespace
+
+TEST(Codegen, MathIntrinsics) {
+    CodegenCtx ctx("test");
+    CodegenSource("extern def sqrt(x) extern def pow(x y) def f(x) sqrt(x) + pow(x, 2)", &ctx);
+    auto ir = FunctionIR(ctx, "f");
+    EXPECT_NE(ir.find("@llvm.sqrt.f64"), std::string::npos);
+    EXPECT_NE(ir.find("@llvm.pow.f64"), std::string::npos);
+}
+
+TEST(Codegen, UserDefinedMathFunction) {
+    CodegenCtx ctx("test");
+    CodegenSource("def sqrt(x) x * 0.5 def f(x) sqrt(x)", &ctx);
+    auto ir = FunctionIR(ctx, "f");
+    EXPECT_EQ(ir.find("@llvm.sqrt.f64"), std::string::npos);
+    EXPECT_NE(ir.find("call double @sqrt"), std::string::npos);
+}
+
+TEST(Codegen, ForLoop) {
+    CodegenCtx ctx("test");
+    CodegenSource("extern def h(x) def f(n) for i = 0, i < n, 2 in h(i)", &ctx);
+    // A guard in the entry block, then a loop with a single induction variable.
+    EXPECT_EQ(ctx.module->getFunction("f")->getEntryBlock().getTerminator()->getNumSuccessors(),
+              2);
+    auto ir = FunctionIR(ctx, "f");
+    EXPECT_NE(ir.find("phi double [ 0.000000e+00, %entry ]"), std::string::npos);
+    EXPECT_NE(ir.find("fadd double %i, 2.000000e+00"), std::string::npos);
+}
+
+TEST(Codegen, ConditionalSelect) {
+    CodegenCtx ctx("test");
+    CodegenSource("extern def fmin(x y) def clamp(x) if x < 0 then 0 else fmin(x, 1)", &ctx);
+    EXPECT_EQ(ctx.module->getFunction("clamp")->size(), 1);
+    EXPECT_NE(FunctionIR(ctx, "clamp").find("select"), std::string::npos);
+}
+
+TEST(Codegen, ConditionalBranch) {
+    CodegenCtx ctx("test");
+    // Calls may have side effects, so only the chosen one runs.
+    CodegenSource("extern def h(x) def f(x) if x < 0 then h(x) else x", &ctx);
+    auto ir = FunctionIR(ctx, "f");
+    EXPECT_EQ(ir.find("select"), std::string::npos);
+    EXPECT_NE(ir.find("phi double"), std::string::npos);
+}
+
+TEST(Codegen, VarBinding) {
+    CodegenCtx ctx("test");
+    CodegenSource("extern def h(x) def f(x) var y = h(x), x = y * y in x + y", &ctx);
+    // The bindings are promoted to registers, so `h` is called once and nothing is stored.
+    auto ir = FunctionIR(ctx, "f");
+    EXPECT_EQ(ir.find("alloca"), std::string::npos);
+    EXPECT_EQ(ir.find("store"), std::string::npos);
+    EXPECT_EQ(ir.find("call"), ir.rfind("call"));
+}
+
+TEST(Codegen, Types) {
+    CodegenCtx ctx("test");
+    CodegenSource(R"(
+        extern def sqrt(x)
+        def f(x:float n:i64):float sqrt(x * 2) + float(n < 3)
+        def g(x):i64 i64(x) * 2
+    )", &ctx);
+    auto f = FunctionIR(ctx, "f");
+    EXPECT_NE(f.find("define float @f(float %x, i64 %n)"), std::string::npos);
+    EXPECT_NE(f.find("fmul float %x, 2.000000e+00"), std::string::npos);
+    EXPECT_NE(f.find("@llvm.sqrt.f32"), std::string::npos);
+    EXPECT_NE(f.find("icmp slt i64 %n, 3"), std::string::npos);
+    auto g = FunctionIR(ctx, "g");
+    EXPECT_NE(g.find("@llvm.fptosi.sat.i64.f64"), std::string::npos);
+    EXPECT_NE(g.find("mul i64"), std::string::npos);
+}
+
+TEST(Codegen, TypeMismatch) {
+    std::istringstream iss("def f(x:float n:i64):float x + n def g(n:i64):i64 n + 0.5");
+    Parser p{kDefaultPrecedence, &iss};
+    CodegenCtx ctx("test");
+    for (int i = 0; i < 2; ++i) {
+        auto fn = p.ParseDefinition();
+        ASSERT_TRUE(fn);
+        EXPECT_FALSE(Codegen(*fn, &ctx));
+    }
+}
+
+TEST(Codegen, FailedDefinitionIsNotRegistered) {
+    std::istringstream iss("def f(x) y def g(x) f(x)");
+    Parser p{kDefaultPrecedence, &iss};
+    CodegenCtx ctx("test");
+    auto f = p.ParseDefinition();
+    ASSERT_TRUE(f);
+    EXPECT_FALSE(Codegen(*f, &ctx));
+    EXPECT_FALSE(ctx.function_protos.contains("f"));
+    EXPECT_FALSE(ctx.defined_functions.contains("f"));
+    EXPECT_FALSE(ctx.module->getFunction("f"));
+    auto g = p.ParseDefinition();
+    ASSERT_TRUE(g);
+    EXPECT_FALSE(Codegen(*g, &ctx));
+}
+
+TEST(Codegen, Vectors) {
+    CodegenCtx ctx("test");
+    CodegenSource(R"(
+        def dot(a:vec4 b:vec4) hsum(a * b)
+        def top(v:vec8f):float hmax(v + 1)
+    )", &ctx);
+    auto dot = FunctionIR(ctx, "dot");
+    EXPECT_NE(dot.find("define double @dot(<4 x double> %a, <4 x double> %b)"),
+              std::string::npos);
+    EXPECT_NE(dot.find("fmul <4 x double> %a, %b"), std::string::npos);
+    EXPECT_NE(dot.find("@llvm.vector.reduce.fadd.v4f64"), std::string::npos);
+    auto top = FunctionIR(ctx, "top");
+    EXPECT_NE(top.find("fadd <8 x float> %v"), std::string::npos);
+    EXPECT_NE(top.find("@llvm.vector.reduce.fmax.v8f32"), std::string::npos);
+}
+
+TEST(Codegen, DebugInfo) {
+    CodegenCtx ctx("test", {.debug_info = true, .source_name = "test.k"});
+    CodegenSource("def f(x) x + 1\n\ndef g(x)\n  f(x) * 2", &ctx);
+    auto* g = ctx.module->getFunction("g");
+    ASSERT_TRUE(g->getSubprogram());
+    EXPECT_EQ(g->getSubprogram()->getLine(), 3);
+    EXPECT_EQ(g->getSubprogram()->getFilename(), "test.k");
+    for (const auto& inst : g->getEntryBlock()) {
+        EXPECT_EQ(inst.getDebugLoc().getLine(), 3);
+    }
+    EXPECT_EQ(ctx.module->getFunction("f")->getSubprogram()->getLine(), 1);
+
+    auto module = ctx.TakeModule();
+    module.withModuleDo([](llvm::Module& m) {
+        EXPECT_FALSE(llvm::verifyModule(m, &llvm::errs()));
+    });
+    CodegenSource("def h(x) x", &ctx);
+    EXPECT_EQ(ctx.module->getFunction("h")->getSubprogram()->getLine(), 1);
+}
+
+TEST(Codegen, ConstantFoldedIntrinsics) {
+    CodegenCtx ctx("test");
+    CodegenSource("extern def sqrt(x) extern def cos(x) def f() sqrt(16) + cos(0)", &ctx);
+    Optimize(ctx.module.get(), nullptr);
+    EXPECT_NE(FunctionIR(ctx, "f").find("ret double 5.0"), std::string::npos);
+}
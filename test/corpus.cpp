@@ -0,0 +1,27 @@
+#include <corpus/corpus.h>
+#include <engine/engine.h>
+
+#include <gtest/gtest.h>
+
+TEST(Corpus, Deterministic) {
+    for (auto shape : corpus::kShapes) {
+        auto program = corpus::Generate(shape, 20);
+        EXPECT_EQ(program.source, corpus::Generate(shape, 20).source);
+        EXPECT_NE(program.source, corpus::Generate(shape, 20, 2).source);
+        EXPECT_EQ(program.definitions.size(), 20);
+    }
+}
+
+TEST(Corpus, Compiles) {
+    for (auto shape : corpus::kShapes) {
+        auto program = corpus::Generate(shape, 50);
+        auto engine = Engine::Create();
+        ASSERT_TRUE(engine);
+        ASSERT_TRUE(engine->Compile(program.source)) << corpus::ShapeName(shape);
+        for (const auto& name : program.definitions) {
+            auto* function = engine->Lookup<double(double, double)>(name);
+            ASSERT_TRUE(function) << name;
+            function(1.5, 2.5);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#include <codegen/dedup.h>
+#include <parser/parser.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+const std::map<std::string, uint8_t> kDefaultPrecedence = {
+    {"<", 10},
+    {"+", 20},
+    {"-", 20},
+    {"*", 40},
+};
+
+std::string KeyOf(std::string input) {
+    std::istringstream iss(std::move(input));
+    Parser p{kDefaultPrecedence, &iss};
+    auto fn = p.ParseDefinition();
+    EXPECT_TRUE(fn);
+    return fn ? StructuralKey(*fn, FpMode::kStrict) : "";
+}
+
+}  // namespace
+
+TEST(Dedup, RenamedParameters) {
+    EXPECT_EQ(KeyOf("def f(x y) x * 2 + y"), KeyOf("def g(a b) a * 2 + b"));
+    EXPECT_EQ(KeyOf("def f(x) h(x, 1)"), KeyOf("def g(y) h(y, 1)"));
+}
+
+TEST(Dedup, ForLoops) {
+    EXPECT_EQ(KeyOf("def f(n) for i = 0, i < n in h(i)"),
+              KeyOf("def g(m) for i = 0, i < m in h(i)"));
+    // The loop variable is not the parameter it shadows.
+    EXPECT_EQ(KeyOf("def f(i) for i = 0, i < 3 in h(i)"),
+              KeyOf("def g(j) for i = 0, i < 3 in h(i)"));
+    EXPECT_NE(KeyOf("def f(n) for i = 0, i < n in h(i)"),
+              KeyOf("def g(n) for i = 0, i < n, 1 in h(i)"));
+    EXPECT_NE(KeyOf("def f(n) for i = 0, i < n in h(i)"),
+              KeyOf("def g(n) for i = 0, i < n in h(n)"));
+}
+
+TEST(Dedup, Conditionals) {
+    EXPECT_EQ(KeyOf("def f(x) if x < 0 then 0 else x"), KeyOf("def g(y) if y < 0 then 0 else y"));
+    EXPECT_NE(KeyOf("def f(x) if x < 0 then 0 else x"), KeyOf("def g(x) if x < 0 then x else 0"));
+}
+
+TEST(Dedup, VarBindings) {
+    EXPECT_EQ(KeyOf("def f(x) var y = x * x in y + x"), KeyOf("def g(a) var y = a * a in y + a"));
+    // The binding is not the parameter it shadows.
+    EXPECT_EQ(KeyOf("def f(x) var x = 2 in x"), KeyOf("def g(y) var x = 2 in x"));
+    EXPECT_NE(KeyOf("def f(x) var y = x in y"), KeyOf("def g(x) var y = x in x"));
+}
+
+TEST(Dedup, Types) {
+    EXPECT_EQ(KeyOf("def f(x:float) x"), KeyOf("def g(y:float) y"));
+    EXPECT_NE(KeyOf("def f(x:float):float x"), KeyOf("def g(x) x"));
+    EXPECT_NE(KeyOf("def f(x:i64):i64 x"), KeyOf("def g(x:i64) x"));
+}
+
+TEST(Dedup, DifferentStructure) {
+    EXPECT_NE(KeyOf("def f(x y) x - y"), KeyOf("def g(x y) y - x"));
+    EXPECT_NE(KeyOf("def f(x) x"), KeyOf("def g(x y) x"));
+    EXPECT_NE(KeyOf("def f(x) x + 1"), KeyOf("def g(x) x + 1.5"));
+    EXPECT_NE(KeyOf("def f(x) h(x)"), KeyOf("def g(x) k(x)"));
+    EXPECT_NE(KeyOf("def f(x) x + y"), KeyOf("def g(x) x + z"));
+}
+
+TEST(Dedup, Deduplicator) {
+    FunctionDeduplicator dedup;
+    EXPECT_FALSE(dedup.Find(KeyOf("def f(x) x * x")));
+    dedup.Insert(KeyOf("def f(x) x * x"), "f");
+    EXPECT_EQ(dedup.Find(KeyOf("def g(y) y * y")), "f");
+    EXPECT_FALSE(dedup.Find(KeyOf("def g(y) y * 2")));
+}
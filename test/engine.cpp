@@ -0,0 +1,326 @@
+#include <engine/engine.h>
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(Engine, LookupAndCall) {
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    ASSERT_TRUE(engine->Compile(R"(
+        extern def sin(x)
+        def hypot2(x y) x * x + y * y
+        def wave(x) sin(x) * 2
+    )"));
+    auto* hypot2 = engine->Lookup<double(double, double)>("hypot2");
+    ASSERT_TRUE(hypot2);
+    EXPECT_EQ(hypot2(3, 4), 25);
+    EXPECT_EQ(engine->Call("wave", 0), 0);
+    EXPECT_EQ(engine->Call("hypot2", 1, 2.5), 7.25);
+
+    // Wrong arity or name.
+    EXPECT_FALSE(engine->Lookup<double(double)>("hypot2"));
+    EXPECT_FALSE(engine->Lookup<double()>("missing"));
+    EXPECT_FALSE(engine->Call("wave", 1, 2));
+}
+
+TEST(Engine, CompileIsAtomic) {
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    ASSERT_TRUE(engine->Compile("def f(x) x + 1"));
+    EXPECT_FALSE(engine->Compile("def g(x) f(x) * 2\ndef h(x) y"));
+    EXPECT_FALSE(engine->Call("g", 1));
+    EXPECT_FALSE(engine->Compile("def f(x) x"));
+    EXPECT_FALSE(engine->Compile("f(1);"));
+
+    // Later sources call functions compiled earlier.
+    ASSERT_TRUE(engine->Compile("def g(x) f(x) * 2"));
+    EXPECT_EQ(engine->Call("g", 1), 4);
+    EXPECT_EQ(engine->Call("f", 1), 2);
+}
+
+TEST(Engine, CompileIsAtomicWhenLinking) {
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    // Parses and generates code, but the extern resolves to nothing.
+    EXPECT_FALSE(engine->Compile(R"(
+        extern def nosuchhostfunction(x)
+        def f(x) nosuchhostfunction(x)
+    )"));
+    EXPECT_FALSE(engine->Lookup<double(double)>("f"));
+    ASSERT_TRUE(engine->Compile("def f(x) x + 1"));
+    EXPECT_EQ(engine->Call("f", 1), 2);
+}
+
+TEST(Engine, ConcurrentCalls) {
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    ASSERT_TRUE(engine->Compile("def f0(x) x + 0"));
+    std::vector<double> sums(4);
+    {
+        std::vector<std::jthread> threads;
+        for (size_t t = 0; t < sums.size(); ++t) {
+            threads.emplace_back([&, t] {
+                auto* f = engine->Lookup<double(double)>("f0");
+                for (int i = 0; i < 1000; ++i) {
+                    sums[t] += f(i);
+                    sums[t] += engine->Call(std::format("f{}", i % 10), 0).value_or(0);
+                }
+            });
+        }
+        for (int i = 1; i < 10; ++i) {
+            EXPECT_TRUE(engine->Compile(std::format("def f{}(x) x + {}", i, i)));
+        }
+    }
+    for (auto sum : sums) {
+        EXPECT_GE(sum, 999 * 1000 / 2);
+    }
+    EXPECT_EQ(engine->Call("f9", 1), 10);
+}
+
+namespace {
+
+// Not exported, so only a registration can bind an extern to it.
+double Twice(double x) {
+    return 2 * x;
+}
+
+double ColumnAt(void* context, double index) {
+    return static_cast<const std::vector<double>*>(context)->at(static_cast<size_t>(index));
+}
+
+}  // namespace
+
+TEST(Engine, HostFunctions) {
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    std::vector<double> column = {1.5, 2.5, 3.5};
+    double scale = 10;
+    auto scaled = [&scale](double x) { return x * scale; };
+    ASSERT_TRUE(engine->Register("twice", &Twice));
+    ASSERT_TRUE(engine->Register("column", &column, &ColumnAt));
+    ASSERT_TRUE(engine->Register<double(double)>("scaled", &scaled));
+
+    ASSERT_TRUE(engine->Compile(R"(
+        extern def twice(x)
+        def f(i) scaled(twice(column(i)))
+    )"));
+    EXPECT_EQ(engine->Call("f", 1), 50);
+    scale = 1;
+    column[1] = 4;
+    EXPECT_EQ(engine->Call("f", 1), 8);
+
+    // Arities are checked against the prototypes and the calls.
+    EXPECT_FALSE(engine->Compile("extern def twice(x y)"));
+    EXPECT_FALSE(engine->Compile("def g(x) twice(x, x)"));
+    EXPECT_FALSE(engine->Register("f", &Twice));
+    EXPECT_FALSE(engine->Register("twice", &Twice));
+    ASSERT_TRUE(engine->Compile("extern def other(x y)"));
+    EXPECT_FALSE(engine->Register("other", &Twice));
+    EXPECT_FALSE(engine->Compile("def twice(x) x"));
+}
+
+TEST(Engine, Conditional) {
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    double calls = 0;
+    auto count = [&calls](double x) {
+        ++calls;
+        return x;
+    };
+    ASSERT_TRUE(engine->Register<double(double)>("count", &count));
+    ASSERT_TRUE(engine->Compile(R"(
+        def clamp(x lo hi) if x < lo then lo else if hi < x then hi else x
+        def pick(x) if x < 0 then count(0 - x) else x
+    )"));
+    auto* clamp = engine->Lookup<double(double, double, double)>("clamp");
+    ASSERT_TRUE(clamp);
+    EXPECT_EQ(clamp(-1, 0, 1), 0);
+    EXPECT_EQ(clamp(0.5, 0, 1), 0.5);
+    EXPECT_EQ(clamp(2, 0, 1), 1);
+
+    EXPECT_EQ(engine->Call("pick", 3), 3);
+    EXPECT_EQ(calls, 0);
+    EXPECT_EQ(engine->Call("pick", -3), 3);
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(Engine, VarBinding) {
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    ASSERT_TRUE(engine->Compile(R"(
+        def f(x) var y = x * x, z = y + x in (var x = 1 in z * x) + x
+    )"));
+    // Bindings shadow the parameter only in their body.
+    EXPECT_EQ(engine->Call("f", 3), 12 + 3);
+    EXPECT_FALSE(engine->Compile("def g(x) (var y = x in y) + y"));
+}
+
+TEST(Engine, Types) {
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    ASSERT_TRUE(engine->Compile(R"(
+        def scale(x:float n:i64):float x * float(n)
+        def steps(n:i64) for i = i64(0), i < n, 2 in i
+        def truncate(x):i64 i64(x)
+    )"));
+    auto* scale = engine->Lookup<float(float, int64_t)>("scale");
+    ASSERT_TRUE(scale);
+    EXPECT_EQ(scale(1.5f, 4), 6.0f);
+    EXPECT_FALSE(engine->Lookup<double(double, double)>("scale"));
+    EXPECT_FALSE(engine->Call("scale", 1.5, 4));
+    EXPECT_EQ(engine->Lookup<double(int64_t)>("steps")(5), 0);
+
+    auto* truncate = engine->Lookup<int64_t(double)>("truncate");
+    ASSERT_TRUE(truncate);
+    EXPECT_EQ(truncate(-2.7), -2);
+    // Conversions saturate rather than being undefined.
+    EXPECT_EQ(truncate(1e30), std::numeric_limits<int64_t>::max());
+    EXPECT_EQ(truncate(std::numeric_limits<double>::quiet_NaN()), 0);
+
+    // Values only convert explicitly, except literals.
+    EXPECT_FALSE(engine->Compile("def f(x:float) x"));
+    EXPECT_FALSE(engine->Compile("def f(n:i64):i64 n + 0.5"));
+    EXPECT_TRUE(engine->Compile("def f(n:i64):i64 n * 2 + 1"));
+    EXPECT_EQ(engine->Lookup<int64_t(int64_t)>("f")(20), 41);
+}
+
+TEST(Engine, Vectors) {
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    ASSERT_TRUE(engine->Compile(R"(
+        def dot(a:vec4 b:vec4) hsum(a * b)
+        def scale(v:vec4 k):vec4 v * k
+        def f(x) dot(vec4(1, 2, 3, 4), scale(vec4(x), 2))
+        def lane(x) extract(vec4(1, x, 3, 4) + 1, 1)
+        def g(x:float):float hmin(vec8f(x) - vec8f(0, 1, 2, 3, 4, 5, 6, 7))
+    )"));
+    EXPECT_EQ(*engine->Call("f", 1.0), 20.0);
+    EXPECT_EQ(*engine->Call("lane", 5.0), 6.0);
+    EXPECT_EQ(engine->Lookup<float(float)>("g")(10.0f), 3.0f);
+
+    EXPECT_FALSE(engine->Compile("def h() hsum(vec4(1, 2))"));
+    EXPECT_FALSE(engine->Compile("def h() extract(vec4(1), 4)"));
+    EXPECT_FALSE(engine->Compile("def h() if vec4(1) then 1 else 0"));
+    EXPECT_FALSE(engine->Compile("def h(v:vec4) v"));
+}
+
+namespace {
+
+std::vector<double> parallel_results(1000);
+
+double StoreResult(double index, double value) {
+    parallel_results[static_cast<size_t>(index)] = value;
+    return 0;
+}
+
+}  // namespace
+
+TEST(Engine, VectorMathLibrary) {
+#if !defined(__x86_64__) || !defined(__GLIBC__)
+    GTEST_SKIP() << "libmvec is only mapped on x86-64 glibc";
+#endif
+    auto engine = Engine::Create({.optimizer = {.vector_library = VectorLibrary::kLibmvec}});
+    ASSERT_TRUE(engine);
+    // The loop of the column kernel is vectorized into calls to libmvec's sin.
+    std::string kernels[] = {"wave"};
+    ASSERT_TRUE(engine->Compile("extern def sin(x)\ndef wave(x) sin(x) * 2", kernels));
+    auto kernel = engine->LookupColumnKernel("wave");
+    ASSERT_TRUE(kernel);
+    std::vector<double> x(1001);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = i * 0.01;
+    }
+    std::vector<double> out(x.size());
+    const void* columns[] = {x.data()};
+    kernel(columns, out.data(), 0, static_cast<int64_t>(x.size()));
+    for (size_t i = 0; i < x.size(); ++i) {
+        ASSERT_NEAR(out[i], std::sin(x[i]) * 2, 1e-12);
+    }
+}
+
+TEST(Engine, ParallelBuiltins) {
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    ASSERT_TRUE(engine->Register("store", &StoreResult));
+    ASSERT_TRUE(engine->Compile(R"(
+        def square(i) i * i
+        def larger(a b) if a < b then b else a
+        def total(n) parallel_sum(square, n)
+        def fill(n) parallel_map(square, n, store)
+        def largest(n) parallel_reduce(square, n, larger, 0)
+        def nested(n) parallel_sum(total, n)
+    )"));
+    EXPECT_EQ(*engine->Call("total", 1000), 999.0 * 1000 * 1999 / 6);
+    EXPECT_EQ(*engine->Call("total", 0), 0);
+    EXPECT_EQ(*engine->Call("fill", 1000), 0);
+    for (size_t i = 0; i < parallel_results.size(); ++i) {
+        ASSERT_EQ(parallel_results[i], static_cast<double>(i * i));
+    }
+    EXPECT_EQ(*engine->Call("largest", 10), 81);
+    EXPECT_EQ(*engine->Call("nested", 3), 0 + 0 + 1);
+
+    EXPECT_FALSE(engine->Compile("def g(n) parallel_sum(larger, n)"));
+    EXPECT_FALSE(engine->Compile("def g(n) parallel_sum(n, n)"));
+    EXPECT_FALSE(engine->Compile("def g(n) parallel_map(square, n)"));
+}
+
+TEST(Engine, ForLoop) {
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    double sum = 0;
+    auto add = [&sum](double x) {
+        sum += x;
+        return 0.0;
+    };
+    ASSERT_TRUE(engine->Register<double(double)>("add", &add));
+    ASSERT_TRUE(engine->Compile(R"(
+        def series(n) for i = 0, i < n in add(i * i)
+        def pairs(n) for i = 0, i < n, 2 in for j = i, j < n in add(1)
+    )"));
+    EXPECT_EQ(engine->Call("series", 4), 0);
+    EXPECT_EQ(sum, 0 + 1 + 4 + 9);
+
+    // The condition is checked before the first iteration.
+    sum = 0;
+    engine->Call("series", 0);
+    EXPECT_EQ(sum, 0);
+
+    sum = 0;
+    engine->Call("pairs", 4);
+    EXPECT_EQ(sum, 4 + 2);
+}
+
+TEST(Engine, PerfMap) {
+    auto engine = Engine::Create({
+        .codegen = {.debug_info = true},
+        .perf = {.perf_map = true},
+    });
+    ASSERT_TRUE(engine);
+    ASSERT_TRUE(engine->Compile(R"(
+        def perfmapped(x) x * 3
+        def twice(x) perfmapped(x) + perfmapped(x)
+    )"));
+    EXPECT_EQ(engine->Call("twice", 2), 12);
+
+    // Other tests of the process may have appended their functions as well.
+    const auto path = std::format("/tmp/perf-{}.map", getpid());
+    bool found = false;
+    {
+        std::ifstream map(path);
+        for (std::string line; std::getline(map, line);) {
+            found |= line.ends_with(" perfmapped");
+        }
+    }
+    std::filesystem::remove(path);
+    EXPECT_TRUE(found);
+}
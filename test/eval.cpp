@@ -0,0 +1,67 @@
+#include <eval/eval.h>
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+template <class T>
+void WriteColumn(const std::filesystem::path& path, const std::vector<T>& values) {
+    std::ofstream(path, std::ios::binary)
+        .write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <class T>
+std::vector<T> ReadColumn(const std::filesystem::path& path) {
+    std::vector<T> values(std::filesystem::file_size(path) / sizeof(T));
+    std::ifstream(path, std::ios::binary)
+        .read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(T));
+    return values;
+}
+
+}  // namespace
+
+TEST(Eval, Columns) {
+    auto dir = std::filesystem::temp_directory_path() / "kaleidoscope_eval_test";
+    std::filesystem::create_directories(dir);
+    std::vector<double> x(10001);
+    std::vector<int64_t> n(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = i * 0.5;
+        n[i] = i % 7;
+    }
+    WriteColumn(dir / "x.bin", x);
+    WriteColumn(dir / "n.bin", n);
+    WriteColumn(dir / "short.bin", std::vector<double>{1, 2});
+
+    auto engine = Engine::Create();
+    ASSERT_TRUE(engine);
+    std::string kernels[] = {"f"};
+    ASSERT_TRUE(engine->Compile("def f(n:i64 x):float float(x * double(n))", kernels));
+    std::map<std::string, std::string> columns = {
+        {"x", dir / "x.bin"},
+        {"n", dir / "n.bin"},
+    };
+    for (bool stream : {false, true}) {
+        auto summary = EvaluateColumns(*engine, "f", columns, dir / "out.bin",
+                                       {.threads = 3, .chunk_rows = 1000, .stream = stream});
+        ASSERT_TRUE(summary);
+        EXPECT_EQ(summary->rows, x.size());
+        EXPECT_EQ(summary->chunks, 11);
+        auto out = ReadColumn<float>(dir / "out.bin");
+        ASSERT_EQ(out.size(), x.size());
+        for (size_t i = 0; i < x.size(); ++i) {
+            ASSERT_EQ(out[i], static_cast<float>(x[i] * n[i]));
+        }
+    }
+
+    EXPECT_FALSE(EvaluateColumns(*engine, "f", {{"x", dir / "x.bin"}}, dir / "out.bin"));
+    EXPECT_FALSE(EvaluateColumns(*engine, "f", {{"x", dir / "short.bin"}, {"n", dir / "n.bin"}},
+                                 dir / "out.bin"));
+    ASSERT_TRUE(engine->Compile("def g(x) x"));
+    EXPECT_FALSE(EvaluateColumns(*engine, "g", {{"x", dir / "x.bin"}}, dir / "out.bin"));
+    std::filesystem::remove_all(dir);
+}
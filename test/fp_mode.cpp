@@ -0,0 +1,168 @@
+#include <codegen/codegen.h>
+#include <jit/jit.h>
+#include <parser/parser.h>
+#include <repl/repl.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <format>
+
+using namespace token;
+
+namespace {
+
+const std::map<std::string, uint8_t> kDefaultPrecedence = {
+    {"<", 10},
+    {"+", 20},
+    {"-", 20},
+    {"*", 40},
+};
+
+constexpr FpMode kModes[] = {FpMode::kStrict, FpMode::kContract, FpMode::kFast};
+
+// Well-conditioned formulas over the sampled range, all of the shape double(double, double, double).
+constexpr std::string_view kFormulas = R"(
+    def horner(x y z) (((x * 0.25 - 1.5) * x + 2.0) * x - 0.75) * x + 3.0
+    def dot(x y z) x * y + y * z + z * x
+    def lerp(x y z) x + (y - x) * z
+    def poly2(x y z) x * x * 3.0 + y * y * 2.0 + z * z + x * y * z
+)";
+constexpr std::string_view kFormulaNames[] = {"horner", "dot", "lerp", "poly2"};
+
+using Formula = double (*)(double, double, double);
+
+bool CodegenSource(std::string_view source, CodegenCtx* ctx) {
+    std::istringstream iss{std::string(source)};
+    Parser parser{kDefaultPrecedence, &iss};
+    while (parser.GetTokenizer()->Get() != Token{Eof{}}) {
+        auto fn = parser.ParseDefinition();
+        if (!fn || !Codegen(*fn, ctx)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<Jit> Compile(std::string_view source, CodegenOptions options) {
+    auto jit = Jit::Create();
+    if (!jit) {
+        return nullptr;
+    }
+    CodegenCtx ctx("fp_mode", std::move(options));
+    jit->ConfigureModule(ctx.module.get());
+    if (!CodegenSource(source, &ctx) || !jit->AddModule(ctx.TakeModule())) {
+        return nullptr;
+    }
+    return jit;
+}
+
+std::string FunctionIR(std::string_view source, CodegenOptions options, const std::string& name) {
+    CodegenCtx ctx("fp_mode", std::move(options));
+    EXPECT_TRUE(CodegenSource(source, &ctx));
+    std::string ir;
+    llvm::raw_string_ostream out(ir);
+    ctx.module->getFunction(name)->print(out);
+    return ir;
+}
+
+std::vector<double> Inputs() {
+    std::vector<double> inputs;
+    for (int i = 0; i < 64; ++i) {
+        inputs.push_back(0.5 + i * 0.37);
+    }
+    return inputs;
+}
+
+}  // namespace
+
+TEST(FpMode, Flags) {
+    constexpr std::string_view source = "def f(x y z) x * y + z";
+    auto strict = FunctionIR(source, {.fp_mode = FpMode::kStrict}, "f");
+    EXPECT_NE(strict.find("fmul double"), std::string::npos);
+    EXPECT_EQ(strict.find("unsafe-fp-math"), std::string::npos);
+    auto contract = FunctionIR(source, {.fp_mode = FpMode::kContract}, "f");
+    EXPECT_NE(contract.find("fmul contract double"), std::string::npos);
+    auto fast = FunctionIR(source, {.fp_mode = FpMode::kFast}, "f");
+    EXPECT_NE(fast.find("fmul fast double"), std::string::npos);
+}
+
+TEST(FpMode, PerFunctionOverride) {
+    constexpr std::string_view source = "def f(x) x * 2\ndef g(x) x * 2 + 1";
+    CodegenOptions options{.fp_mode = FpMode::kStrict,
+                           .function_fp_modes = {{"g", FpMode::kFast}}};
+    EXPECT_NE(FunctionIR(source, options, "f").find("fmul double"), std::string::npos);
+    EXPECT_NE(FunctionIR(source, options, "g").find("fmul fast double"), std::string::npos);
+}
+
+TEST(FpMode, OverrideIsNotDeduplicated) {
+    std::istringstream in("def f(x) x * 3\ndef g(x) x * 3\ndef h(x) x * 3");
+    std::string output;
+    llvm::raw_string_ostream out(output);
+    auto jit = Jit::Create();
+    ASSERT_TRUE(jit);
+    CodegenOptions options{.fp_mode = FpMode::kStrict,
+                           .function_fp_modes = {{"g", FpMode::kFast}}};
+    Repl repl{&in, &out, kDefaultPrecedence, std::move(jit), {.codegen = std::move(options)}};
+    repl.MainLoop();
+    EXPECT_EQ(output.find("g is an alias of f"), std::string::npos);
+    EXPECT_NE(output.find("fmul fast double"), std::string::npos);
+    EXPECT_NE(output.find("h is an alias of f"), std::string::npos);
+}
+
+TEST(FpMode, Accuracy) {
+    auto strict = Compile(kFormulas, {.fp_mode = FpMode::kStrict});
+    ASSERT_TRUE(strict);
+    auto inputs = Inputs();
+    for (auto mode : kModes) {
+        auto relaxed = Compile(kFormulas, {.fp_mode = mode});
+        ASSERT_TRUE(relaxed);
+        for (auto name : kFormulaNames) {
+            auto expected = reinterpret_cast<Formula>(strict->Lookup(std::string(name)));
+            auto actual = reinterpret_cast<Formula>(relaxed->Lookup(std::string(name)));
+            ASSERT_TRUE(expected && actual);
+
+            double max_error = 0;
+            for (auto x : inputs) {
+                for (auto y : inputs) {
+                    auto e = expected(x, y, 0.75);
+                    auto a = actual(x, y, 0.75);
+                    max_error = std::max(max_error, std::abs(a - e) / std::max(1.0, std::abs(e)));
+                }
+            }
+            EXPECT_LE(max_error, 1e-12) << name << " in " << FpModeName(mode) << " mode";
+            RecordProperty(std::format("{}_{}_max_rel_error", name, FpModeName(mode)),
+                           std::format("{:e}", max_error));
+        }
+    }
+}
+
+// Timings are recorded rather than asserted; compare them with --gtest_output=xml.
+TEST(FpMode, Performance) {
+    auto inputs = Inputs();
+    for (auto mode : kModes) {
+        auto jit = Compile(kFormulas, {.fp_mode = mode});
+        ASSERT_TRUE(jit);
+        for (auto name : kFormulaNames) {
+            auto fn = reinterpret_cast<Formula>(jit->Lookup(std::string(name)));
+            ASSERT_TRUE(fn);
+
+            volatile double sink = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int iter = 0; iter < 64; ++iter) {
+                for (auto x : inputs) {
+                    for (auto y : inputs) {
+                        sink = sink + fn(x, y, 0.75);
+                    }
+                }
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            auto calls = 64 * inputs.size() * inputs.size();
+            RecordProperty(std::format("{}_{}_ns_per_call", name, FpModeName(mode)),
+                           std::format("{:.2f}",
+                                       std::chrono::duration<double, std::nano>(elapsed).count() /
+                                           calls));
+        }
+    }
+}
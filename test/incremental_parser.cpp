@@ -0,0 +1,163 @@
+#include <parser/incremental_parser.h>
+#include <parser/debug.h>
+#include <parser/parser.h>
+#include <overloaded.h>
+#include <repl/repl.h>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+using namespace token;
+
+namespace {
+
+const std::map<std::string, uint8_t> kDefaultPrecedence = {
+    {"<", 10},
+    {"+", 20},
+    {"-", 20},
+    {"*", 40},
+};
+
+std::string Describe(const ast::Item& item) {
+    std::ostringstream out;
+    std::visit(Overloaded{
+                   [&out](const ast::Prototype& proto) { out << debug::Debug{&proto}; },
+                   [&out](const ast::Function& fn) { out << debug::Debug{&fn}; },
+               },
+               item);
+    return out.str();
+}
+
+// Items as the blocking parser sees them.
+std::vector<std::string> Parse(std::string source) {
+    std::istringstream iss(std::move(source));
+    Parser p{kDefaultPrecedence, &iss};
+    std::vector<std::string> items;
+    while (true) {
+        switch (GetTokenKind(p.GetTokenizer()->Get())) {
+            case TokenKind::kEof:
+                return items;
+            case TokenKind::kSemicolon:
+                p.GetTokenizer()->Next();
+                break;
+            case TokenKind::kDef:
+                items.push_back(Describe(std::move(*p.ParseDefinition())));
+                break;
+            case TokenKind::kExtern:
+                items.push_back(Describe(std::move(*p.ParseExtern())));
+                break;
+            default:
+                items.push_back(Describe(std::move(*p.ParseTopLevelExpr())));
+                break;
+        }
+    }
+}
+
+std::vector<std::string> ParseIncrementally(std::string_view source, size_t chunk_size) {
+    IncrementalParser parser(kDefaultPrecedence);
+    std::vector<std::string> items;
+    for (size_t i = 0; i < source.size(); i += chunk_size) {
+        parser.Feed(source.substr(i, chunk_size));
+        while (auto item = parser.Next()) {
+            items.push_back(Describe(*item));
+        }
+    }
+    parser.Close();
+    while (auto item = parser.Next()) {
+        items.push_back(Describe(*item));
+    }
+    EXPECT_TRUE(parser.IsDone());
+    return items;
+}
+
+}  // namespace
+
+TEST(IncrementalParser, MatchesParser) {
+    constexpr std::string_view kSource = R"(
+        extern def sin(x)
+        def f(x y) sin(x) * 2.5 + y # comment (
+        def g(x) f (x, x * x) < 1e-3
+        g(4) g(5);;
+        (1 + 2) * 3 4
+        extern def cos(x) cos(1)
+        for i = 0, i < 3, 1 in for j = i, j < 3 in g(j) 5
+        if 1 then if 0 then 2 else 3 else 4 (6)
+        var a = 1, b = var c = a in c in a + b 7
+        extern def k(x:float):float def l(n:i64) n extern def m(x) (8)
+        def h(x) x*x)";
+    auto expected = Parse(std::string(kSource));
+    ASSERT_EQ(expected.size(), 21);
+    for (size_t chunk_size : {size_t{1}, size_t{2}, size_t{3}, size_t{7}, kSource.size()}) {
+        EXPECT_EQ(ParseIncrementally(kSource, chunk_size), expected) << chunk_size;
+    }
+}
+
+TEST(IncrementalParser, WaitsForNextToken) {
+    IncrementalParser parser(kDefaultPrecedence);
+    parser.Feed("extern def sin(x");
+    EXPECT_FALSE(parser.Next());
+    parser.Feed(") def f(x) x");
+    EXPECT_TRUE(parser.Next());
+    EXPECT_FALSE(parser.Next());
+    // The expression may go on.
+    parser.Feed(" + 1\n");
+    EXPECT_FALSE(parser.Next());
+    parser.Feed("f(2");
+    ASSERT_TRUE(parser.Next());
+    EXPECT_FALSE(parser.Next());
+    parser.Feed(");");
+    EXPECT_TRUE(parser.Next());
+    EXPECT_FALSE(parser.IsDone());
+    parser.Close();
+    EXPECT_TRUE(parser.IsDone());
+}
+
+TEST(IncrementalParser, ExternThenExpression) {
+    constexpr std::string_view kSource = "extern def sin(x)\nsin(1);";
+    auto expected = Parse(std::string(kSource));
+    ASSERT_EQ(expected.size(), 2);
+    for (size_t chunk_size : {size_t{1}, size_t{4}, kSource.size()}) {
+        EXPECT_EQ(ParseIncrementally(kSource, chunk_size), expected) << chunk_size;
+    }
+}
+
+TEST(IncrementalParser, Lines) {
+    constexpr std::string_view kSource = "def f(x)\n  x\n# g\n\ndef g(x) x\nextern def h(x)";
+    for (size_t chunk_size : {size_t{1}, size_t{5}, kSource.size()}) {
+        IncrementalParser parser(kDefaultPrecedence);
+        for (size_t i = 0; i < kSource.size(); i += chunk_size) {
+            parser.Feed(kSource.substr(i, chunk_size));
+        }
+        parser.Close();
+        std::vector<size_t> lines;
+        while (auto item = parser.Next()) {
+            std::visit(Overloaded{
+                           [&](const ast::Prototype& proto) { lines.push_back(proto.line); },
+                           [&](const ast::Function& fn) { lines.push_back(fn.proto.line); },
+                       },
+                       *item);
+        }
+        EXPECT_EQ(lines, (std::vector<size_t>{1, 5, 6})) << chunk_size;
+    }
+}
+
+TEST(IncrementalParser, Errors) {
+    auto items = ParseIncrementally("def 1 f(x) x\n) 2; def g(x) (x + 3", 2);
+    EXPECT_EQ(items, Parse("f(x) x 2"));
+}
+
+TEST(IncrementalParser, DrivesRepl) {
+    std::istringstream in;
+    std::string output;
+    llvm::raw_string_ostream out(output);
+    Repl repl{&in, &out, kDefaultPrecedence, Jit::Create()};
+    IncrementalParser parser(kDefaultPrecedence);
+    for (auto chunk : {"def f(x) x ", "* 2\nf(", "21);"}) {
+        parser.Feed(chunk);
+        while (auto item = parser.Next()) {
+            repl.Handle(std::move(*item));
+        }
+    }
+    EXPECT_NE(output.find("Evaluated to 42.000000"), std::string::npos);
+}
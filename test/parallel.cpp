@@ -0,0 +1,70 @@
+#include <runtime/parallel.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST(Parallel, RunsEveryChunkOnce) {
+    for (size_t threads : {0, 1, 4}) {
+        runtime::WorkStealingPool pool(threads);
+        std::vector<std::atomic<int>> runs(1000);
+        pool.ParallelFor(runs.size(), [&](size_t chunk) { ++runs[chunk]; });
+        for (const auto& count : runs) {
+            ASSERT_EQ(count, 1);
+        }
+        pool.ParallelFor(0, [](size_t) { FAIL(); });
+    }
+}
+
+TEST(Parallel, Nested) {
+    runtime::WorkStealingPool pool(3);
+    std::atomic<size_t> total = 0;
+    // Waiting chunks run the inner chunks rather than blocking the workers.
+    pool.ParallelFor(100, [&](size_t) {
+        pool.ParallelFor(100, [&](size_t chunk) { total += chunk; });
+    });
+    EXPECT_EQ(total, 100 * 4950);
+}
+
+TEST(Parallel, ConcurrentCallers) {
+    runtime::WorkStealingPool pool(2);
+    std::atomic<size_t> total = 0;
+    {
+        std::vector<std::jthread> callers;
+        for (int i = 0; i < 4; ++i) {
+            callers.emplace_back([&] {
+                for (int j = 0; j < 50; ++j) {
+                    pool.ParallelFor(100, [&](size_t chunk) { total += chunk; });
+                }
+            });
+        }
+    }
+    EXPECT_EQ(total, 4 * 50 * 4950);
+}
+
+namespace {
+
+double Half(double i) {
+    return i / 2;
+}
+
+double Max(double a, double b) {
+    return a < b ? b : a;
+}
+
+}  // namespace
+
+TEST(Parallel, Builtins) {
+    EXPECT_EQ(runtime::ParallelSum(&Half, 100000), 4999950000.0 / 2);
+    // Indices go up to `n` rounded up, like `for i = 0, i < n`.
+    EXPECT_EQ(runtime::ParallelSum(&Half, 2.5), 1.5);
+    EXPECT_EQ(runtime::ParallelSum(&Half, -1), 0);
+    EXPECT_EQ(runtime::ParallelReduce(&Half, 101, &Max, 0), 50);
+    // Chunks don't depend on timing, so neither do rounding errors.
+    auto sum = runtime::ParallelSum([](double i) { return 1 / (i + 1); }, 1e6);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(runtime::ParallelSum([](double i) { return 1 / (i + 1); }, 1e6), sum);
+    }
+}
@@ -82,9 +82,57 @@ TEST(Parser, Call) {
                           "(* (<call> fa a b) (+ (<call> fb a c) fc))");
 }
 
+TEST(Parser, ForLoop) {
+    CheckParsedExpression("for i = 1, i < n in f(i)", &Parser::ParseExpression,
+                          "(<for> i 1 (< i n) (<call> f i))");
+    CheckParsedExpression("for i = a, i < b, 2 in for j = i, j < b in g(i, j) + 1",
+                          &Parser::ParseExpression,
+                          "(<for> i a (< i b) 2 (<for> j i (< j b) (+ (<call> g i j) 1)))");
+    CheckParsedExpression("(for i = 0, i < 2 in i) + 1", &Parser::ParseExpression,
+                          "(+ (<for> i 0 (< i 2) i) 1)");
+}
+
+TEST(Parser, Conditional) {
+    CheckParsedExpression("if x < 0 then 0 else x + 1", &Parser::ParseExpression,
+                          "(<if> (< x 0) 0 (+ x 1))");
+    CheckParsedExpression("if a then if b then 1 else 2 else 3", &Parser::ParseExpression,
+                          "(<if> a (<if> b 1 2) 3)");
+    CheckParsedExpression("(if a then b else c) * 2", &Parser::ParseExpression,
+                          "(* (<if> a b c) 2)");
+}
+
+TEST(Parser, VarBinding) {
+    CheckParsedExpression("var y = x * x in y + 1", &Parser::ParseExpression,
+                          "(<var> y (* x x) (+ y 1))");
+    CheckParsedExpression("var a = 1, b = a + 1 in a * b", &Parser::ParseExpression,
+                          "(<var> a 1 (<var> b (+ a 1) (* a b)))");
+}
+
+TEST(Parser, TypeAnnotations) {
+    CheckParsedExpression("def f(x:float n:i64 y):float x", &Parser::ParseDefinition,
+                          "(<func> (<proto> f x:float n:i64 y :float) x)");
+    CheckParsedExpression("extern def g(x:double):i64", &Parser::ParseExtern,
+                          "(<proto> g x :i64)");
+    CheckParsedExpression("def f(a:vec4 b:vec8f):vec4 a", &Parser::ParseDefinition,
+                          "(<func> (<proto> f a:vec4 b:vec8f :vec4) a)");
+
+    std::istringstream iss("def f(x:int) x");
+    Parser p{kDefaultPrecedence, &iss};
+    EXPECT_FALSE(p.ParseDefinition());
+}
+
 TEST(Parser, Definition) {
     CheckParsedExpression("def ff(a b c) a + b * 1.2 < c", &Parser::ParseDefinition,
                           "(<func> (<proto> ff a b c) (< (+ a (* b 1.2)) c))");
     CheckParsedExpression("def f() 42", &Parser::ParseDefinition, "(<func> (<proto> f) 42)");
     CheckParsedExpression("def f(x) x;", &Parser::ParseDefinition, "(<func> (<proto> f x) x)");
 }
+
+TEST(Parser, Lines) {
+    std::istringstream iss("def f(x) x\n\ndef\ng(x)\n  x\nextern def h()\nf(1)");
+    Parser p{kDefaultPrecedence, &iss};
+    EXPECT_EQ(p.ParseDefinition()->proto.line, 1);
+    EXPECT_EQ(p.ParseDefinition()->proto.line, 4);
+    EXPECT_EQ(p.ParseExtern()->line, 6);
+    EXPECT_EQ(p.ParseTopLevelExpr()->proto.line, 7);
+}
@@ -0,0 +1,180 @@
+#include <pipeline/pipeline.h>
+
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <format>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+const std::map<std::string, uint8_t> kDefaultPrecedence = {
+    {"<", 10},
+    {"+", 20},
+    {"-", 20},
+    {"*", 40},
+};
+
+std::string RunPipeline(const std::string& input, PipelineOptions options = {}) {
+    std::istringstream in(input);
+    std::string output;
+    llvm::raw_string_ostream out(output);
+    Pipeline pipeline{&in, &out, kDefaultPrecedence, Jit::Create(), std::move(options)};
+    pipeline.Run();
+    return output;
+}
+
+// Output that another thread can wait for.
+class SharedOutput : public llvm::raw_ostream {
+public:
+    SharedOutput() {
+        SetUnbuffered();
+    }
+
+    void WaitFor(std::string_view text) {
+        std::unique_lock lock(mutex_);
+        written_.wait(lock, [&] { return data_.find(text) != std::string::npos; });
+    }
+
+    std::string Get() {
+        std::lock_guard lock(mutex_);
+        return data_;
+    }
+
+private:
+    void write_impl(const char* ptr, size_t size) override {
+        {
+            std::lock_guard lock(mutex_);
+            data_.append(ptr, size);
+        }
+        pos_ += size;
+        written_.notify_all();
+    }
+
+    uint64_t current_pos() const override {
+        return pos_;
+    }
+
+    std::mutex mutex_;
+    std::condition_variable written_;
+    std::string data_;
+    uint64_t pos_ = 0;
+};
+
+// Input whose second part is only read once `before_second` returns.
+class StagedInput : public std::streambuf {
+public:
+    StagedInput(std::string first, std::string second, std::function<void()> before_second)
+        : parts_{std::move(first), std::move(second)}, before_second_(std::move(before_second)) {
+    }
+
+private:
+    int_type underflow() override {
+        if (next_ == parts_.size()) {
+            return traits_type::eof();
+        }
+        if (next_ == 1) {
+            before_second_();
+        }
+        auto& part = parts_[next_++];
+        setg(part.data(), part.data(), part.data() + part.size());
+        return traits_type::to_int_type(part[0]);
+    }
+
+    std::vector<std::string> parts_;
+    std::function<void()> before_second_;
+    size_t next_ = 0;
+};
+
+}  // namespace
+
+TEST(BoundedQueue, Order) {
+    BoundedQueue<int> queue(3);
+    for (int i = 0; i < 4; ++i) {
+        queue.Push(i);
+    }
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(queue.Pop(), i);
+    }
+}
+
+TEST(BoundedQueue, ManyThreads) {
+    constexpr int kProducers = 4;
+    constexpr int kItems = 10000;
+    BoundedQueue<int> queue(8);
+    std::atomic<int64_t> sum = 0;
+    {
+        std::vector<std::jthread> threads;
+        for (int p = 0; p < kProducers; ++p) {
+            threads.emplace_back([&] {
+                for (int i = 1; i <= kItems; ++i) {
+                    queue.Push(i);
+                }
+            });
+            threads.emplace_back([&] {
+                for (int i = 0; i < kItems; ++i) {
+                    sum += queue.Pop();
+                }
+            });
+        }
+    }
+    EXPECT_EQ(sum, int64_t{kProducers} * kItems * (kItems + 1) / 2);
+}
+
+TEST(Pipeline, InputOrder) {
+    std::string input = "extern def sin(x)\ndef f(x) x * 2 + sin(0)\n";
+    std::string expected;
+    for (int i = 0; i < 32; ++i) {
+        input += std::format("def g{}(x) f(x) + {}\ng{}(1);\n", i, i, i);
+        expected += std::format("Evaluated to {}.000000\n", 2 + i);
+    }
+    for (size_t threads : {1, 4}) {
+        EXPECT_EQ(RunPipeline(input, {.compile_threads = threads, .queue_capacity = 4}), expected);
+    }
+}
+
+TEST(Pipeline, Errors) {
+    auto output = RunPipeline(R"(
+        def f(x) x
+        def f(x) x + 1
+        def g(x) y
+        def fib(x) fib(x - 1) * (1 < x) + (x < 2)
+        g(1);
+        fib(5);
+        f(3);
+    )");
+    EXPECT_EQ(output, "Evaluated to 1.000000\nEvaluated to 3.000000\n");
+}
+
+TEST(Pipeline, RedefinesFailedDefinition) {
+    SharedOutput out;
+    // The redefinition is parsed once the failed definition has gone through every stage.
+    StagedInput input("def g(x) y\n1;\n", "def g(x) x + 1\ng(2);\n",
+                      [&] { out.WaitFor("Evaluated to 1.000000"); });
+    std::istream in(&input);
+    Pipeline pipeline{&in, &out, kDefaultPrecedence, Jit::Create()};
+    pipeline.Run();
+    EXPECT_EQ(out.Get(), "Evaluated to 1.000000\nEvaluated to 3.000000\n");
+}
+
+TEST(Pipeline, Report) {
+    std::istringstream in("def f(x) x + 1\nf(1);\n");
+    std::string output;
+    llvm::raw_string_ostream out(output);
+    Pipeline pipeline{&in, &out, kDefaultPrecedence, Jit::Create(),
+                      {.compile_threads = 2, .collect_stats = true}};
+    pipeline.Run();
+    const auto& items = pipeline.GetReport().items;
+    ASSERT_EQ(items.size(), 4);
+    EXPECT_EQ(items[0].name, "parse");
+    EXPECT_EQ(items[1].name, "compile.0");
+    EXPECT_EQ(items[3].name, "link");
+    auto parse = items[0].stats;
+    auto compile = items[1].stats;
+    compile += items[2].stats;
+    EXPECT_GT(parse[stats::Phase::kParse].count(), 0);
+    EXPECT_EQ(parse[stats::Phase::kCodegen].count(), 0);
+    EXPECT_GT(compile[stats::Phase::kCodegen].count(), 0);
+    EXPECT_GT(compile[stats::Phase::kEmit].count(), 0);
+}
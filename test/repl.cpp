@@ -0,0 +1,161 @@
+#include <repl/repl.h>
+#include <stats/memory.h>
+
+#include <gtest/gtest.h>
+
+#include <format>
+
+namespace {
+
+const std::map<std::string, uint8_t> kDefaultPrecedence = {
+    {"<", 10},
+    {"+", 20},
+    {"-", 20},
+    {"*", 40},
+};
+
+std::string RunSession(std::string input, ReplOptions options = {}) {
+    std::istringstream in(std::move(input));
+    std::string output;
+    llvm::raw_string_ostream out(output);
+    auto jit = Jit::Create();
+    EXPECT_TRUE(jit);
+    Repl repl{&in, &out, kDefaultPrecedence, std::move(jit), std::move(options)};
+    repl.MainLoop();
+    return output;
+}
+
+bool Contains(const std::string& output, std::string_view text) {
+    return output.find(text) != std::string::npos;
+}
+
+}  // namespace
+
+constexpr std::string_view kRedefineCallee = R"(
+    def f(x) x + 1
+    def g(x) f(x) * 2
+    g(1);
+    def f(x) x + 2
+    g(1);
+)";
+
+TEST(Repl, RedefinitionRecompilesCallers) {
+    auto output = RunSession(std::string(kRedefineCallee), {.call_stubs = false});
+    EXPECT_TRUE(Contains(output, "Evaluated to 4.000000"));
+    EXPECT_TRUE(Contains(output, "Recompiled dependent function: "));
+    EXPECT_TRUE(Contains(output, "Evaluated to 6.000000"));
+}
+
+TEST(Repl, RedefinitionThroughStubs) {
+    auto output = RunSession(std::string(kRedefineCallee));
+    EXPECT_TRUE(Contains(output, "Evaluated to 4.000000"));
+    EXPECT_FALSE(Contains(output, "Recompiled dependent function: "));
+    EXPECT_TRUE(Contains(output, "Evaluated to 6.000000"));
+}
+
+TEST(Repl, Devirtualize) {
+    std::istringstream in(R"(
+        def f(x) x + 1
+        def g(x) f(x) * 2
+        def h(y) y + 1
+    )");
+    std::string output;
+    llvm::raw_string_ostream out(output);
+    auto jit = Jit::Create();
+    ASSERT_TRUE(jit);
+    auto* raw_jit = jit.get();
+    Repl repl{&in, &out, kDefaultPrecedence, std::move(jit)};
+    repl.MainLoop();
+    repl.Devirtualize();
+    EXPECT_TRUE(Contains(output, "Devirtualized function: h is an alias of f"));
+
+    auto g = reinterpret_cast<double (*)(double)>(raw_jit->Lookup("g"));
+    auto h = reinterpret_cast<double (*)(double)>(raw_jit->Lookup("h"));
+    ASSERT_TRUE(g && h);
+    EXPECT_EQ(g(1), 4);
+    EXPECT_EQ(h(1), 2);
+}
+
+TEST(Repl, CallsFunctionDefinedLater) {
+    for (bool call_stubs : {false, true}) {
+        auto output = RunSession(R"(
+            extern def g(x)
+            def f(x) g(x) + 1
+            def g(x) x * 2
+            f(1);
+        )",
+                                 {.call_stubs = call_stubs});
+        EXPECT_TRUE(Contains(output, "Evaluated to 3.000000"));
+    }
+}
+
+TEST(Repl, FailedRedefinitionKeepsOld) {
+    auto output = RunSession(R"(
+        def f(x) x + 1
+        def f(x) y
+        f(1);
+    )");
+    EXPECT_TRUE(Contains(output, "Evaluated to 2.000000"));
+}
+
+TEST(Repl, RedefinitionOfAliasee) {
+    constexpr std::string_view input = R"(
+        def f(x) x * 2
+        def g(y) y * 2
+        def f(x) x * 3
+        g(2);
+        f(2);
+    )";
+    for (bool call_stubs : {false, true}) {
+        auto output = RunSession(std::string(input), {.call_stubs = call_stubs});
+        EXPECT_TRUE(Contains(output, "g is an alias of f"));
+        EXPECT_TRUE(Contains(output, "Evaluated to 4.000000"));
+        EXPECT_TRUE(Contains(output, "Evaluated to 6.000000"));
+    }
+}
+
+TEST(Repl, ArityChangeWithCallers) {
+    auto output = RunSession(R"(
+        def f(x) x + 1
+        def g(x) f(x)
+        def f(x y) x + y
+        g(1);
+    )");
+    EXPECT_TRUE(Contains(output, "Evaluated to 2.000000"));
+}
+
+TEST(Repl, ExternKeepsDefinedSignature) {
+    auto output = RunSession(R"(
+        def f(x:float):float x * 2
+        extern def f(a)
+    )");
+    EXPECT_FALSE(Contains(output, "Read extern: "));
+    output = RunSession(R"(
+        def f(x:float):float x * 2
+        extern def f(a:float):float
+    )");
+    EXPECT_TRUE(Contains(output, "Read extern: "));
+}
+
+TEST(Repl, RedefinitionFreesCode) {
+    auto redefinitions = [](int count) {
+        std::string input;
+        for (int i = 0; i < count; ++i) {
+            input += std::format("def f(x) x * {}.5 + 1\nf(1);\n", i);
+        }
+        return input;
+    };
+    // Measured while the session, and so its JIT, is still alive.
+    auto live_after = [&](int count) {
+        auto before = stats::GetMemoryUsage(stats::MemoryPool::kJitCode).live;
+        std::istringstream in(redefinitions(count));
+        std::string output;
+        llvm::raw_string_ostream out(output);
+        Repl repl{&in, &out, {{"+", 20}, {"*", 40}}, Jit::Create()};
+        repl.MainLoop();
+        return stats::GetMemoryUsage(stats::MemoryPool::kJitCode).live - before;
+    };
+    auto live = live_after(1);
+    EXPECT_GT(live, 0);
+    EXPECT_EQ(live_after(50), live);
+}
@@ -0,0 +1,112 @@
+#include <batch/batch.h>
+#include <server/server.h>
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <thread>
+
+namespace {
+
+const std::map<std::string, uint8_t> kDefaultPrecedence = {
+    {"<", 10},
+    {"+", 20},
+    {"-", 20},
+    {"*", 40},
+};
+
+std::unique_ptr<Bundle> CompileBundle(std::string source) {
+    std::istringstream in(std::move(source));
+    Batch batch{&in, kDefaultPrecedence, CreateHostTargetMachine()};
+    EXPECT_TRUE(batch.Run());
+    std::string data;
+    llvm::raw_string_ostream out(data);
+    WriteBundle(batch.GetInterface(), batch.GetModule().getTargetTriple(),
+                batch.GetObject()->getMemBufferRef(), out);
+    return Bundle::Create(llvm::MemoryBuffer::getMemBufferCopy(data));
+}
+
+std::string SocketPath(std::string_view name) {
+    return std::format("/tmp/kaleidoscope-{}-{}.sock", name, getpid());
+}
+
+bool Contains(const std::string& output, std::string_view text) {
+    return output.find(text) != std::string::npos;
+}
+
+}  // namespace
+
+TEST(Server, Sessions) {
+    auto bundle = CompileBundle("def square(x) x * x\n");
+    ASSERT_TRUE(bundle);
+    auto prelude = Prelude::Create(*bundle);
+    ASSERT_TRUE(prelude);
+    auto path = SocketPath("sessions");
+    auto server = Server::Create(path, kDefaultPrecedence, prelude.get(), {.worker_threads = 4});
+    ASSERT_TRUE(server);
+    std::jthread serving([&] { server->Run(); });
+
+    // Every session defines its own f on top of the prelude.
+    constexpr int kSessions = 16;
+    std::vector<std::string> outputs(kSessions);
+    {
+        std::vector<std::jthread> clients;
+        for (int i = 0; i < kSessions; ++i) {
+            clients.emplace_back([&, i] {
+                auto input = std::format("def f(x) square(x) + {}\nf(3);\nf(4);\n", i);
+                outputs[i] = RunClient(path, input).value_or("");
+            });
+        }
+    }
+    for (int i = 0; i < kSessions; ++i) {
+        EXPECT_TRUE(Contains(outputs[i], std::format("Evaluated to {}.000000", 9 + i))) << i;
+        EXPECT_LT(outputs[i].find(std::format("Evaluated to {}.000000", 9 + i)),
+                  outputs[i].find(std::format("Evaluated to {}.000000", 16 + i)));
+    }
+
+    // Definitions of other sessions aren't visible, and the prelude can't be redefined.
+    auto output = RunClient(path, "f(1);\ndef square(x) x\nsquare(5);\n");
+    ASSERT_TRUE(output);
+    EXPECT_FALSE(Contains(*output, "Evaluated to 1.000000"));
+    EXPECT_TRUE(Contains(*output, "Evaluated to 25.000000"));
+
+    server->Stop();
+}
+
+TEST(Server, ErrorsGoToTheirSession) {
+    auto path = SocketPath("errors");
+    auto server = Server::Create(path, kDefaultPrecedence, nullptr, {.worker_threads = 2});
+    ASSERT_TRUE(server);
+    std::jthread serving([&] { server->Run(); });
+
+    std::string bad;
+    std::string good;
+    {
+        std::jthread bad_client(
+            [&] { bad = RunClient(path, "def (x) 1\ndef f(x) y\n1 + 1;\n").value_or(""); });
+        std::jthread good_client([&] { good = RunClient(path, "2 + 2;\n").value_or(""); });
+    }
+    EXPECT_TRUE(Contains(bad, "Error: Failed to parse definition"));
+    EXPECT_TRUE(Contains(bad, "Error: Unknown variable name"));
+    EXPECT_LT(bad.find("Error: Unknown variable name"), bad.find("Evaluated to 2.000000"));
+    EXPECT_FALSE(Contains(good, "Error"));
+    EXPECT_TRUE(Contains(good, "Evaluated to 4.000000"));
+
+    server->Stop();
+}
+
+TEST(Server, NoServer) {
+    EXPECT_FALSE(RunClient(SocketPath("missing"), "1;"));
+}
+
+TEST(Server, KeepsOtherFiles) {
+    auto path = SocketPath("file");
+    std::ofstream(path) << "data";
+    EXPECT_FALSE(Server::Create(path, kDefaultPrecedence, nullptr));
+    EXPECT_TRUE(std::filesystem::is_regular_file(path));
+    std::filesystem::remove(path);
+}
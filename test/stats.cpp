@@ -0,0 +1,71 @@
+#include <parser/parser.h>
+#include <stats/memory.h>
+#include <stats/stats.h>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+TEST(Stats, ParserCounters) {
+    std::istringstream iss("def f(x y) x * 2 + y");
+    stats::Stats stats;
+    {
+        stats::ScopedCollector collector(&stats);
+        Parser p{{{"+", 20}, {"*", 40}}, &iss};
+        ASSERT_TRUE(p.ParseDefinition());
+    }
+    EXPECT_EQ(stats[stats::Counter::kTokens], 12);
+    EXPECT_EQ(stats[stats::Counter::kAstNodes], 5);
+    EXPECT_GT(stats[stats::Phase::kParse].count(), 0);
+    EXPECT_GT(stats[stats::Phase::kTokenize].count(), 0);
+}
+
+TEST(Stats, NestedTimersAreExclusive) {
+    using namespace std::chrono_literals;
+    stats::Stats stats;
+    {
+        stats::ScopedCollector collector(&stats);
+        stats::ScopedTimer outer(stats::Phase::kParse);
+        stats::ScopedTimer inner(stats::Phase::kTokenize);
+        std::this_thread::sleep_for(20ms);
+    }
+    EXPECT_GE(stats[stats::Phase::kTokenize], 20ms);
+    EXPECT_LT(stats[stats::Phase::kParse], 10ms);
+}
+
+TEST(Stats, NoCollector) {
+    stats::Stats stats;
+    {
+        stats::ScopedCollector collector(&stats);
+    }
+    stats::Add(stats::Counter::kTokens);
+    stats::ScopedTimer timer(stats::Phase::kParse);
+    EXPECT_EQ(stats[stats::Counter::kTokens], 0);
+    EXPECT_FALSE(stats::IsCollecting());
+}
+
+TEST(Stats, AstMemory) {
+    auto before = stats::GetMemoryUsage(stats::MemoryPool::kAst).live;
+    stats::Stats stats;
+    {
+        std::istringstream iss("def f(x y) x * 2 + y");
+        Parser p{{{"+", 20}, {"*", 40}}, &iss};
+        stats::ScopedCollector collector(&stats);
+        auto fn = p.ParseDefinition();
+        ASSERT_TRUE(fn);
+        EXPECT_GE(stats::GetMemoryUsage(stats::MemoryPool::kAst).live - before,
+                  5 * sizeof(ast::Node));
+    }
+    EXPECT_EQ(stats::GetMemoryUsage(stats::MemoryPool::kAst).live, before);
+    EXPECT_GE(stats.peak_memory[static_cast<size_t>(stats::Phase::kParse)],
+              5 * sizeof(ast::Node));
+}
+
+TEST(Stats, AstMemoryOfChangedNode) {
+    auto before = stats::GetMemoryUsage(stats::MemoryPool::kAst).live;
+    {
+        auto node = ast::MakeNodePtr(ast::Variable{"x"});
+        std::get<ast::Variable>(*node).name = std::string(100, 'x');
+    }
+    EXPECT_EQ(stats::GetMemoryUsage(stats::MemoryPool::kAst).live, before);
+}
@@ -37,6 +37,21 @@ TEST(Tokenizer, Extern) {
     CheckTokenization("extern def f(x)", Extern{}, Def{}, Ident{"f"}, kOpen, Ident{"x"}, kClose);
 }
 
+TEST(Tokenizer, ForLoop) {
+    CheckTokenization("for i = 0, i < n in inner", For{}, Ident{"i"}, Operator{"="}, Number{0},
+                      Comma{}, Ident{"i"}, Operator{"<"}, Ident{"n"}, In{}, Ident{"inner"});
+}
+
+TEST(Tokenizer, Conditional) {
+    CheckTokenization("if x then y else z", If{}, Ident{"x"}, Then{}, Ident{"y"}, Else{},
+                      Ident{"z"});
+}
+
+TEST(Tokenizer, VarBinding) {
+    CheckTokenization("var x = 1 in x", Var{}, Ident{"x"}, Operator{"="}, Number{1}, In{},
+                      Ident{"x"});
+}
+
 TEST(Tokenizer, Expression) {
     CheckTokenization("(x + 1.0) * 123.456", kOpen, Ident{"x"}, Operator{"+"}, Number{1}, kClose,
                       Operator{"*"}, Number{123.456});
@@ -61,3 +76,14 @@ TEST(Tokenizer, Comments) {
                       Def{}, Ident{"f"}, kOpen, Ident{"x"}, kClose, Ident{"x"}, Operator{"+"},
                       Number{42});
 }
+
+TEST(Tokenizer, Lines) {
+    std::stringstream ss{"def f(x)\n  x # Comment\n\n  + 1"};
+    Tokenizer t{&ss};
+    std::vector<size_t> lines;
+    while (t.Get() != Token{Eof{}}) {
+        lines.push_back(t.GetLine());
+        t.Next();
+    }
+    EXPECT_EQ(lines, (std::vector<size_t>{1, 1, 1, 1, 1, 2, 4, 4}));
+}